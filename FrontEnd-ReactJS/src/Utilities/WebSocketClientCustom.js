@@ -196,6 +196,17 @@ class WebSocketClientCustom {
           filter_id: args[2],
         };
 
+      case "get_eq_response":
+        if (args.length !== 3) {
+          throw new Error("get_eq_response requires 3 arguments");
+        }
+        return {
+          command_type,
+          channel_type: args[0],
+          channel_number: args[1],
+          points: args[2],
+        };
+
       case "get_meter":
         if (args.length !== 1) {
           throw new Error("get_meter requires 1 argument");
@@ -246,6 +257,15 @@ class WebSocketClientCustom {
         messageObject.q_factor,
         messageObject.gain_db
       );
+    } else if (messageObject.command_type === "notify_eq_response") {
+      this.event_manager.emitEvent(
+        "notify_eq_response",
+        messageObject.channel_type,
+        messageObject.channel_number,
+        messageObject.frequencies,
+        messageObject.magnitude_db,
+        messageObject.phase_deg
+      );
     } else if (messageObject.command_type === "notify_meter") {
       this.event_manager.emitEvent(
         "notify_meter",
@@ -349,6 +369,13 @@ class WebSocketClientCustom {
       }
     );
 
+    this.event_manager.on(
+      "get_eq_response",
+      (channel_type, channel_number, points) => {
+        this.sendToServer("get_eq_response", channel_type, channel_number, points);
+      }
+    );
+
     this.event_manager.on("get_meter", (channel_type) => {
       this.sendToServer("get_meter", channel_type);
     });
@@ -2,11 +2,15 @@ import React, { useState, useEffect, useContext, useRef } from "react";
 import styles from "./EQComponent.module.css";
 import EventManagerContext from "../../Utilities/EventManagerContext";
 import { throttle } from "lodash";
-const audioContext = new (window.AudioContext || window.webkitAudioContext)();
 const filterCount = 16;
-const biquadFilters = Array.from({ length: filterCount }, () =>
-  audioContext.createBiquadFilter()
-);
+// Number of points of the response curve, computed by the server
+const responsePoints = 600;
+const biquadFilters = Array.from({ length: filterCount }, () => ({
+  type: "peaking",
+  frequency: 1000,
+  q_factor: 0.707,
+  gain: 0,
+}));
 
 const EQComponent = ({ channel_type, channel_number }) => {
   const [pathData, setPathData] = useState("");
@@ -42,25 +46,43 @@ const EQComponent = ({ channel_type, channel_number }) => {
     ) {
       const filterIndex = filterId - 1;
       biquadFilters[filterIndex].type = filterType;
-      biquadFilters[filterIndex].frequency.value = filterFrequency;
-      biquadFilters[filterIndex].Q.value = filterq_factor;
-      biquadFilters[filterIndex].gain.value = filterGain;
+      biquadFilters[filterIndex].frequency = filterFrequency;
+      biquadFilters[filterIndex].q_factor = filterq_factor;
+      biquadFilters[filterIndex].gain = filterGain;
 
       let newEnabledFilters = enabledFilters;
       newEnabledFilters[filterIndex] = filterEnabled;
       setEnabledFilters(newEnabledFilters);
 
-      const pathData = updateFrequencyResponseCurve();
-      setPathData(pathData);
+      // The server computes the combined response and answers with notify_eq_response
+      event_manager.emitEvent(
+        "get_eq_response",
+        channel_type,
+        channel_number,
+        responsePoints
+      );
+    }
+  };
+
+  const responseListeningFunction = (
+    channelType,
+    channelNumber,
+    frequencies,
+    magnitudeDb
+  ) => {
+    if (channelType === channel_type && channelNumber === channel_number) {
+      setPathData(updateFrequencyResponseCurve(frequencies, magnitudeDb));
     }
   };
 
   useEffect(() => {
     if (event_manager) {
       event_manager.on(`notify_filter`, eventListeningFunction);
+      event_manager.on(`notify_eq_response`, responseListeningFunction);
     }
     return () => {
       event_manager.off(`notify_filter`, eventListeningFunction);
+      event_manager.off(`notify_eq_response`, responseListeningFunction);
     };
   }, []);
 
@@ -218,8 +240,8 @@ const EQComponent = ({ channel_type, channel_number }) => {
     const clampedMouseY = Math.max(0, Math.min(SVG_HEIGHT, mouseY));
 
     const newCenterFrequency = svgXToFrequency(clampedMouseX);
-    let newGain = biquadFilters[index].gain.value;
-    let newQFactor = biquadFilters[index].Q.value;
+    let newGain = biquadFilters[index].gain;
+    let newQFactor = biquadFilters[index].q_factor;
 
     if (biquadFilters[index].type == "peaking") {
       newGain = svgYToGain(clampedMouseY);
@@ -246,14 +268,14 @@ const EQComponent = ({ channel_type, channel_number }) => {
       if (!enabledFilters[index]) return null;
 
       const filterId = index + 1;
-      const freq = filter.frequency.value || 125 * filterId;
+      const freq = filter.frequency || 125 * filterId;
       const x = frequencyToSvgX(freq);
       let y;
 
       if (filter.type === "peaking") {
-        y = gainToSvgY(filter.gain.value);
+        y = gainToSvgY(filter.gain);
       } else {
-        y = qFactorToSvgY(filter.Q.value);
+        y = qFactorToSvgY(filter.q_factor);
       }
 
       return (
@@ -280,54 +302,12 @@ const EQComponent = ({ channel_type, channel_number }) => {
     });
   };
 
-  const updateFrequencyResponseCurve = () => {
-    const numPoints = 1998;
+  const updateFrequencyResponseCurve = (frequencies, magnitudeDb) => {
     const curvePoints = [];
 
-    // Create a Float32Array to store the frequency values
-    const frequencies = new Float32Array(numPoints + 1);
-    for (let i = 0; i <= numPoints; i++) {
-      const freq = svgXToFrequency((i / numPoints) * SVG_WIDTH);
-      frequencies[i] = freq;
-    }
-
-    // Get the frequency response of the filters
-    const magResponseArray = biquadFilters.map(
-      () => new Float32Array(frequencies.length)
-    );
-    const phaseResponseArray = biquadFilters.map(
-      () => new Float32Array(frequencies.length)
-    );
-
-    //console.log(`MagResponseArray: ${magResponseArray}`);
-
-    biquadFilters.forEach((filter, index) => {
-      filter.getFrequencyResponse(
-        frequencies,
-        magResponseArray[index],
-        phaseResponseArray[index]
-      );
-    });
-
-    // Calculate the combined magnitude response considering only enabled filters
-    const combinedMagResponse = magResponseArray[0].map((_, i) =>
-      magResponseArray.reduce(
-        (acc, magResponse, index) =>
-          acc * (enabledFilters[index] ? magResponse[i] : 1),
-        1
-      )
-    );
-
-    //console.log(`CombinedMagResponse: ${combinedMagResponse}`);
-
-    // Convert the magnitude response values to decibels
-    const gainResponse = combinedMagResponse.map(
-      (value) => 20 * Math.log10(value)
-    );
-
-    for (let i = 0; i < gainResponse.length; i++) {
+    for (let i = 0; i < frequencies.length; i++) {
       const x = frequencyToSvgX(frequencies[i]);
-      const y = gainToSvgY(gainResponse[i]);
+      const y = gainToSvgY(magnitudeDb[i]);
       curvePoints.push({ x, y });
     }
 
@@ -123,8 +123,16 @@ const FilterParameters = ({ channel_type, channel_number, filter_id }) => {
           active={enabled ? true : false}
           options={[
             { label: "Low Pass", value: "lowpass" },
+            { label: "Low Pass 6 dB", value: "lowpass1" },
+            { label: "Low Shelf", value: "lowshelf" },
             { label: "Peaking", value: "peaking" },
+            { label: "Band Pass", value: "bandpass" },
+            { label: "Band Pass (Skirt)", value: "bandpass_csg" },
             { label: "Notch", value: "notch" },
+            { label: "All Pass", value: "allpass" },
+            { label: "Tilt", value: "tilt" },
+            { label: "High Shelf", value: "highshelf" },
+            { label: "High Pass 6 dB", value: "highpass1" },
             { label: "High Pass", value: "highpass" },
           ]}
           value={type}
@@ -154,7 +162,11 @@ const FilterParameters = ({ channel_type, channel_number, filter_id }) => {
       <div className={styles.filterParameter}>
         <FilterTextInput
           range={{ min: -20.0, max: 20.0, default: 0 }}
-          active={type === "peaking" && enabled ? true : false}
+          active={
+            ["peaking", "lowshelf", "highshelf", "tilt"].includes(type) && enabled
+              ? true
+              : false
+          }
           value={gainDb}
           onChange={handleGainDbChange}
           placeholder="-20.0 to 20.0"
@@ -0,0 +1,395 @@
+// biquad_bank.h
+// Bank of biquad sections for many channels that all run the same number of bands. The channels are processed in groups of
+// BIQUAD_BANK_LANES, one lane per channel, with the coefficients and the delay line of each band stored as structure of arrays.
+// A group is transposed into a frame-major scratch block, run through every band with all lanes in lockstep, and transposed back.
+// Because the lanes are channels, the recursion of a section is vectorized across channels instead of across time: SSE2 and
+// NEON run half a group per instruction and AVX2 a whole one. Samples are 32-bit float, like the rest of the signal path.
+
+#ifndef BIQUAD_BANK_H
+#define BIQUAD_BANK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include "biquad_filter.h"
+#include "../Utilities/cpu_dispatch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BIQUAD_BANK_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BIQUAD_BANK_NEON 1
+#endif
+
+// Number of channels processed in lockstep by one group
+constexpr unsigned int BIQUAD_BANK_LANES = 8;
+// Number of frames transposed and filtered at a time, so the scratch block stays in the L1 cache
+constexpr size_t BIQUAD_BANK_CHUNK_FRAMES = 64;
+
+// One band of one channel group: coefficients and direct form I delay line, one entry per lane
+struct alignas(32) BiquadBankSection
+{
+    float b0[BIQUAD_BANK_LANES], b1[BIQUAD_BANK_LANES], b2[BIQUAD_BANK_LANES], a1[BIQUAD_BANK_LANES], a2[BIQUAD_BANK_LANES];
+    float x1[BIQUAD_BANK_LANES], x2[BIQUAD_BANK_LANES], y1[BIQUAD_BANK_LANES], y2[BIQUAD_BANK_LANES];
+};
+
+// Section kernel for one instruction set
+struct BiquadBankKernels
+{
+    // Runs nframes frames of a frame-major block (BIQUAD_BANK_LANES samples per frame) through one section, in place
+    void (*process)(float *block, size_t nframes, BiquadBankSection &section);
+    // Number of lanes per instruction and name of the instruction set, for logging
+    unsigned int width;
+    const char *name;
+};
+
+// Scalar kernel, one lane after the other through the whole block, used on CPUs without SSE2 or NEON
+void biquad_bank_section_scalar(float *block, size_t nframes, BiquadBankSection &s)
+{
+    for (unsigned int lane = 0; lane < BIQUAD_BANK_LANES; ++lane)
+    {
+        float x1 = s.x1[lane], x2 = s.x2[lane], y1 = s.y1[lane], y2 = s.y2[lane];
+        for (size_t n = 0; n < nframes; ++n)
+        {
+            float x0 = block[n * BIQUAD_BANK_LANES + lane];
+            float y0 = s.b0[lane] * x0 + s.b1[lane] * x1 + s.b2[lane] * x2 - s.a1[lane] * y1 - s.a2[lane] * y2;
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = y0;
+            block[n * BIQUAD_BANK_LANES + lane] = y0;
+        }
+        s.x1[lane] = x1;
+        s.x2[lane] = x2;
+        s.y1[lane] = y1;
+        s.y2[lane] = y2;
+    }
+}
+
+#if defined(BIQUAD_BANK_X86)
+// SSE2 kernel, 4 lanes per instruction, run once for each half of the group
+__attribute__((target("sse2"))) void biquad_bank_section_sse2(float *block, size_t nframes, BiquadBankSection &s)
+{
+    for (unsigned int half = 0; half < BIQUAD_BANK_LANES; half += 4)
+    {
+        const __m128 b0 = _mm_load_ps(s.b0 + half), b1 = _mm_load_ps(s.b1 + half), b2 = _mm_load_ps(s.b2 + half);
+        const __m128 a1 = _mm_load_ps(s.a1 + half), a2 = _mm_load_ps(s.a2 + half);
+        __m128 x1 = _mm_load_ps(s.x1 + half), x2 = _mm_load_ps(s.x2 + half), y1 = _mm_load_ps(s.y1 + half), y2 = _mm_load_ps(s.y2 + half);
+        for (size_t n = 0; n < nframes; ++n)
+        {
+            float *frame = block + n * BIQUAD_BANK_LANES + half;
+            __m128 x0 = _mm_load_ps(frame);
+            __m128 y0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(b0, x0), _mm_mul_ps(b1, x1)), _mm_mul_ps(b2, x2));
+            y0 = _mm_sub_ps(_mm_sub_ps(y0, _mm_mul_ps(a1, y1)), _mm_mul_ps(a2, y2));
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = y0;
+            _mm_store_ps(frame, y0);
+        }
+        _mm_store_ps(s.x1 + half, x1);
+        _mm_store_ps(s.x2 + half, x2);
+        _mm_store_ps(s.y1 + half, y1);
+        _mm_store_ps(s.y2 + half, y2);
+    }
+}
+
+// AVX2 kernel, all 8 lanes per instruction
+__attribute__((target("avx2"))) void biquad_bank_section_avx2(float *block, size_t nframes, BiquadBankSection &s)
+{
+    const __m256 b0 = _mm256_load_ps(s.b0), b1 = _mm256_load_ps(s.b1), b2 = _mm256_load_ps(s.b2);
+    const __m256 a1 = _mm256_load_ps(s.a1), a2 = _mm256_load_ps(s.a2);
+    __m256 x1 = _mm256_load_ps(s.x1), x2 = _mm256_load_ps(s.x2), y1 = _mm256_load_ps(s.y1), y2 = _mm256_load_ps(s.y2);
+    for (size_t n = 0; n < nframes; ++n)
+    {
+        float *frame = block + n * BIQUAD_BANK_LANES;
+        __m256 x0 = _mm256_load_ps(frame);
+        __m256 y0 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(b0, x0), _mm256_mul_ps(b1, x1)), _mm256_mul_ps(b2, x2));
+        y0 = _mm256_sub_ps(_mm256_sub_ps(y0, _mm256_mul_ps(a1, y1)), _mm256_mul_ps(a2, y2));
+        x2 = x1;
+        x1 = x0;
+        y2 = y1;
+        y1 = y0;
+        _mm256_store_ps(frame, y0);
+    }
+    _mm256_store_ps(s.x1, x1);
+    _mm256_store_ps(s.x2, x2);
+    _mm256_store_ps(s.y1, y1);
+    _mm256_store_ps(s.y2, y2);
+}
+#endif // BIQUAD_BANK_X86
+
+#if defined(BIQUAD_BANK_NEON)
+// NEON kernel, 4 lanes per instruction, run once for each half of the group
+void biquad_bank_section_neon(float *block, size_t nframes, BiquadBankSection &s)
+{
+    for (unsigned int half = 0; half < BIQUAD_BANK_LANES; half += 4)
+    {
+        const float32x4_t b0 = vld1q_f32(s.b0 + half), b1 = vld1q_f32(s.b1 + half), b2 = vld1q_f32(s.b2 + half);
+        const float32x4_t a1 = vld1q_f32(s.a1 + half), a2 = vld1q_f32(s.a2 + half);
+        float32x4_t x1 = vld1q_f32(s.x1 + half), x2 = vld1q_f32(s.x2 + half), y1 = vld1q_f32(s.y1 + half), y2 = vld1q_f32(s.y2 + half);
+        for (size_t n = 0; n < nframes; ++n)
+        {
+            float *frame = block + n * BIQUAD_BANK_LANES + half;
+            float32x4_t x0 = vld1q_f32(frame);
+            float32x4_t y0 = vmlaq_f32(vmlaq_f32(vmulq_f32(b0, x0), b1, x1), b2, x2);
+            y0 = vmlsq_f32(vmlsq_f32(y0, a1, y1), a2, y2);
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = y0;
+            vst1q_f32(frame, y0);
+        }
+        vst1q_f32(s.x1 + half, x1);
+        vst1q_f32(s.x2 + half, x2);
+        vst1q_f32(s.y1 + half, y1);
+        vst1q_f32(s.y2 + half, y2);
+    }
+}
+#endif // BIQUAD_BANK_NEON
+
+// Returns the section kernels this CPU can run, narrowest first
+std::vector<BiquadBankKernels> get_supported_biquad_bank_kernels()
+{
+    std::vector<BiquadBankKernels> supported = {{biquad_bank_section_scalar, 1, "scalar"}};
+#if defined(BIQUAD_BANK_X86)
+    if (__builtin_cpu_supports("sse2"))
+    {
+        supported.push_back({biquad_bank_section_sse2, 4, "SSE2"});
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        supported.push_back({biquad_bank_section_avx2, 8, "AVX2"});
+    }
+#elif defined(BIQUAD_BANK_NEON)
+    supported.push_back({biquad_bank_section_neon, 4, "NEON"});
+#endif
+    return supported;
+}
+
+// Returns the section kernel the bank runs with
+const BiquadBankKernels &get_biquad_bank_kernels()
+{
+    return select_widest_kernels<BiquadBankKernels, get_supported_biquad_bank_kernels>();
+}
+
+class BiquadBank
+{
+public:
+    // Constructor. Every band of every channel starts disabled, passing the signal through unchanged.
+    // Coefficient changes are ramped over ramp_frames frames; 0 applies them at once.
+    // kernels selects the section kernel; nullptr uses the widest one supported by the CPU.
+    BiquadBank(unsigned int channels, unsigned int bands, size_t ramp_frames = 0, const BiquadBankKernels *kernels = nullptr);
+
+    // Function to set the coefficients of one band of one channel and enable or disable it. Called from the thread that
+    // processes the channel's group. With ramping, the band glides from its current coefficients to the new ones, and a band
+    // that is switched on or off glides from or to pass-through. Without ramping the coefficients change at once and a band
+    // that is switched on starts from a clean delay line.
+    void set_filter(unsigned int channel, unsigned int band, bool is_enabled, const BiquadCoefficients &coefficients);
+
+    // Function to process nframes frames of one group of channels in place. channels holds one buffer per channel of the bank;
+    // the group covers channels group * BIQUAD_BANK_LANES up to the next group or the last channel.
+    void process_group(unsigned int group, float *const *channels, size_t nframes);
+
+    unsigned int get_group_count() const { return groups_; }
+    const BiquadBankKernels &get_kernels() const { return kernels_; }
+
+private:
+    // Number of frames between two coefficient steps of a ramp
+    static constexpr size_t RAMP_STEP_FRAMES = 8;
+
+    // Coefficient ramp of one section: target coefficients and the change per frame of every lane, and the frames left
+    struct Ramp
+    {
+        float target[5][BIQUAD_BANK_LANES];
+        float step[5][BIQUAD_BANK_LANES];
+        size_t remaining_frames = 0;
+    };
+
+    // Function to return the coefficient arrays of a section in b0, b1, b2, a1, a2 order
+    static std::array<float *, 5> coefficient_rows(BiquadBankSection &s) { return {s.b0, s.b1, s.b2, s.a1, s.a2}; }
+    // Function to run a section over nframes frames of a block, stepping its coefficients while it is ramping
+    void process_section(float *block, size_t nframes, BiquadBankSection &section, Ramp &ramp, uint32_t &active_lanes, uint32_t enabled_lanes);
+
+    unsigned int channels_;
+    unsigned int bands_;
+    unsigned int groups_;
+    size_t ramp_frames_;
+    BiquadBankKernels kernels_;
+    // Sections and their ramps, indexed [group * bands_ + band]
+    std::vector<BiquadBankSection> sections_;
+    std::vector<Ramp> ramps_;
+    // Bit masks of the enabled lanes of each section, and of the lanes that are enabled or still ramping.
+    // Bands without active lanes on the whole group are skipped.
+    std::vector<uint32_t> enabled_lanes_;
+    std::vector<uint32_t> active_lanes_;
+};
+
+// Constructor
+BiquadBank::BiquadBank(unsigned int channels, unsigned int bands, size_t ramp_frames, const BiquadBankKernels *kernels)
+    : channels_(channels),
+      bands_(bands),
+      groups_((channels + BIQUAD_BANK_LANES - 1) / BIQUAD_BANK_LANES),
+      ramp_frames_(ramp_frames),
+      kernels_(kernels ? *kernels : get_biquad_bank_kernels()),
+      sections_(groups_ * bands),
+      ramps_(groups_ * bands),
+      enabled_lanes_(groups_ * bands, 0),
+      active_lanes_(groups_ * bands, 0)
+{
+    // Zero state and pass-through coefficients (b0 == 1) on every lane, including the padding lanes of the last group
+    for (size_t i = 0; i < sections_.size(); ++i)
+    {
+        std::memset(&sections_[i], 0, sizeof(sections_[i]));
+        std::fill(std::begin(sections_[i].b0), std::end(sections_[i].b0), 1.0f);
+        for (unsigned int row = 0; row < 5; ++row)
+        {
+            std::copy(coefficient_rows(sections_[i])[row], coefficient_rows(sections_[i])[row] + BIQUAD_BANK_LANES, ramps_[i].target[row]);
+        }
+    }
+}
+
+// Function to set the coefficients of one band of one channel
+void BiquadBank::set_filter(unsigned int channel, unsigned int band, bool is_enabled, const BiquadCoefficients &coefficients)
+{
+    if (channel >= channels_ || band >= bands_)
+    {
+        return;
+    }
+    const unsigned int group = channel / BIQUAD_BANK_LANES, lane = channel % BIQUAD_BANK_LANES;
+    const size_t index = group * bands_ + band;
+    BiquadBankSection &s = sections_[index];
+    Ramp &ramp = ramps_[index];
+    const uint32_t lane_bit = 1u << lane;
+
+    // A disabled band is stored as pass-through coefficients, so it costs nothing to the other lanes of the group
+    const BiquadCoefficients applied = is_enabled ? coefficients : BiquadCoefficients{1.0, 0.0, 0.0, 0.0, 0.0};
+    const float target[5] = {static_cast<float>(applied.b0), static_cast<float>(applied.b1), static_cast<float>(applied.b2),
+                             static_cast<float>(applied.a1), static_cast<float>(applied.a2)};
+    bool changed = false;
+    for (unsigned int row = 0; row < 5; ++row)
+    {
+        changed = changed || ramp.target[row][lane] != target[row];
+        ramp.target[row][lane] = target[row];
+    }
+    if (!changed)
+    {
+        return;
+    }
+    const bool was_enabled = enabled_lanes_[index] & lane_bit;
+    enabled_lanes_[index] = is_enabled ? enabled_lanes_[index] | lane_bit : enabled_lanes_[index] & ~lane_bit;
+
+    if (ramp_frames_ == 0)
+    {
+        const std::array<float *, 5> rows = coefficient_rows(s);
+        for (unsigned int row = 0; row < 5; ++row)
+        {
+            rows[row][lane] = target[row];
+        }
+        if (is_enabled && !was_enabled)
+        {
+            s.x1[lane] = s.x2[lane] = s.y1[lane] = s.y2[lane] = 0.0f;
+        }
+        active_lanes_[index] = enabled_lanes_[index];
+        return;
+    }
+
+    // (Re)start the ramp of the whole section from where every lane is now. A pass-through lane's delay line already holds
+    // its input (y == x), so a band that is switched on glides in from pass-through without a reset. Both end points are
+    // stable and the biquad stability region is convex in (a1, a2), so every coefficient set along the ramp is stable too.
+    const std::array<float *, 5> rows = coefficient_rows(s);
+    for (unsigned int row = 0; row < 5; ++row)
+    {
+        for (unsigned int l = 0; l < BIQUAD_BANK_LANES; ++l)
+        {
+            ramp.step[row][l] = (ramp.target[row][l] - rows[row][l]) / ramp_frames_;
+        }
+    }
+    ramp.remaining_frames = ramp_frames_;
+    active_lanes_[index] |= lane_bit;
+}
+
+// Function to run a section over part of a block
+void BiquadBank::process_section(float *block, size_t nframes, BiquadBankSection &section, Ramp &ramp, uint32_t &active_lanes, uint32_t enabled_lanes)
+{
+    size_t offset = 0;
+    while (ramp.remaining_frames > 0 && offset < nframes)
+    {
+        // Run a few frames with the current coefficients, then step them towards the target
+        const size_t frames = std::min({RAMP_STEP_FRAMES, nframes - offset, ramp.remaining_frames});
+        kernels_.process(block + offset * BIQUAD_BANK_LANES, frames, section);
+        offset += frames;
+        ramp.remaining_frames -= frames;
+        const std::array<float *, 5> rows = coefficient_rows(section);
+        for (unsigned int row = 0; row < 5; ++row)
+        {
+            for (unsigned int lane = 0; lane < BIQUAD_BANK_LANES; ++lane)
+            {
+                // The last step lands exactly on the target instead of accumulating rounding errors
+                rows[row][lane] = ramp.remaining_frames > 0 ? rows[row][lane] + ramp.step[row][lane] * frames : ramp.target[row][lane];
+            }
+        }
+        // Lanes that were switched off stop costing anything once they are back at pass-through
+        if (ramp.remaining_frames == 0)
+        {
+            active_lanes = enabled_lanes;
+        }
+    }
+    if (offset < nframes && active_lanes != 0)
+    {
+        kernels_.process(block + offset * BIQUAD_BANK_LANES, nframes - offset, section);
+    }
+}
+
+// Function to process one group of channels
+void BiquadBank::process_group(unsigned int group, float *const *channels, size_t nframes)
+{
+    const unsigned int first = group * BIQUAD_BANK_LANES;
+    const unsigned int lanes = std::min(BIQUAD_BANK_LANES, channels_ - first);
+    BiquadBankSection *sections = &sections_[group * bands_];
+    Ramp *ramps = &ramps_[group * bands_];
+    const uint32_t *enabled_lanes = &enabled_lanes_[group * bands_];
+    uint32_t *active_lanes = &active_lanes_[group * bands_];
+
+    // Without any active band the group passes through unchanged
+    if (std::none_of(active_lanes, active_lanes + bands_, [](uint32_t lanes) { return lanes != 0; }))
+    {
+        return;
+    }
+
+    // Frame-major scratch block. Padding lanes of the last group stay silent.
+    alignas(32) float block[BIQUAD_BANK_CHUNK_FRAMES * BIQUAD_BANK_LANES] = {};
+    for (size_t position = 0; position < nframes; position += BIQUAD_BANK_CHUNK_FRAMES)
+    {
+        const size_t chunk = std::min(BIQUAD_BANK_CHUNK_FRAMES, nframes - position);
+        for (unsigned int lane = 0; lane < lanes; ++lane)
+        {
+            const float *source = channels[first + lane] + position;
+            for (size_t n = 0; n < chunk; ++n)
+            {
+                block[n * BIQUAD_BANK_LANES + lane] = source[n];
+            }
+        }
+        for (unsigned int band = 0; band < bands_; ++band)
+        {
+            if (active_lanes[band] != 0)
+            {
+                process_section(block, chunk, sections[band], ramps[band], active_lanes[band], enabled_lanes[band]);
+            }
+        }
+        for (unsigned int lane = 0; lane < lanes; ++lane)
+        {
+            float *destination = channels[first + lane] + position;
+            for (size_t n = 0; n < chunk; ++n)
+            {
+                destination[n] = block[n * BIQUAD_BANK_LANES + lane];
+            }
+        }
+    }
+}
+
+#endif // BIQUAD_BANK_H
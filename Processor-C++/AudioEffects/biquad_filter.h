@@ -1,172 +1,469 @@
 // biquad_filter.h
-// A BiquadFilter is a type of digital signal processing filter that uses a second-order recursive algorithm
+// A biquad filter is a type of digital signal processing filter that uses a second-order recursive algorithm
 // to filter signals. It is a versatile filter that can be used for a variety of filtering tasks, including
 // lowpass, highpass, bandpass, notch, allpass, and peaking. The filter works by processing each sample of
 // an input signal and producing a corresponding output sample based on the input and previous samples.
 // The coefficients of the filter determine the filter's cutoff frequency, resonance, and gain.
+// BiquadT holds the delay line and the difference equation, templated on the sample precision and the topology, and
+// design_biquad computes the coefficients of a FilterType from the filter parameters. The equalizer runs the coefficients
+// through the float direct form I sections of the BiquadBank; BiquadT is the per-channel reference the benchmarks measure
+// the bank and the other precisions and topologies against.
 
 #ifndef BIQUAD_FILTER_H
 #define BIQUAD_FILTER_H
 
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <string>
 #include <vector>
+#include <type_traits>
 
-class BiquadFilter
+// Normalized coefficients of a biquad section (a0 == 1). Plain data, so they can be passed to the audio thread through a lock-free queue.
+struct BiquadCoefficients
 {
+    double b0, b1, b2, a1, a2;
+};
+
+// Structure of the difference equation.
+// DirectForm1 keeps the last two inputs and outputs. It cannot overflow internally and tolerates coefficient changes well.
+// TransposedDirectForm2 keeps two accumulated states instead of four, and in double precision is the usual choice.
+enum class BiquadTopology
+{
+    DirectForm1,
+    TransposedDirectForm2
+};
+
+// One biquad section with Sample precision (float or double) arithmetic and delay line
+template <typename Sample, BiquadTopology Topology>
+class BiquadT
+{
+    static_assert(std::is_floating_point<Sample>::value, "BiquadT needs a floating point sample type");
+
 public:
-    // Constructor
-    explicit BiquadFilter(std::string filter_type, double sample_rate, double center_frequency, double q_factor, double gain_db);
-    // Destructor
-    ~BiquadFilter();
-    // set_params function
-    void set_params(std::string filter_type, double sample_rate, double center_frequency, double q_factor, double gain_db);
-    // Process function
-    short process(short sample);
-    // Functions to return filter parameters
-    std::string get_filter_type() const { return filter_type_; }
-    double get_sample_rate() const { return sample_rate_; }
-    double get_center_frequency() const { return center_frequency_; }
-    double get_q_factor() const { return q_factor_; }
-    double get_gain_db() const { return gain_db_; }
+    // Function to replace the coefficients, keeping the delay line so the signal continues smoothly
+    void set_coefficients(const BiquadCoefficients &coefficients)
+    {
+        b0_ = static_cast<Sample>(coefficients.b0);
+        b1_ = static_cast<Sample>(coefficients.b1);
+        b2_ = static_cast<Sample>(coefficients.b2);
+        a1_ = static_cast<Sample>(coefficients.a1);
+        a2_ = static_cast<Sample>(coefficients.a2);
+    }
+    // Function to clear the delay line
+    void reset() { s1_ = s2_ = s3_ = s4_ = 0; }
+    // Process function for a block of samples. Input and output may point to the same buffer.
+    void process(const float *in, float *out, size_t nframes);
 
 private:
-    // Filter parameters
-    std::string filter_type_ = "peaking";
-    double sample_rate_ = 44100;
-    double center_frequency_ = 1000;
-    double q_factor_ = 0.707;
-    double gain_db_ = 0;
-
-    // Coefficients of the numerator and denominator of the transfer function
-    double a0_, a1_, a2_, b0_, b1_, b2_;
-    // State variables (delay line)
-    double x1_ = 0, x2_ = 0, y1_ = 0, y2_ = 0;
+    // Coefficients, pass-through until set
+    Sample b0_ = 1, b1_ = 0, b2_ = 0, a1_ = 0, a2_ = 0;
+    // Delay line. Direct form I: x[n-1], x[n-2], y[n-1], y[n-2]. Transposed direct form II: the two states in s1_ and s2_.
+    Sample s1_ = 0, s2_ = 0, s3_ = 0, s4_ = 0;
 };
 
-// Constructor
-BiquadFilter::BiquadFilter(std::string filter_type, double sample_rate, double center_frequency, double q_factor, double gain_db)
+// Process function for a block of samples
+template <typename Sample, BiquadTopology Topology>
+void BiquadT<Sample, Topology>::process(const float *in, float *out, size_t nframes)
 {
-    set_params(filter_type, sample_rate, center_frequency, q_factor, gain_db);
+    // Copy the delay line into locals so the compiler can keep it in registers for the whole block
+    Sample s1 = s1_, s2 = s2_, s3 = s3_, s4 = s4_;
+
+    for (size_t n = 0; n < nframes; ++n)
+    {
+        const Sample x0 = in[n];
+        Sample y0;
+        if constexpr (Topology == BiquadTopology::DirectForm1)
+        {
+            // y[n] = b0*x[n] + b1*x[n-1] + b2*x[n-2] - a1*y[n-1] - a2*y[n-2]
+            y0 = b0_ * x0 + b1_ * s1 + b2_ * s2 - a1_ * s3 - a2_ * s4;
+            s2 = s1;
+            s1 = x0;
+            s4 = s3;
+            s3 = y0;
+        }
+        else
+        {
+            // y[n] = b0*x[n] + s1; s1 = b1*x[n] - a1*y[n] + s2; s2 = b2*x[n] - a2*y[n]
+            y0 = b0_ * x0 + s1;
+            s1 = b1_ * x0 - a1_ * y0 + s2;
+            s2 = b2_ * x0 - a2_ * y0;
+        }
+        out[n] = static_cast<float>(y0);
+    }
+
+    // Store the delay line back for the next block
+    s1_ = s1;
+    s2_ = s2;
+    s3_ = s3;
+    s4_ = s4;
 }
 
-// Destructor
-BiquadFilter::~BiquadFilter()
+// Filter designs, after Robert Bristow-Johnson's Audio EQ Cookbook. The string forms are the names used by the WebSocket
+// commands and the database; they are parsed once where a command enters the processor, everything behind that uses the enum.
+enum class FilterType
+{
+    Peaking,
+    LowPass,
+    HighPass,
+    // Constant 0 dB peak gain
+    BandPass,
+    // Constant skirt gain, peak gain = Q
+    BandPassSkirt,
+    Notch,
+    AllPass,
+    LowShelf,
+    HighShelf,
+    // First order, the Q factor is ignored
+    LowPass1,
+    HighPass1,
+    // First order tilt around the center frequency: gain_db / 2 above it and -gain_db / 2 below it, the Q factor is ignored
+    Tilt
+};
+
+// Every filter type, in the order of the enum
+constexpr FilterType FILTER_TYPES[] = {FilterType::Peaking, FilterType::LowPass, FilterType::HighPass, FilterType::BandPass,
+                                       FilterType::BandPassSkirt, FilterType::Notch, FilterType::AllPass, FilterType::LowShelf,
+                                       FilterType::HighShelf, FilterType::LowPass1, FilterType::HighPass1, FilterType::Tilt};
+
+// Function to return the name of a filter type as used by the WebSocket commands and the database
+constexpr const char *filter_type_name(FilterType filter_type)
 {
+    switch (filter_type)
+    {
+    case FilterType::Peaking:
+        return "peaking";
+    case FilterType::LowPass:
+        return "lowpass";
+    case FilterType::HighPass:
+        return "highpass";
+    case FilterType::BandPass:
+        return "bandpass";
+    case FilterType::BandPassSkirt:
+        return "bandpass_csg";
+    case FilterType::Notch:
+        return "notch";
+    case FilterType::AllPass:
+        return "allpass";
+    case FilterType::LowShelf:
+        return "lowshelf";
+    case FilterType::HighShelf:
+        return "highshelf";
+    case FilterType::LowPass1:
+        return "lowpass1";
+    case FilterType::HighPass1:
+        return "highpass1";
+    case FilterType::Tilt:
+        return "tilt";
+    }
+    return "";
 }
 
-// Function to set up filter coefficients depending on filter type
-void BiquadFilter::set_params(std::string filter_type, double sample_rate, double center_frequency, double q_factor, double gain_db)
+// Function to parse the name of a filter type. Returns false and leaves filter_type untouched if the name is unknown.
+inline bool parse_filter_type(const std::string &name, FilterType &filter_type)
 {
-    // Set filter parameters
-    filter_type_ = filter_type;
-    sample_rate_ = sample_rate;
-    center_frequency_ = center_frequency;
-    q_factor_ = q_factor;
-    gain_db_ = gain_db;
-
-    // Calculate linear gain from gain in decibels
-    double gain = std::pow(10, gain_db / 20.0);
-
-    // Variables for filter coefficients
-    double a0, a1, a2, b0, b1, b2;
-    // Normalized angular frequency in radians
-    double w0 = 2 * M_PI * center_frequency / sample_rate;
-    // Alpha value, a parameter for computing filter coefficients
-    double alpha = std::sin(w0) / (2 * q_factor);
-    // Cosine of the normalized angular frequency
-    double cos_w0 = std::cos(w0);
-
-    // The following formulas for b0, b1, b2, a0, a1, and a2 are derived from the
-    // transfer function of a constant 0 dB peak gain bandpass filter
-    // The bilinear transformation is a technique used to convert continuous-time (analog) filters to discrete-time (digital) filters.
-    // It is done by substituting the Laplace transform variable s with a function of the discrete-time Fourier transform variable z.
-    // The bilinear transform is defined as:
-    // s = (2 * (z - 1)) / (T * (z + 1))
-    // where T is the sampling period.
-    if (filter_type == "lowpass")
+    for (FilterType candidate : FILTER_TYPES)
     {
-        // Analog transfer function H(s) = 1 / (s^2 + s/Q + 1)
-        // Applying the bilinear transformation and solving for H(z), we get:
-        // H(z) = (b0 + b1 * z^(-1) + b2 * z^(-2)) / (a0 + a1 * z^(-1) + a2 * z^(-2))
-        double K = std::tan(M_PI * center_frequency / sample_rate);
-        double norm = 1 / (1 + K / q_factor + K * K);
-        b0 = K * K * norm;
-        b1 = 2 * b0;
-        b2 = b0;
-        a0 = 1;
-        a1 = 2 * (K * K - 1) * norm;
-        a2 = (1 - K / q_factor + K * K) * norm;
+        if (name == filter_type_name(candidate))
+        {
+            filter_type = candidate;
+            return true;
+        }
     }
-    else if (filter_type == "highpass")
+    return false;
+}
+
+// The <cmath> functions are not constexpr, so the filter design uses these. Their arguments are kept in the ranges the
+// design needs, where the series converge to double precision.
+namespace biquad_math
+{
+    // Sine for |x| <= pi / 2
+    constexpr double sin(double x)
+    {
+        double term = x, sum = x;
+        for (int n = 1; n < 14; ++n)
+        {
+            term *= -x * x / ((2 * n) * (2 * n + 1));
+            sum += term;
+        }
+        return sum;
+    }
+
+    // Exponential function. Halves the argument until the series converges fast, then squares the result back.
+    constexpr double exp(double x)
     {
-        // Analog transfer function H(s) = s^2 / (s^2 + s/Q + 1)
-        // Applying the bilinear transformation and solving for H(z), we get:
-        // H(z) = (b0 + b1 * z^(-1) + b2 * z^(-2)) / (a0 + a1 * z^(-1) + a2 * z^(-2))
-        double K = std::tan(M_PI * center_frequency / sample_rate);
-        double norm = 1 / (1 + K / q_factor + K * K);
-        b0 = norm;
-        b1 = -2 * b0;
-        b2 = b0;
-        a0 = 1;
-        a1 = 2 * (K * K - 1) * norm;
-        a2 = (1 - K / q_factor + K * K) * norm;
+        if (x > 709.0)
+        {
+            return std::numeric_limits<double>::infinity();
+        }
+        if (x < -745.0)
+        {
+            return 0.0;
+        }
+        int halvings = 0;
+        while (x > 0.5 || x < -0.5)
+        {
+            x /= 2;
+            ++halvings;
+        }
+        double term = 1.0, sum = 1.0;
+        for (int n = 1; n < 20; ++n)
+        {
+            term *= x / n;
+            sum += term;
+        }
+        for (int i = 0; i < halvings; ++i)
+        {
+            sum *= sum;
+        }
+        return sum;
     }
-    else if (filter_type == "notch")
+
+    // Square root for x >= 0 by Newton's method, which converges from above once the guess is at least the root
+    constexpr double sqrt(double x)
+    {
+        if (!(x > 0.0))
+        {
+            return 0.0;
+        }
+        double y = x > 1.0 ? x : 1.0;
+        for (int i = 0; i < 2100; ++i)
+        {
+            double next = 0.5 * (y + x / y);
+            if (!(next < y))
+            {
+                break;
+            }
+            y = next;
+        }
+        return y;
+    }
+
+    // Function to tell whether x is neither infinite nor NaN
+    constexpr bool is_finite(double x)
+    {
+        return x == x && x - x == 0.0;
+    }
+} // namespace biquad_math
+
+// Function to compute the normalized coefficients of a filter design. Usable in constant expressions, so fixed presets can
+// be computed at compile time. Parameters the design cannot realize (a sample rate or Q factor that is not positive, a
+// center frequency outside 0 to Nyquist, non-finite values) give a pass-through filter instead of garbage coefficients.
+constexpr BiquadCoefficients design_biquad(FilterType filter_type, double sample_rate, double center_frequency, double q_factor, double gain_db)
+{
+    const BiquadCoefficients pass_through{1.0, 0.0, 0.0, 0.0, 0.0};
+    if (!biquad_math::is_finite(sample_rate) || !biquad_math::is_finite(center_frequency) || !biquad_math::is_finite(q_factor) ||
+        !biquad_math::is_finite(gain_db) || !(sample_rate > 0.0) || !(center_frequency > 0.0) || !(center_frequency < sample_rate / 2) ||
+        !(q_factor > 0.0))
+    {
+        return pass_through;
+    }
+
+    // Normalized angular frequency in radians, 0 < w0 < pi
+    const double w0 = 2 * M_PI * center_frequency / sample_rate;
+    const double sin_w0 = w0 <= M_PI / 2 ? biquad_math::sin(w0) : biquad_math::sin(M_PI - w0);
+    const double cos_w0 = biquad_math::sin(M_PI / 2 - w0);
+    // Alpha value, a parameter for computing filter coefficients
+    const double alpha = sin_w0 / (2 * q_factor);
+    // Square root of the linear gain, as the peaking and shelving designs use it
+    const double a = biquad_math::exp(gain_db / 40.0 * M_LN10);
+    const double two_sqrt_a_alpha = 2 * biquad_math::sqrt(a) * alpha;
+    // Prewarped frequency tan(w0 / 2) of the first order designs
+    const double k = sin_w0 / (1 + cos_w0);
+
+    // The designs apply the bilinear transform s = (1 / tan(w0 / 2)) * (1 - z^-1) / (1 + z^-1) to the analog prototype
+    // H(s) given for each type, with s normalized to the center frequency
+    double b0 = 1, b1 = 0, b2 = 0, a0 = 1, a1 = 0, a2 = 0;
+    switch (filter_type)
     {
-        // H(s) = (s^2 + 1) / (s^2 + s/Q + 1)
-        // Applying the bilinear transformation and solving for H(z), we get:
-        // H(z) = (b0 + b1 * z^(-1) + b2 * z^(-2)) / (a0 + a1 * z^(-1) + a2 * z^(-2))
+    case FilterType::Peaking:
+        // H(s) = (s^2 + s * (A / Q) + 1) / (s^2 + s / (A * Q) + 1)
+        b0 = 1 + alpha * a;
+        b1 = -2 * cos_w0;
+        b2 = 1 - alpha * a;
+        a0 = 1 + alpha / a;
+        a1 = -2 * cos_w0;
+        a2 = 1 - alpha / a;
+        break;
+    case FilterType::LowPass:
+        // H(s) = 1 / (s^2 + s / Q + 1)
+        b0 = (1 - cos_w0) / 2;
+        b1 = 1 - cos_w0;
+        b2 = (1 - cos_w0) / 2;
+        a0 = 1 + alpha;
+        a1 = -2 * cos_w0;
+        a2 = 1 - alpha;
+        break;
+    case FilterType::HighPass:
+        // H(s) = s^2 / (s^2 + s / Q + 1)
+        b0 = (1 + cos_w0) / 2;
+        b1 = -(1 + cos_w0);
+        b2 = (1 + cos_w0) / 2;
+        a0 = 1 + alpha;
+        a1 = -2 * cos_w0;
+        a2 = 1 - alpha;
+        break;
+    case FilterType::BandPass:
+        // H(s) = (s / Q) / (s^2 + s / Q + 1)
+        b0 = alpha;
+        b1 = 0;
+        b2 = -alpha;
+        a0 = 1 + alpha;
+        a1 = -2 * cos_w0;
+        a2 = 1 - alpha;
+        break;
+    case FilterType::BandPassSkirt:
+        // H(s) = s / (s^2 + s / Q + 1)
+        b0 = q_factor * alpha;
+        b1 = 0;
+        b2 = -q_factor * alpha;
+        a0 = 1 + alpha;
+        a1 = -2 * cos_w0;
+        a2 = 1 - alpha;
+        break;
+    case FilterType::Notch:
+        // H(s) = (s^2 + 1) / (s^2 + s / Q + 1)
         b0 = 1;
         b1 = -2 * cos_w0;
         b2 = 1;
         a0 = 1 + alpha;
         a1 = -2 * cos_w0;
         a2 = 1 - alpha;
-    }
-    else if (filter_type == "peaking")
-    {
-        double a = std::sqrt(gain);
-        double alpha_a = alpha * a;
-        double alpha_d = alpha / a;
-
-        b0 = 1 + alpha_a;
+        break;
+    case FilterType::AllPass:
+        // H(s) = (s^2 - s / Q + 1) / (s^2 + s / Q + 1)
+        b0 = 1 - alpha;
         b1 = -2 * cos_w0;
-        b2 = 1 - alpha_a;
-        a0 = 1 + alpha_d;
+        b2 = 1 + alpha;
+        a0 = 1 + alpha;
         a1 = -2 * cos_w0;
-        a2 = 1 - alpha_d;
+        a2 = 1 - alpha;
+        break;
+    case FilterType::LowShelf:
+        // H(s) = A * (s^2 + s * sqrt(A) / Q + A) / (A * s^2 + s * sqrt(A) / Q + 1)
+        b0 = a * ((a + 1) - (a - 1) * cos_w0 + two_sqrt_a_alpha);
+        b1 = 2 * a * ((a - 1) - (a + 1) * cos_w0);
+        b2 = a * ((a + 1) - (a - 1) * cos_w0 - two_sqrt_a_alpha);
+        a0 = (a + 1) + (a - 1) * cos_w0 + two_sqrt_a_alpha;
+        a1 = -2 * ((a - 1) + (a + 1) * cos_w0);
+        a2 = (a + 1) + (a - 1) * cos_w0 - two_sqrt_a_alpha;
+        break;
+    case FilterType::HighShelf:
+        // H(s) = A * (A * s^2 + s * sqrt(A) / Q + 1) / (s^2 + s * sqrt(A) / Q + A)
+        b0 = a * ((a + 1) + (a - 1) * cos_w0 + two_sqrt_a_alpha);
+        b1 = -2 * a * ((a - 1) + (a + 1) * cos_w0);
+        b2 = a * ((a + 1) + (a - 1) * cos_w0 - two_sqrt_a_alpha);
+        a0 = (a + 1) - (a - 1) * cos_w0 + two_sqrt_a_alpha;
+        a1 = 2 * ((a - 1) - (a + 1) * cos_w0);
+        a2 = (a + 1) - (a - 1) * cos_w0 - two_sqrt_a_alpha;
+        break;
+    case FilterType::LowPass1:
+        // H(s) = 1 / (s + 1)
+        b0 = k;
+        b1 = k;
+        a0 = k + 1;
+        a1 = k - 1;
+        break;
+    case FilterType::HighPass1:
+        // H(s) = s / (s + 1)
+        b0 = 1;
+        b1 = -1;
+        a0 = k + 1;
+        a1 = k - 1;
+        break;
+    case FilterType::Tilt:
+        // H(s) = (A * s + 1) / (s + A), which has gain 1 / A at DC, A at Nyquist and 1 at the center frequency
+        b0 = a + k;
+        b1 = k - a;
+        a0 = 1 + a * k;
+        a1 = a * k - 1;
+        break;
+    default:
+        return pass_through;
     }
 
     // Normalize filter coefficients
-    double norm = 1 / a0;
-    a0_ = 1;
-    a1_ = a1 * norm;
-    a2_ = a2 * norm;
-    b0_ = b0 * norm;
-    b1_ = b1 * norm;
-    b2_ = b2 * norm;
+    const BiquadCoefficients coefficients{b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0};
+    if (!biquad_math::is_finite(coefficients.b0) || !biquad_math::is_finite(coefficients.b1) || !biquad_math::is_finite(coefficients.b2) ||
+        !biquad_math::is_finite(coefficients.a1) || !biquad_math::is_finite(coefficients.a2))
+    {
+        return pass_through;
+    }
+    return coefficients;
 }
 
-// Process function for a single sample
-short BiquadFilter::process(short sample)
+// Frequency response of a cascade of sections: magnitude in dB and phase in degrees (-180, 180] at each frequency in Hz
+struct FrequencyResponse
+{
+    std::vector<double> frequencies;
+    std::vector<double> magnitude_db;
+    std::vector<double> phase_deg;
+};
+
+// Function to return points frequencies spaced logarithmically from min_frequency to max_frequency
+inline std::vector<double> log_spaced_frequencies(size_t points, double min_frequency, double max_frequency)
 {
-    // Convert input sample to a double
-    double in = sample;
-
-    // Calculate filter output
-    // difference equation y[n] = b0*x[n] + b1*x[n-1] + b2*x[n-2] - a1*y[n-1] - a2*y[n-2],
-    // where y[n] is the output sample, x[n] is the input sample, and a and b are the filter coefficients.
-    double out = b0_ * in + b1_ * x1_ + b2_ * x2_ - a1_ * y1_ - a2_ * y2_;
-
-    // Update the delay line (state variables) by shifting the previous
-    // input and output samples to the right and storing the current input and output samples
-    x2_ = x1_;
-    x1_ = in;
-    y2_ = y1_;
-    y1_ = out;
-
-    // Convert the output to a short and return it
-    return static_cast<short>(out);
+    std::vector<double> frequencies(points, min_frequency);
+    const double ratio = points > 1 ? std::log(max_frequency / min_frequency) / (points - 1) : 0.0;
+    for (size_t i = 1; i < points; ++i)
+    {
+        frequencies[i] = min_frequency * std::exp(ratio * i);
+    }
+    return frequencies;
+}
+
+// Function to evaluate H(e^jw) of the sections of coefficients whose bit is set in enabled_mask at response.frequencies and
+// fill in the magnitude and phase of their product. The sections are applied one at a time to the complex response of all
+// frequencies, kept in separate real and imaginary arrays, so the loops over the frequencies vectorize.
+void evaluate_biquad_response(const BiquadCoefficients *coefficients, uint32_t enabled_mask, unsigned int sections, double sample_rate,
+                              FrequencyResponse &response)
+{
+    const size_t points = response.frequencies.size();
+    // z^-1 and z^-2 on the unit circle, as cos - j sin
+    std::vector<double> cos1(points), sin1(points), cos2(points), sin2(points);
+    for (size_t i = 0; i < points; ++i)
+    {
+        const double omega = 2.0 * M_PI * response.frequencies[i] / sample_rate;
+        cos1[i] = std::cos(omega);
+        sin1[i] = std::sin(omega);
+        cos2[i] = cos1[i] * cos1[i] - sin1[i] * sin1[i];
+        sin2[i] = 2.0 * sin1[i] * cos1[i];
+    }
+
+    std::vector<double> re(points, 1.0), im(points, 0.0);
+    for (unsigned int s = 0; s < sections; ++s)
+    {
+        if (!((enabled_mask >> s) & 1u))
+        {
+            continue;
+        }
+        const BiquadCoefficients &c = coefficients[s];
+        for (size_t i = 0; i < points; ++i)
+        {
+            // H = N / D = N * conj(D) / |D|^2
+            const double n_re = c.b0 + c.b1 * cos1[i] + c.b2 * cos2[i];
+            const double n_im = -(c.b1 * sin1[i] + c.b2 * sin2[i]);
+            const double d_re = 1.0 + c.a1 * cos1[i] + c.a2 * cos2[i];
+            const double d_im = -(c.a1 * sin1[i] + c.a2 * sin2[i]);
+            const double d_norm = d_re * d_re + d_im * d_im;
+            const double h_re = (n_re * d_re + n_im * d_im) / d_norm;
+            const double h_im = (n_im * d_re - n_re * d_im) / d_norm;
+            const double product_re = re[i] * h_re - im[i] * h_im;
+            im[i] = re[i] * h_im + im[i] * h_re;
+            re[i] = product_re;
+        }
+    }
+
+    // Zeros of notches are reported as -200 dB, which unlike -inf survives JSON
+    response.magnitude_db.resize(points);
+    response.phase_deg.resize(points);
+    for (size_t i = 0; i < points; ++i)
+    {
+        response.magnitude_db[i] = 10.0 * std::log10(std::max(re[i] * re[i] + im[i] * im[i], 1e-20));
+        response.phase_deg[i] = std::atan2(im[i], re[i]) * 180.0 / M_PI;
+    }
 }
 
 #endif // BIQUAD_FILTER_H
\ No newline at end of file
@@ -0,0 +1,54 @@
+// bus.h
+// Creates a bus (subgroup or aux send) channel strip: the equalizer, volume and mute of one mixer bus, controlled like any
+// channel with the channel type "bus". The mixer runs a bus's strip right after mixing the bus and before mixing anything the
+// bus feeds, so the bus has an equalizer bank of its own instead of sharing one with other channels in lockstep.
+
+#ifndef BUS_H
+#define BUS_H
+
+#include <string>
+#include <memory>
+#include "equalizer.h"
+#include "biquad_bank.h"
+#include "gain.h"
+#include "mute.h"
+
+class Bus
+{
+public:
+    // Constructor. Equalizer filter changes are ramped over eq_ramp_frames frames and volume changes over gain_ramp_frames
+    // frames with the shape gain_ramp; partition_frames is the partition size of the linear-phase equalizer convolution.
+    explicit Bus(double sample_rate, unsigned int bus_number, size_t eq_ramp_frames = 0, size_t gain_ramp_frames = 0,
+                 GainRamp gain_ramp = GainRamp::Exponential, size_t partition_frames = 128)
+        : equalizer_bank_(1, Equalizer::MAX_FILTERS, eq_ramp_frames),
+          equalizer_(sample_rate, "bus", bus_number, partition_frames),
+          volume_("bus", bus_number, gain_ramp_frames, gain_ramp),
+          mute_("bus", bus_number)
+    {
+    }
+
+    // Function to size the buffers for blocks of up to max_frames frames. Called from the audio thread before processing.
+    void allocate(size_t max_frames) { equalizer_.allocate(max_frames); }
+
+    // Function to process a block of the bus in place through the equalizer, volume and mute. Called from the audio thread only.
+    void process(float *buffer, size_t nframes);
+
+private:
+    BiquadBank equalizer_bank_;
+    Equalizer equalizer_;
+    Gain volume_;
+    Mute mute_;
+};
+
+// Function to process a block of the bus
+void Bus::process(float *buffer, size_t nframes)
+{
+    float *channel[1] = {buffer};
+    equalizer_.update(equalizer_bank_, 0);
+    equalizer_bank_.process_group(0, channel, nframes);
+    equalizer_.process(channel, channel, nframes);
+    volume_.process(channel, channel, nframes);
+    mute_.process(channel, channel, nframes);
+}
+
+#endif // BUS_H
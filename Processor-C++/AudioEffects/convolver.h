@@ -0,0 +1,707 @@
+// convolver.h
+// FIR convolution of one output channel with a long impulse response loaded from a WAV file, for room correction.
+// The convolution is uniformly partitioned overlap-save in the frequency domain: the impulse response is cut into partitions
+// of B taps whose spectra are computed once, when the file is loaded. Every B input frames, the spectrum of the last 2B input
+// frames is stored in a ring of input spectra, every input spectrum is multiplied with the spectrum of the partition whose
+// delay it has, and the inverse FFT of the sum yields B output frames. The cost per frame grows with the number of partitions
+// only through the complex multiply-accumulate over the bins of each partition, which has SSE2 and AVX2 variants on x86 and a
+// NEON one on ARM, and keeps its spectra in split real and imaginary arrays so each runs straight through vector registers.
+// B is chosen from the period the device negotiated, so every period holds whole partitions and the convolution adds no
+// latency. Periods that are not a multiple of B go through a FIFO of B frames, which adds B frames of latency.
+// Impulse responses are loaded and transformed on the control side and handed to the audio thread by a ConvolutionRunner,
+// which also serves the linear-phase equalizers.
+
+#ifndef CONVOLVER_H
+#define CONVOLVER_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include "fft.h"
+#include "../Utilities/event_manager.h"
+#include "../Utilities/type_aliases.h"
+#include "../Utilities/triple_buffer.h"
+#include "../Utilities/spsc_queue.h"
+#include "../Utilities/wav_file.h"
+#include "../Utilities/aligned_allocator.h"
+#include "../Utilities/cpu_dispatch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CONVOLUTION_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CONVOLUTION_NEON 1
+#endif
+
+// Limits of the partition size. Partitions are a multiple of 8 bins, the widest kernel step.
+constexpr size_t CONVOLUTION_MIN_PARTITION_FRAMES = 16;
+constexpr size_t CONVOLUTION_MAX_PARTITION_FRAMES = 1024;
+
+// Function to choose the partition size for a period: the largest power of two that divides the period, within the limits
+inline size_t convolution_partition_frames(size_t period_frames)
+{
+    size_t partition_frames = CONVOLUTION_MIN_PARTITION_FRAMES;
+    while (partition_frames < CONVOLUTION_MAX_PARTITION_FRAMES && period_frames % (partition_frames * 2) == 0)
+    {
+        partition_frames *= 2;
+    }
+    return partition_frames;
+}
+
+// Complex multiply-accumulate kernel for one instruction set
+struct ConvolutionKernels
+{
+    // Adds the products of bins complex values of x and h to acc. bins is a multiple of 8.
+    void (*multiply_accumulate)(const float *x_re, const float *x_im, const float *h_re, const float *h_im, float *acc_re, float *acc_im, size_t bins);
+    // Number of bins per instruction and name of the instruction set, for logging
+    unsigned int width;
+    const char *name;
+};
+
+// Scalar kernel, one bin at a time, used on CPUs without SSE2 or NEON
+void convolution_mac_scalar(const float *x_re, const float *x_im, const float *h_re, const float *h_im, float *acc_re, float *acc_im, size_t bins)
+{
+    for (size_t k = 0; k < bins; ++k)
+    {
+        acc_re[k] += x_re[k] * h_re[k] - x_im[k] * h_im[k];
+        acc_im[k] += x_re[k] * h_im[k] + x_im[k] * h_re[k];
+    }
+}
+
+#if defined(CONVOLUTION_X86)
+// SSE2 kernel, 4 bins per instruction
+__attribute__((target("sse2"))) void convolution_mac_sse2(const float *x_re, const float *x_im, const float *h_re, const float *h_im, float *acc_re, float *acc_im, size_t bins)
+{
+    for (size_t k = 0; k < bins; k += 4)
+    {
+        const __m128 xr = _mm_load_ps(x_re + k), xi = _mm_load_ps(x_im + k), hr = _mm_load_ps(h_re + k), hi = _mm_load_ps(h_im + k);
+        _mm_store_ps(acc_re + k, _mm_add_ps(_mm_load_ps(acc_re + k), _mm_sub_ps(_mm_mul_ps(xr, hr), _mm_mul_ps(xi, hi))));
+        _mm_store_ps(acc_im + k, _mm_add_ps(_mm_load_ps(acc_im + k), _mm_add_ps(_mm_mul_ps(xr, hi), _mm_mul_ps(xi, hr))));
+    }
+}
+
+// AVX2 kernel, 8 bins per instruction
+__attribute__((target("avx2"))) void convolution_mac_avx2(const float *x_re, const float *x_im, const float *h_re, const float *h_im, float *acc_re, float *acc_im, size_t bins)
+{
+    for (size_t k = 0; k < bins; k += 8)
+    {
+        const __m256 xr = _mm256_load_ps(x_re + k), xi = _mm256_load_ps(x_im + k), hr = _mm256_load_ps(h_re + k), hi = _mm256_load_ps(h_im + k);
+        _mm256_store_ps(acc_re + k, _mm256_add_ps(_mm256_load_ps(acc_re + k), _mm256_sub_ps(_mm256_mul_ps(xr, hr), _mm256_mul_ps(xi, hi))));
+        _mm256_store_ps(acc_im + k, _mm256_add_ps(_mm256_load_ps(acc_im + k), _mm256_add_ps(_mm256_mul_ps(xr, hi), _mm256_mul_ps(xi, hr))));
+    }
+}
+#endif // CONVOLUTION_X86
+
+#if defined(CONVOLUTION_NEON)
+// NEON kernel, 4 bins per instruction
+void convolution_mac_neon(const float *x_re, const float *x_im, const float *h_re, const float *h_im, float *acc_re, float *acc_im, size_t bins)
+{
+    for (size_t k = 0; k < bins; k += 4)
+    {
+        const float32x4_t xr = vld1q_f32(x_re + k), xi = vld1q_f32(x_im + k), hr = vld1q_f32(h_re + k), hi = vld1q_f32(h_im + k);
+        vst1q_f32(acc_re + k, vmlsq_f32(vmlaq_f32(vld1q_f32(acc_re + k), xr, hr), xi, hi));
+        vst1q_f32(acc_im + k, vmlaq_f32(vmlaq_f32(vld1q_f32(acc_im + k), xr, hi), xi, hr));
+    }
+}
+#endif // CONVOLUTION_NEON
+
+// Returns the multiply-accumulate kernels this CPU can run, narrowest first
+std::vector<ConvolutionKernels> get_supported_convolution_kernels()
+{
+    std::vector<ConvolutionKernels> supported = {{convolution_mac_scalar, 1, "scalar"}};
+#if defined(CONVOLUTION_X86)
+    if (__builtin_cpu_supports("sse2"))
+    {
+        supported.push_back({convolution_mac_sse2, 4, "SSE2"});
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        supported.push_back({convolution_mac_avx2, 8, "AVX2"});
+    }
+#elif defined(CONVOLUTION_NEON)
+    supported.push_back({convolution_mac_neon, 4, "NEON"});
+#endif
+    return supported;
+}
+
+// Returns the multiply-accumulate kernel the engines run with
+const ConvolutionKernels &get_convolution_kernels()
+{
+    return select_widest_kernels<ConvolutionKernels, get_supported_convolution_kernels>();
+}
+
+// Spectrum or time block of an engine, aligned to the 32 bytes of an AVX2 register
+using ConvolutionBuffer = std::vector<float, AlignedAllocator<float, 32>>;
+
+// Filter spectra and running state of the convolution of one channel with one impulse response
+class ConvolutionEngine
+{
+public:
+    // Constructor. Cuts impulse_response into partitions of partition_frames taps and transforms them.
+    // kernels selects the multiply-accumulate kernel; nullptr uses the widest one supported by the CPU.
+    ConvolutionEngine(const std::vector<float> &impulse_response, size_t partition_frames, const ConvolutionKernels *kernels = nullptr);
+
+    // Function to take over the input history of the engine this one replaces, so its output continues without a gap.
+    // Both engines must use the same partition size. Called from the audio thread.
+    void continue_from(const ConvolutionEngine &previous);
+
+    // Function to convolve nframes frames of in into out. in and out may be the same buffer. Called from the audio thread only.
+    void process(const float *in, float *out, size_t nframes);
+
+    size_t get_partition_frames() const { return partition_frames_; }
+    size_t get_partition_count() const { return partition_count_; }
+    size_t get_taps() const { return taps_; }
+
+private:
+    // Function to convolve the partition of input frames in the upper half of input_ into the upper half of output_
+    void process_partition();
+
+    size_t partition_frames_;
+    size_t partition_count_;
+    size_t taps_;
+    ConvolutionKernels kernels_;
+    RealFft fft_;
+    // Spectra of the impulse response partitions, indexed [partition * partition_frames_ + bin], scaled by 1 / FFT size
+    ConvolutionBuffer filter_re_, filter_im_;
+    // Ring of input spectra, indexed like the filter spectra. Slot newest_ holds the newest spectrum and the slot after it
+    // the one before, so the spectrum of partition delay p sits at slot (newest_ + p) % partition_count_.
+    ConvolutionBuffer input_spectra_re_, input_spectra_im_;
+    size_t newest_ = 0;
+    // Sum of the spectrum products
+    ConvolutionBuffer sum_re_, sum_im_;
+    // Last two partitions of input frames, and the inverse FFT whose upper half is the output of the newest partition
+    std::vector<float> input_, output_;
+    // Frames of the current partition already passed through the FIFO
+    size_t fifo_position_ = 0;
+};
+
+// Constructor
+ConvolutionEngine::ConvolutionEngine(const std::vector<float> &impulse_response, size_t partition_frames, const ConvolutionKernels *kernels)
+    : partition_frames_(partition_frames),
+      partition_count_(std::max<size_t>(1, (impulse_response.size() + partition_frames - 1) / partition_frames)),
+      taps_(impulse_response.size()),
+      kernels_(kernels ? *kernels : get_convolution_kernels()),
+      fft_(2 * partition_frames),
+      filter_re_(partition_count_ * partition_frames, 0.0f),
+      filter_im_(partition_count_ * partition_frames, 0.0f),
+      input_spectra_re_(partition_count_ * partition_frames, 0.0f),
+      input_spectra_im_(partition_count_ * partition_frames, 0.0f),
+      sum_re_(partition_frames, 0.0f),
+      sum_im_(partition_frames, 0.0f),
+      input_(2 * partition_frames, 0.0f),
+      output_(2 * partition_frames, 0.0f)
+{
+    // Each partition is zero-padded to the FFT size. The inverse FFT is unnormalized, so its scale is folded in here.
+    std::vector<float> padded(2 * partition_frames);
+    const float scale = 1.0f / (2 * partition_frames);
+    for (size_t partition = 0; partition < partition_count_; ++partition)
+    {
+        std::fill(padded.begin(), padded.end(), 0.0f);
+        const size_t first = partition * partition_frames;
+        const size_t last = std::min(first + partition_frames, impulse_response.size());
+        for (size_t n = first; n < last; ++n)
+        {
+            padded[n - first] = impulse_response[n] * scale;
+        }
+        fft_.forward(padded.data(), &filter_re_[first], &filter_im_[first]);
+    }
+}
+
+// Function to take over the input history of the previous engine
+void ConvolutionEngine::continue_from(const ConvolutionEngine &previous)
+{
+    const size_t bins = partition_frames_;
+    const size_t partitions = std::min(partition_count_, previous.partition_count_);
+    newest_ = 0;
+    for (size_t p = 0; p < partitions; ++p)
+    {
+        const size_t slot = (previous.newest_ + p) % previous.partition_count_;
+        std::memcpy(&input_spectra_re_[p * bins], &previous.input_spectra_re_[slot * bins], bins * sizeof(float));
+        std::memcpy(&input_spectra_im_[p * bins], &previous.input_spectra_im_[slot * bins], bins * sizeof(float));
+    }
+    std::fill(input_spectra_re_.begin() + partitions * bins, input_spectra_re_.end(), 0.0f);
+    std::fill(input_spectra_im_.begin() + partitions * bins, input_spectra_im_.end(), 0.0f);
+    input_ = previous.input_;
+    // The FIFO keeps emitting what is left of the previous engine's last partition
+    output_ = previous.output_;
+    fifo_position_ = previous.fifo_position_;
+}
+
+// Function to convolve one partition
+void ConvolutionEngine::process_partition()
+{
+    const size_t bins = partition_frames_;
+    newest_ = newest_ == 0 ? partition_count_ - 1 : newest_ - 1;
+    fft_.forward(input_.data(), &input_spectra_re_[newest_ * bins], &input_spectra_im_[newest_ * bins]);
+
+    // Bin 0 packs the real DC and Nyquist bins, which are multiplied as two real values instead of as one complex value
+    std::fill(sum_re_.begin(), sum_re_.end(), 0.0f);
+    std::fill(sum_im_.begin(), sum_im_.end(), 0.0f);
+    float dc = 0.0f, nyquist = 0.0f;
+    for (size_t p = 0; p < partition_count_; ++p)
+    {
+        const size_t slot = newest_ + p < partition_count_ ? newest_ + p : newest_ + p - partition_count_;
+        const float *x_re = &input_spectra_re_[slot * bins], *x_im = &input_spectra_im_[slot * bins];
+        const float *h_re = &filter_re_[p * bins], *h_im = &filter_im_[p * bins];
+        kernels_.multiply_accumulate(x_re, x_im, h_re, h_im, sum_re_.data(), sum_im_.data(), bins);
+        dc += x_re[0] * h_re[0];
+        nyquist += x_im[0] * h_im[0];
+    }
+    sum_re_[0] = dc;
+    sum_im_[0] = nyquist;
+
+    // Overlap-save: the lower half of the inverse FFT is wrapped around and discarded
+    fft_.inverse(sum_re_.data(), sum_im_.data(), output_.data());
+    std::memcpy(input_.data(), input_.data() + bins, bins * sizeof(float));
+}
+
+// Function to convolve a block
+void ConvolutionEngine::process(const float *in, float *out, size_t nframes)
+{
+    const size_t bins = partition_frames_;
+    if (fifo_position_ == 0 && nframes % bins == 0)
+    {
+        // Whole partitions: each one is convolved as soon as it is complete
+        for (size_t position = 0; position < nframes; position += bins)
+        {
+            std::memcpy(input_.data() + bins, in + position, bins * sizeof(float));
+            process_partition();
+            std::memcpy(out + position, output_.data() + bins, bins * sizeof(float));
+        }
+        return;
+    }
+    // Partial partitions: frames go in and come out one partition later
+    for (size_t n = 0; n < nframes; ++n)
+    {
+        input_[bins + fifo_position_] = in[n];
+        out[n] = output_[bins + fifo_position_];
+        if (++fifo_position_ == bins)
+        {
+            process_partition();
+            fifo_position_ = 0;
+        }
+    }
+}
+
+// Runs the engine last published to it on one channel, and switches to every newly published engine at a block boundary.
+// Engines are built on the control side and handed over through a triple buffer. On a switch the audio thread carries the
+// input history over to the new engine and crossfades from the old output over one period.
+// The control side owns every engine. The audio thread hands the engine it switched away from back through a queue once it
+// no longer reads it, and the control side frees the returned engines, and those the audio thread skipped, when it
+// publishes the next one. Neither side ever waits for the other.
+// An owner that hands engines over inside a state of its own, so they switch in the same block as the rest of that state,
+// adopts them here instead of publishing them and passes them to switch_to() from the audio thread.
+class ConvolutionRunner
+{
+public:
+    // Function to hand an engine to the audio thread; nullptr passes the signal through. Called from control threads, which
+    // may call it concurrently. Never blocks on the audio thread.
+    void publish(std::unique_ptr<ConvolutionEngine> engine);
+
+    // Function to take ownership of an engine the caller hands to the audio thread itself, returning the engine to pass to
+    // switch_to(). Called from control threads.
+    ConvolutionEngine *adopt(std::unique_ptr<ConvolutionEngine> engine);
+
+    // Function to free an adopted engine the audio thread never switched to, e.g. one in a state it skipped. Called from
+    // control threads.
+    void release(ConvolutionEngine *engine);
+
+    // Function to switch to an adopted engine, or to the dry signal with nullptr, at the next block. Called from the audio
+    // thread only.
+    void switch_to(ConvolutionEngine *engine) { next_engine_ = engine; }
+
+    // Function to size the crossfade buffers for blocks of up to max_frames frames. Called from the audio thread before processing.
+    void allocate(size_t max_frames);
+
+    // Function to process a block of samples of the channel (in[0] -> out[0]). Called from the audio thread only.
+    void process(const float *const *in, float **out, size_t nframes);
+
+    // Function to return the average time the audio thread spends in the engine per block, in microseconds
+    double get_processing_us() const { return processing_us_.load(std::memory_order_relaxed); }
+
+private:
+    // Functions to free the engines the audio thread returned, and one engine. Called with publish_mutex_ held.
+    void free_retired();
+    void free_engine(ConvolutionEngine *engine);
+
+    // Engines on their way to the audio thread; an empty slot passes the signal through. owned_ holds every engine that was
+    // published and not freed yet, guarded by publish_mutex_.
+    std::mutex publish_mutex_;
+    std::vector<std::unique_ptr<ConvolutionEngine>> owned_;
+    TripleBuffer<ConvolutionEngine *> engines_;
+    // Engines the audio thread no longer reads. If the queue is full, the engine stays in owned_ until the runner is destroyed.
+    SpscQueue<ConvolutionEngine *, 16> retired_;
+    std::atomic<double> processing_us_{0.0};
+
+    // Audio thread side: the engine in use, the engine to switch to, and the input and the previous output of a block that
+    // switches engines
+    ConvolutionEngine *engine_ = nullptr;
+    ConvolutionEngine *next_engine_ = nullptr;
+    std::vector<float> input_copy_, previous_output_;
+};
+
+// Function to hand an engine to the audio thread
+void ConvolutionRunner::publish(std::unique_ptr<ConvolutionEngine> engine)
+{
+    // lock the mutex
+    std::lock_guard<std::mutex> lock(publish_mutex_);
+    free_retired();
+
+    ConvolutionEngine *published = engine.get();
+    if (engine)
+    {
+        owned_.push_back(std::move(engine));
+    }
+    engines_.back() = published;
+    // An engine published earlier that the audio thread skipped comes back in the replaced slot and is ours to free. A slot the
+    // audio thread did take holds an engine it returns through retired_ itself.
+    if (engines_.publish())
+    {
+        free_engine(engines_.back());
+    }
+}
+
+// Function to take ownership of an engine
+ConvolutionEngine *ConvolutionRunner::adopt(std::unique_ptr<ConvolutionEngine> engine)
+{
+    // lock the mutex
+    std::lock_guard<std::mutex> lock(publish_mutex_);
+    free_retired();
+
+    ConvolutionEngine *adopted = engine.get();
+    if (engine)
+    {
+        owned_.push_back(std::move(engine));
+    }
+    return adopted;
+}
+
+// Function to free an adopted engine the audio thread never switched to
+void ConvolutionRunner::release(ConvolutionEngine *engine)
+{
+    // lock the mutex
+    std::lock_guard<std::mutex> lock(publish_mutex_);
+    free_engine(engine);
+}
+
+// Function to free the engines the audio thread returned
+void ConvolutionRunner::free_retired()
+{
+    ConvolutionEngine *retired;
+    while (retired_.pop(retired))
+    {
+        free_engine(retired);
+    }
+}
+
+// Function to free one engine
+void ConvolutionRunner::free_engine(ConvolutionEngine *engine)
+{
+    owned_.erase(std::remove_if(owned_.begin(), owned_.end(), [engine](const std::unique_ptr<ConvolutionEngine> &owned)
+                                { return owned.get() == engine; }),
+                 owned_.end());
+}
+
+// Function to size the crossfade buffers
+void ConvolutionRunner::allocate(size_t max_frames)
+{
+    input_copy_.assign(max_frames, 0.0f);
+    previous_output_.assign(max_frames, 0.0f);
+}
+
+// Function to process a block
+void ConvolutionRunner::process(const float *const *in, float **out, size_t nframes)
+{
+    const auto start = std::chrono::steady_clock::now();
+    if (ConvolutionEngine *const *next = engines_.consume())
+    {
+        next_engine_ = *next;
+    }
+    if (next_engine_ != engine_)
+    {
+        // Switch engines at this block: run the old and the new path on the same input and crossfade between their outputs.
+        // A missing engine is the dry signal on either side.
+        ConvolutionEngine *previous = engine_;
+        engine_ = next_engine_;
+        std::memcpy(input_copy_.data(), in[0], nframes * sizeof(float));
+        if (engine_ && previous && engine_->get_partition_frames() == previous->get_partition_frames())
+        {
+            engine_->continue_from(*previous);
+        }
+        if (previous)
+        {
+            previous->process(input_copy_.data(), previous_output_.data(), nframes);
+        }
+        else
+        {
+            std::memcpy(previous_output_.data(), input_copy_.data(), nframes * sizeof(float));
+        }
+        if (engine_)
+        {
+            engine_->process(input_copy_.data(), out[0], nframes);
+        }
+        else
+        {
+            std::memcpy(out[0], input_copy_.data(), nframes * sizeof(float));
+        }
+        for (size_t n = 0; n < nframes; ++n)
+        {
+            const float fade = static_cast<float>(n + 1) / nframes;
+            out[0][n] = previous_output_[n] + fade * (out[0][n] - previous_output_[n]);
+        }
+        // The previous engine is not read again; hand it back to be freed
+        if (previous)
+        {
+            retired_.push(previous);
+        }
+    }
+    else if (engine_)
+    {
+        engine_->process(in[0], out[0], nframes);
+    }
+    else if (in[0] != out[0])
+    {
+        std::memcpy(out[0], in[0], nframes * sizeof(float));
+    }
+
+    // Average over about a hundred blocks; without an engine the time decays towards zero
+    const double elapsed_us = engine_ ? std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() : 0.0;
+    const double average_us = processing_us_.load(std::memory_order_relaxed);
+    processing_us_.store(average_us + 0.01 * (elapsed_us - average_us), std::memory_order_relaxed);
+}
+
+// Settings of the convolution of one channel, as exchanged with the WebSocket server and the database.
+// file is the name of a WAV file in the impulse response directory and file_channel the channel of it to use, starting at 1.
+struct ConvolutionSettings
+{
+    bool is_enabled = false;
+    std::string file;
+    unsigned int file_channel = 1;
+};
+
+class Convolver
+{
+public:
+    // Limits of the impulse response length and of the file name, which the database stores in a 50 character column
+    static constexpr size_t MAX_TAPS = 131072;
+    static constexpr size_t MAX_FILE_NAME_LENGTH = 50;
+
+    // Constructor. Impulse responses are read from ir_directory and must have the sample rate of the processor.
+    // partition_frames is the partition size, see convolution_partition_frames().
+    explicit Convolver(double sample_rate, const std::string &channel_type, unsigned int channel_number, size_t partition_frames,
+                       const std::string &ir_directory);
+
+    // Destructor
+    ~Convolver();
+
+    // Function to replace the settings of the convolution. Settings whose impulse response cannot be loaded are answered with
+    // set_convolution_failed.
+    void set_convolution(
+        const std::string &channel_type, unsigned int channel_number, const ConvolutionSettings &settings,
+        SetConvolutionCallbackType callback = [](const std::string &, const std::string &, unsigned int, const ConvolutionSettings &) {});
+
+    // Function to return the settings of the convolution
+    void get_convolution(
+        const std::string &channel_type, unsigned int channel_number,
+        SetConvolutionCallbackType callback = [](const std::string &, const std::string &, unsigned int, const ConvolutionSettings &) {});
+
+    // Function to size the crossfade buffers for blocks of up to max_frames frames, and to load the impulse response again
+    // with partitions for max_frames if it was loaded for another block size. Called from the audio thread before processing.
+    void allocate(size_t max_frames);
+
+    // Function to process a block of samples of this channel (in[0] -> out[0]). Called from the audio thread only.
+    void process(const float *const *in, float **out, size_t nframes);
+
+    // Function to check settings and, if they are enabled, read the impulse response they select from ir_directory into
+    // impulse_response. Returns false and describes the problem in error for settings set_convolution refuses.
+    static bool read_impulse_response(const ConvolutionSettings &settings, const std::string &ir_directory, double sample_rate,
+                                      std::vector<float> &impulse_response, std::string &error);
+
+private:
+
+    double sample_rate_;
+    std::string channel_type_;
+    unsigned int channel_number_;
+    std::string ir_directory_;
+    // Control side settings and the partition size of their engine, guarded by settings_mutex_
+    ConvolutionSettings settings_;
+    size_t partition_frames_;
+    std::mutex settings_mutex_;
+    // EventManager function ID
+    size_t event_manager_set_function_id_, event_manager_get_function_id_;
+    // The engine of the enabled impulse response, none while the convolution is disabled
+    ConvolutionRunner runner_;
+};
+
+// Constructor
+Convolver::Convolver(double sample_rate, const std::string &channel_type, unsigned int channel_number, size_t partition_frames,
+                     const std::string &ir_directory)
+    : sample_rate_(sample_rate),
+      channel_type_(channel_type),
+      channel_number_(channel_number),
+      ir_directory_(ir_directory),
+      partition_frames_(partition_frames)
+{
+    // Load the settings from the database. They reach the audio thread like any later change.
+    EventManager::getInstance().emitEvent<std::string, unsigned int, SetConvolutionCallbackType>(
+        "get_database_convolution", channel_type_, channel_number_,
+        [this](const std::string &command_type, const std::string &channel_type, unsigned int channel_number, const ConvolutionSettings &settings)
+        {
+            if (command_type == "notify_convolution")
+            {
+                this->set_convolution(channel_type, channel_number, settings);
+            }
+        });
+
+    // Register a listener for the "set_convolution" event
+    event_manager_set_function_id_ = EventManager::getInstance().on<const std::string &, unsigned int, const ConvolutionSettings &, SetConvolutionCallbackType>(
+        "set_convolution", [this](const std::string &channel_type, unsigned int channel_number, const ConvolutionSettings &settings, SetConvolutionCallbackType callback)
+        { this->set_convolution(channel_type, channel_number, settings, callback); });
+
+    // Register a listener for the "get_convolution" event
+    event_manager_get_function_id_ = EventManager::getInstance().on<const std::string &, unsigned int, SetConvolutionCallbackType>(
+        "get_convolution", [this](const std::string &channel_type, unsigned int channel_number, SetConvolutionCallbackType callback)
+        { this->get_convolution(channel_type, channel_number, callback); });
+}
+
+// Destructor
+Convolver::~Convolver()
+{
+    EventManager::getInstance().off("set_convolution", event_manager_set_function_id_);
+    EventManager::getInstance().off("get_convolution", event_manager_get_function_id_);
+}
+
+// Function to replace the settings of the convolution
+void Convolver::set_convolution(const std::string &channel_type, unsigned int channel_number, const ConvolutionSettings &settings,
+                                SetConvolutionCallbackType callback)
+{
+    if (channel_type != channel_type_ || channel_number != channel_number_)
+    {
+        return;
+    }
+
+    // lock the mutex
+    std::lock_guard<std::mutex> lock(settings_mutex_);
+
+    // Read and transform the impulse response here, off the audio thread
+    std::unique_ptr<ConvolutionEngine> engine;
+    std::vector<float> impulse_response;
+    std::string error;
+    if (!read_impulse_response(settings, ir_directory_, sample_rate_, impulse_response, error))
+    {
+        std::cerr << "Cannot set the convolution of " << channel_type << " " << channel_number << ": " << error << std::endl;
+        callback("set_convolution_failed", channel_type, channel_number, settings);
+        return;
+    }
+    if (settings.is_enabled)
+    {
+        engine = std::make_unique<ConvolutionEngine>(impulse_response, partition_frames_);
+    }
+
+    settings_ = settings;
+    runner_.publish(std::move(engine));
+
+    callback("notify_convolution", channel_type, channel_number, settings);
+}
+
+// Function to return the settings of the convolution
+void Convolver::get_convolution(const std::string &channel_type, unsigned int channel_number, SetConvolutionCallbackType callback)
+{
+    if (channel_type != channel_type_ || channel_number != channel_number_)
+    {
+        return;
+    }
+
+    // lock the mutex
+    std::lock_guard<std::mutex> lock(settings_mutex_);
+
+    callback("notify_convolution", channel_type, channel_number, settings_);
+}
+
+// Function to check settings and read their impulse response. Files are only read from the impulse response directory.
+bool Convolver::read_impulse_response(const ConvolutionSettings &settings, const std::string &ir_directory, double sample_rate,
+                                      std::vector<float> &impulse_response, std::string &error)
+{
+    if (settings.file.length() > MAX_FILE_NAME_LENGTH)
+    {
+        error = "file name longer than " + std::to_string(MAX_FILE_NAME_LENGTH) + " characters";
+        return false;
+    }
+    if (!settings.is_enabled)
+    {
+        return true;
+    }
+    if (settings.file.empty() || settings.file.front() == '/' || settings.file.find("..") != std::string::npos)
+    {
+        error = "invalid file name '" + settings.file + "'";
+        return false;
+    }
+    WavFile wav;
+    if (!read_wav_file(ir_directory + "/" + settings.file, wav, error, MAX_TAPS + 1))
+    {
+        return false;
+    }
+    if (wav.sample_rate != static_cast<unsigned int>(sample_rate))
+    {
+        error = settings.file + " has a sample rate of " + std::to_string(wav.sample_rate) + " Hz instead of " +
+                std::to_string(static_cast<unsigned int>(sample_rate)) + " Hz";
+        return false;
+    }
+    if (settings.file_channel < 1 || settings.file_channel > wav.channels.size())
+    {
+        error = settings.file + " has no channel " + std::to_string(settings.file_channel);
+        return false;
+    }
+    impulse_response = std::move(wav.channels[settings.file_channel - 1]);
+    if (impulse_response.empty() || impulse_response.size() > MAX_TAPS)
+    {
+        error = settings.file + " must hold 1 to " + std::to_string(MAX_TAPS) + " frames";
+        return false;
+    }
+    return true;
+}
+
+// Function to size the crossfade buffers and fit the partitions to the block size. The device may negotiate another period
+// than the one the partition size was chosen for; the impulse response is then loaded again, so the convolution still adds
+// no latency. A reload that fails keeps the current engine.
+void Convolver::allocate(size_t max_frames)
+{
+    runner_.allocate(max_frames);
+
+    // lock the mutex
+    std::lock_guard<std::mutex> lock(settings_mutex_);
+
+    const size_t partition_frames = convolution_partition_frames(max_frames);
+    if (partition_frames == partition_frames_)
+    {
+        return;
+    }
+    partition_frames_ = partition_frames;
+    if (!settings_.is_enabled)
+    {
+        return;
+    }
+    std::vector<float> impulse_response;
+    std::string error;
+    if (!read_impulse_response(settings_, ir_directory_, sample_rate_, impulse_response, error))
+    {
+        std::cerr << "Cannot reload the convolution of " << channel_type_ << " " << channel_number_ << ": " << error << std::endl;
+        return;
+    }
+    runner_.publish(std::make_unique<ConvolutionEngine>(impulse_response, partition_frames_));
+}
+
+// Function to process a block
+void Convolver::process(const float *const *in, float **out, size_t nframes)
+{
+    runner_.process(in, out, nframes);
+}
+
+#endif // CONVOLVER_H
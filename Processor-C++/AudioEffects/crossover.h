@@ -0,0 +1,419 @@
+// crossover.h
+// Linkwitz-Riley crossover that splits one mixer output into 2 to 4 frequency bands, for driving the ways of an active speaker
+// from separate physical outputs. Every band has its own delay and gain and replaces the signal of its output channel, which
+// then runs through that output's equalizer, volume and mute like any other output.
+// The bands are the lanes of a BiquadBank, so all bands are filtered in lockstep with one SIMD kernel call per section.
+// Band k is the highpass of every split below it, the lowpass of its own split and the allpass of every split above it, so
+// all bands share the same phase and sum to an allpass. With LR2 every highpass inverts the polarity, as the sum would
+// otherwise cancel at the crossover frequency.
+// Settings changes are validated and turned into coefficients on the control side and published to the audio thread through
+// a triple buffer, like the equalizer cascades.
+
+#ifndef CROSSOVER_H
+#define CROSSOVER_H
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <string>
+#include <mutex>
+#include <cmath>
+#include <cstring>
+#include "biquad_filter.h"
+#include "biquad_bank.h"
+#include "../Utilities/event_manager.h"
+#include "../Utilities/type_aliases.h"
+#include "../Utilities/triple_buffer.h"
+
+// Slope of the crossover filters: 12, 24 or 48 dB per octave
+enum class CrossoverType
+{
+    LR2,
+    LR4,
+    LR8
+};
+
+// Function to return the name of a crossover type as used by the WebSocket commands and the database
+constexpr const char *crossover_type_name(CrossoverType crossover_type)
+{
+    switch (crossover_type)
+    {
+    case CrossoverType::LR2:
+        return "lr2";
+    case CrossoverType::LR4:
+        return "lr4";
+    case CrossoverType::LR8:
+        return "lr8";
+    }
+    return "";
+}
+
+// Function to parse the name of a crossover type. Returns false and leaves crossover_type untouched if the name is unknown.
+inline bool parse_crossover_type(const std::string &name, CrossoverType &crossover_type)
+{
+    for (CrossoverType candidate : {CrossoverType::LR2, CrossoverType::LR4, CrossoverType::LR8})
+    {
+        if (name == crossover_type_name(candidate))
+        {
+            crossover_type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Settings of one crossover, as exchanged with the WebSocket server and the database. Channel numbers start at 1.
+// The number of bands is the number of outputs; frequencies holds one ascending split frequency less.
+struct CrossoverSettings
+{
+    bool is_enabled = false;
+    CrossoverType crossover_type = CrossoverType::LR4;
+    unsigned int source_output = 1;
+    std::vector<double> frequencies;
+    std::vector<unsigned int> outputs;
+    std::vector<double> delays_ms;
+    std::vector<double> gains_db;
+};
+
+class Crossover
+{
+public:
+    // Limits of the band count and of the per-band delay
+    static constexpr unsigned int MIN_BANDS = 2;
+    static constexpr unsigned int MAX_BANDS = 4;
+    static constexpr double MAX_DELAY_MS = 100.0;
+
+    // Constructor. output_channels is the number of mixer outputs the crossover may read and write.
+    // Coefficient changes are ramped over ramp_frames frames, like the equalizers.
+    explicit Crossover(double sample_rate, unsigned int crossover_id, unsigned int output_channels, size_t ramp_frames = 0);
+
+    // Destructor
+    ~Crossover();
+
+    // Function to replace the settings of the crossover. Settings it cannot apply are answered with set_crossover_failed.
+    void set_crossover(
+        unsigned int crossover_id, const CrossoverSettings &settings,
+        SetCrossoverCallbackType callback = [](const std::string &, unsigned int, const CrossoverSettings &) {});
+
+    // Function to return the settings of the crossover
+    void get_crossover(
+        unsigned int crossover_id,
+        SetCrossoverCallbackType callback = [](const std::string &, unsigned int, const CrossoverSettings &) {});
+
+    // Function to return the number of crossovers for output_channels outputs. Every band needs an output of its own, so at
+    // most half the outputs can run crossovers at once.
+    static unsigned int get_crossover_count(unsigned int output_channels) { return output_channels / 2; }
+
+    // Function to check settings against the output count and the sample rate, as set_crossover does before applying them
+    static bool validate(const CrossoverSettings &settings, unsigned int output_channels, double sample_rate);
+
+    // Function to size the band buffers for blocks of up to max_frames frames. Called from the audio thread before processing.
+    void allocate(size_t max_frames);
+
+    // Function to apply the newest published settings and, if the crossover is enabled, to split the source output of
+    // channels into the band outputs. channels holds one buffer per output channel. Called from the audio thread only.
+    void process(float *const *channels, size_t nframes);
+
+private:
+    // Biquad sections per band: the highpass, lowpass and allpass sections of the LR8 splits a band passes through
+    static constexpr unsigned int MAX_SECTIONS = (MAX_BANDS - 1) * 4;
+
+    // Everything the audio thread needs to run the crossover, built on the control side
+    struct CrossoverState
+    {
+        bool is_enabled = false;
+        unsigned int source = 0;
+        unsigned int band_count = 0;
+        std::array<unsigned int, MAX_BANDS> outputs{};
+        std::array<std::array<BiquadCoefficients, MAX_SECTIONS>, MAX_BANDS> coefficients{};
+        std::array<uint32_t, MAX_BANDS> enabled_mask{};
+        std::array<size_t, MAX_BANDS> delay_frames{};
+        std::array<float, MAX_BANDS> gain{};
+    };
+
+    // Function to build the audio thread state of valid settings
+    CrossoverState build_state(const CrossoverSettings &settings) const;
+
+    double sample_rate_;
+    unsigned int crossover_id_;
+    unsigned int output_channels_;
+    size_t max_delay_frames_;
+    // Control side settings, guarded by settings_mutex_
+    CrossoverSettings settings_;
+    std::mutex settings_mutex_;
+    // EventManager function ID
+    size_t event_manager_set_function_id_, event_manager_get_function_id_;
+    // States on their way to the audio thread
+    TripleBuffer<CrossoverState> states_;
+
+    // Audio thread side: the state in use, the band filters with one lane per band, the band buffers, the delay lines
+    // with their write position, and the gain each band ended the last block with
+    CrossoverState state_;
+    BiquadBank bank_;
+    std::vector<std::vector<float>> band_buffers_;
+    std::array<float *, MAX_BANDS> band_ptrs_{};
+    std::vector<std::vector<float>> delay_lines_;
+    size_t delay_position_ = 0;
+    std::array<float, MAX_BANDS> current_gain_{};
+};
+
+// Constructor
+Crossover::Crossover(double sample_rate, unsigned int crossover_id, unsigned int output_channels, size_t ramp_frames)
+    : sample_rate_(sample_rate),
+      crossover_id_(crossover_id),
+      output_channels_(output_channels),
+      max_delay_frames_(static_cast<size_t>(MAX_DELAY_MS * sample_rate / 1000.0)),
+      bank_(MAX_BANDS, MAX_SECTIONS, ramp_frames),
+      band_buffers_(MAX_BANDS),
+      delay_lines_(MAX_BANDS, std::vector<float>(max_delay_frames_ + 1, 0.0f))
+{
+    // Load the settings from the database. They reach the audio thread like any later change.
+    EventManager::getInstance().emitEvent<unsigned int, SetCrossoverCallbackType>(
+        "get_database_crossover", crossover_id,
+        [this](const std::string &command_type, unsigned int crossover_id, const CrossoverSettings &settings)
+        {
+            if (command_type == "notify_crossover")
+            {
+                this->set_crossover(crossover_id, settings);
+            }
+        });
+
+    // Register a listener for the "set_crossover" event
+    event_manager_set_function_id_ = EventManager::getInstance().on<unsigned int, const CrossoverSettings &, SetCrossoverCallbackType>(
+        "set_crossover", [this](unsigned int crossover_id, const CrossoverSettings &settings, SetCrossoverCallbackType callback)
+        { this->set_crossover(crossover_id, settings, callback); });
+
+    // Register a listener for the "get_crossover" event
+    event_manager_get_function_id_ = EventManager::getInstance().on<unsigned int, SetCrossoverCallbackType>(
+        "get_crossover", [this](unsigned int crossover_id, SetCrossoverCallbackType callback)
+        { this->get_crossover(crossover_id, callback); });
+}
+
+// Destructor
+Crossover::~Crossover()
+{
+    EventManager::getInstance().off("set_crossover", event_manager_set_function_id_);
+    EventManager::getInstance().off("get_crossover", event_manager_get_function_id_);
+}
+
+// Function to replace the settings of the crossover
+void Crossover::set_crossover(unsigned int crossover_id, const CrossoverSettings &settings, SetCrossoverCallbackType callback)
+{
+    if (crossover_id != crossover_id_)
+    {
+        return;
+    }
+    if (!validate(settings, output_channels_, sample_rate_))
+    {
+        callback("set_crossover_failed", crossover_id, settings);
+        return;
+    }
+
+    // lock the mutex
+    std::lock_guard<std::mutex> lock(settings_mutex_);
+
+    settings_ = settings;
+    // Build the state here, off the audio thread, and publish it. A state the audio thread has not taken yet is replaced.
+    states_.back() = build_state(settings);
+    states_.publish();
+
+    callback("notify_crossover", crossover_id, settings);
+}
+
+// Function to return the settings of the crossover
+void Crossover::get_crossover(unsigned int crossover_id, SetCrossoverCallbackType callback)
+{
+    if (crossover_id != crossover_id_)
+    {
+        return;
+    }
+
+    // lock the mutex
+    std::lock_guard<std::mutex> lock(settings_mutex_);
+
+    callback("notify_crossover", crossover_id, settings_);
+}
+
+// Function to check settings. Settings without any band are only accepted to switch the crossover off.
+bool Crossover::validate(const CrossoverSettings &settings, unsigned int output_channels, double sample_rate)
+{
+    const size_t bands = settings.outputs.size();
+    if (bands < MIN_BANDS || bands > MAX_BANDS || settings.frequencies.size() != bands - 1 || settings.delays_ms.size() != bands ||
+        settings.gains_db.size() != bands)
+    {
+        return !settings.is_enabled && bands == 0 && settings.frequencies.empty() && settings.delays_ms.empty() && settings.gains_db.empty();
+    }
+    if (settings.source_output < 1 || settings.source_output > output_channels)
+    {
+        return false;
+    }
+    for (size_t band = 0; band < bands; ++band)
+    {
+        // Every band needs an output of its own
+        if (settings.outputs[band] < 1 || settings.outputs[band] > output_channels ||
+            std::count(settings.outputs.begin(), settings.outputs.end(), settings.outputs[band]) != 1)
+        {
+            return false;
+        }
+        if (!(settings.delays_ms[band] >= 0.0 && settings.delays_ms[band] <= MAX_DELAY_MS) || !std::isfinite(settings.gains_db[band]))
+        {
+            return false;
+        }
+    }
+    for (size_t split = 0; split + 1 < bands; ++split)
+    {
+        const double frequency = settings.frequencies[split];
+        if (!(frequency > 0.0 && frequency < sample_rate / 2) || (split > 0 && !(frequency > settings.frequencies[split - 1])))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to build the audio thread state. An LR filter is a Butterworth filter of half its order run twice, and the sum of
+// its lowpass and highpass is an allpass of half its order, which is what the bands below a split need to stay in phase.
+Crossover::CrossoverState Crossover::build_state(const CrossoverSettings &settings) const
+{
+    CrossoverState state;
+    state.is_enabled = settings.is_enabled;
+    if (!settings.is_enabled)
+    {
+        return state;
+    }
+    state.source = settings.source_output - 1;
+    state.band_count = static_cast<unsigned int>(settings.outputs.size());
+
+    // Q factors of the Butterworth sections: one first order pair for LR2 (Q = 0.5 is a double real pole), one section for
+    // LR4 and the two sections of a 4th order Butterworth for LR8
+    std::vector<double> butterworth_q, allpass_q;
+    switch (settings.crossover_type)
+    {
+    case CrossoverType::LR2:
+        butterworth_q = {0.5};
+        break;
+    case CrossoverType::LR4:
+        butterworth_q = {M_SQRT1_2, M_SQRT1_2};
+        allpass_q = {M_SQRT1_2};
+        break;
+    case CrossoverType::LR8:
+        butterworth_q = {0.5 / std::cos(M_PI / 8), 0.5 / std::cos(3 * M_PI / 8), 0.5 / std::cos(M_PI / 8), 0.5 / std::cos(3 * M_PI / 8)};
+        allpass_q = {0.5 / std::cos(M_PI / 8), 0.5 / std::cos(3 * M_PI / 8)};
+        break;
+    }
+
+    for (unsigned int band = 0; band < state.band_count; ++band)
+    {
+        unsigned int section = 0;
+        auto add_section = [&](const BiquadCoefficients &coefficients)
+        {
+            state.coefficients[band][section] = coefficients;
+            state.enabled_mask[band] |= 1u << section;
+            ++section;
+        };
+        for (unsigned int split = 0; split + 1 < state.band_count; ++split)
+        {
+            const double frequency = settings.frequencies[split];
+            if (split < band)
+            {
+                for (double q : butterworth_q)
+                {
+                    add_section(design_biquad(FilterType::HighPass, sample_rate_, frequency, q, 0.0));
+                }
+            }
+            else if (split == band)
+            {
+                for (double q : butterworth_q)
+                {
+                    add_section(design_biquad(FilterType::LowPass, sample_rate_, frequency, q, 0.0));
+                }
+            }
+            else if (settings.crossover_type == CrossoverType::LR2)
+            {
+                // The LR2 lowpass minus its highpass is the first order allpass (1 - s) / (1 + s)
+                const BiquadCoefficients lowpass = design_biquad(FilterType::LowPass1, sample_rate_, frequency, 1.0, 0.0);
+                const BiquadCoefficients highpass = design_biquad(FilterType::HighPass1, sample_rate_, frequency, 1.0, 0.0);
+                add_section({lowpass.b0 - highpass.b0, lowpass.b1 - highpass.b1, 0.0, lowpass.a1, 0.0});
+            }
+            else
+            {
+                for (double q : allpass_q)
+                {
+                    add_section(design_biquad(FilterType::AllPass, sample_rate_, frequency, q, 0.0));
+                }
+            }
+        }
+
+        state.outputs[band] = settings.outputs[band] - 1;
+        state.delay_frames[band] = std::min(static_cast<size_t>(std::lround(settings.delays_ms[band] * sample_rate_ / 1000.0)), max_delay_frames_);
+        const bool inverted = settings.crossover_type == CrossoverType::LR2 && band % 2 == 1;
+        state.gain[band] = static_cast<float>((inverted ? -1.0 : 1.0) * std::pow(10.0, settings.gains_db[band] / 20.0));
+    }
+    return state;
+}
+
+// Function to size the band buffers
+void Crossover::allocate(size_t max_frames)
+{
+    for (unsigned int band = 0; band < MAX_BANDS; ++band)
+    {
+        band_buffers_[band].assign(max_frames, 0.0f);
+        band_ptrs_[band] = band_buffers_[band].data();
+    }
+}
+
+// Function to split the source output into the band outputs
+void Crossover::process(float *const *channels, size_t nframes)
+{
+    // Apply the newest state at the block boundary
+    if (const CrossoverState *state = states_.consume())
+    {
+        state_ = *state;
+        for (unsigned int band = 0; band < MAX_BANDS; ++band)
+        {
+            for (unsigned int section = 0; section < MAX_SECTIONS; ++section)
+            {
+                bank_.set_filter(band, section, (state_.enabled_mask[band] >> section) & 1u, state_.coefficients[band][section]);
+            }
+        }
+    }
+    if (!state_.is_enabled)
+    {
+        // The bands fade in from silence when the crossover is switched on again
+        current_gain_.fill(0.0f);
+        return;
+    }
+
+    // Filter a copy of the source per band, so the source may also be one of the band outputs
+    for (unsigned int band = 0; band < state_.band_count; ++band)
+    {
+        std::memcpy(band_ptrs_[band], channels[state_.source], nframes * sizeof(float));
+    }
+    bank_.process_group(0, band_ptrs_.data(), nframes);
+
+    // Delay each band and write it to its output. A gain change glides over the block instead of stepping.
+    const size_t delay_size = max_delay_frames_ + 1;
+    for (unsigned int band = 0; band < state_.band_count; ++band)
+    {
+        const float *in = band_ptrs_[band];
+        float *out = channels[state_.outputs[band]];
+        float *delay_line = delay_lines_[band].data();
+        const size_t delay_frames = state_.delay_frames[band];
+        const float gain_step = (state_.gain[band] - current_gain_[band]) / nframes;
+        float gain = current_gain_[band];
+        size_t write_position = delay_position_;
+        for (size_t n = 0; n < nframes; ++n)
+        {
+            delay_line[write_position] = in[n];
+            const size_t read_position = write_position >= delay_frames ? write_position - delay_frames : write_position + delay_size - delay_frames;
+            gain += gain_step;
+            out[n] = gain * delay_line[read_position];
+            write_position = write_position + 1 < delay_size ? write_position + 1 : 0;
+        }
+        current_gain_[band] = state_.gain[band];
+    }
+    delay_position_ = (delay_position_ + nframes) % delay_size;
+}
+
+#endif // CROSSOVER_H
@@ -0,0 +1,254 @@
+// delay.h
+// Delays the signal of one channel by up to MAX_DELAY_MS, for time-aligning speakers at different distances.
+// The samples go through a ring buffer whose size is a power of two, so positions wrap with a mask instead of a modulo.
+// A block is written, and for a whole number of frames read, as at most two contiguous runs. A fractional delay is read
+// with cubic interpolation. Delay changes are handed to the audio thread through a lock-free queue and crossfade from the
+// old to the new delay over DELAY_FADE_MS, which avoids both the click of a jump and the pitch sweep of a gliding delay.
+
+#ifndef DELAY_H
+#define DELAY_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "../Utilities/event_manager.h"
+#include "../Utilities/type_aliases.h"
+#include "../Utilities/spsc_queue.h"
+
+class Delay
+{
+public:
+    // Longest delay, and the time over which a delay change crossfades
+    static constexpr double MAX_DELAY_MS = 1000.0;
+    static constexpr double DELAY_FADE_MS = 20.0;
+
+    // Default constructor
+    Delay() : Delay(0.0, "", 0) {}
+
+    // Constructor
+    explicit Delay(double sample_rate, const std::string &channel_type, unsigned int channel_number);
+
+    // Destructor
+    ~Delay();
+
+    // Function to set the delay in milliseconds (0 - MAX_DELAY_MS)
+    void set_delay(
+        const std::string &channel_type, unsigned int channel_number, double delay_ms,
+        SetDelayCallbackType callback = [](const std::string &, const std::string &, unsigned int, double) {});
+
+    // Function to return the current delay in milliseconds
+    void get_delay(
+        const std::string &channel_type, unsigned int channel_number,
+        SetDelayCallbackType callback = [](const std::string &, const std::string &, unsigned int, double) {});
+
+    // Function to size the ring buffer for blocks of up to max_frames frames. Called from the audio thread before processing.
+    void allocate(size_t max_frames);
+
+    // Function to process a block of samples of this channel (in[0] -> out[0]). Called from the audio thread only.
+    void process(const float *const *in, float **out, size_t nframes);
+
+private:
+    // Function to read nframes frames delayed by delay_frames, relative to the block that starts at ring position start
+    void read(size_t start, double delay_frames, float *out, size_t nframes) const;
+
+    double sample_rate_;
+    // Control side delay, guarded by delay_mutex_. Only control threads take the mutex.
+    double delay_ms_ = 0.0;
+    std::string channelType;
+    unsigned int channelNumber;
+    // EventManager function ID
+    size_t event_manager_set_function_id_, event_manager_get_function_id_;
+    std::mutex delay_mutex_;
+    // Delay changes in frames on their way to the audio thread
+    SpscQueue<double, 16> delay_commands_;
+
+    // Audio thread side: the ring buffer, its mask and write position, the delay in use and the crossfade from the previous one
+    std::vector<float> ring_;
+    size_t mask_ = 0;
+    size_t write_position_ = 0;
+    double delay_frames_ = 0.0;
+    double pending_delay_frames_ = 0.0;
+    double previous_delay_frames_ = 0.0;
+    size_t fade_frames_;
+    size_t fade_remaining_ = 0;
+    std::vector<float> fade_buffer_;
+};
+
+// Constructor
+Delay::Delay(double sample_rate, const std::string &channel_type, unsigned int channel_number)
+    : sample_rate_(sample_rate),
+      channelType(channel_type),
+      channelNumber(channel_number),
+      fade_frames_(std::max<size_t>(1, static_cast<size_t>(DELAY_FADE_MS * sample_rate / 1000.0)))
+{
+    // Emit get_database_delay event to get the delay from the database
+    EventManager::getInstance().emitEvent<std::string, unsigned int, SetDelayCallbackType>(
+        "get_database_delay", channelType, channelNumber,
+        [this](const std::string &command_type, const std::string &channel_type, unsigned int channel_number, double delay_ms)
+        {
+            if (command_type == "notify_delay")
+            {
+                this->set_delay(channel_type, channel_number, delay_ms);
+            }
+        });
+
+    // Register callback for set_delay event
+    event_manager_set_function_id_ = EventManager::getInstance().on<const std::string &, unsigned int, double, SetDelayCallbackType>(
+        "set_delay", [this](const std::string &channel_type, unsigned int channel_number, double delay_ms, SetDelayCallbackType callback)
+        { this->set_delay(channel_type, channel_number, delay_ms, callback); });
+
+    // Register callback for get_delay event
+    event_manager_get_function_id_ = EventManager::getInstance().on<const std::string &, unsigned int, SetDelayCallbackType>(
+        "get_delay", [this](const std::string &channel_type, unsigned int channel_number, SetDelayCallbackType callback)
+        { this->get_delay(channel_type, channel_number, callback); });
+}
+
+// Destructor
+Delay::~Delay()
+{
+    EventManager::getInstance().off("set_delay", event_manager_set_function_id_);
+    EventManager::getInstance().off("get_delay", event_manager_get_function_id_);
+}
+
+// Function to set the delay
+void Delay::set_delay(const std::string &channel_type, unsigned int channel_number, double delay_ms, SetDelayCallbackType callback)
+{
+    if (channel_type == channelType && channel_number == channelNumber)
+    {
+        if (!(delay_ms >= 0.0 && delay_ms <= MAX_DELAY_MS))
+        {
+            callback("set_delay_failed", channel_type, channel_number, delay_ms);
+            return;
+        }
+
+        // lock mutex
+        std::lock_guard<std::mutex> lock(delay_mutex_);
+
+        // hand the new delay to the audio thread. If the audio thread has fallen behind and the queue is full, report the failure.
+        if (!delay_commands_.push(delay_ms * sample_rate_ / 1000.0))
+        {
+            callback("set_delay_failed", channel_type, channel_number, delay_ms_);
+            return;
+        }
+        delay_ms_ = delay_ms;
+
+        // execute callback
+        callback("notify_delay", channel_type, channel_number, delay_ms);
+    }
+}
+
+// Function to return the current delay
+void Delay::get_delay(const std::string &channel_type, unsigned int channel_number, SetDelayCallbackType callback)
+{
+    if (channel_type == channelType && channel_number == channelNumber)
+    {
+        // lock mutex
+        std::lock_guard<std::mutex> lock(delay_mutex_);
+
+        // execute callback
+        callback("notify_delay", channel_type, channel_number, delay_ms_);
+    }
+}
+
+// Function to size the ring buffer. It holds the longest delay, the block being written and the extra frame the
+// interpolation reads before the delayed position.
+void Delay::allocate(size_t max_frames)
+{
+    const size_t needed = static_cast<size_t>(std::ceil(MAX_DELAY_MS * sample_rate_ / 1000.0)) + max_frames + 2;
+    size_t size = 1;
+    while (size < needed)
+    {
+        size *= 2;
+    }
+    ring_.assign(size, 0.0f);
+    mask_ = size - 1;
+    write_position_ = 0;
+    fade_buffer_.assign(max_frames, 0.0f);
+}
+
+// Function to read a delayed block
+void Delay::read(size_t start, double delay_frames, float *out, size_t nframes) const
+{
+    const size_t whole = static_cast<size_t>(delay_frames);
+    const float fraction = static_cast<float>(delay_frames - whole);
+    const float *ring = ring_.data();
+    if (fraction == 0.0f)
+    {
+        // Whole frames: one run up to the end of the ring and one from its start
+        const size_t read_position = (start - whole) & mask_;
+        const size_t first_run = std::min(nframes, ring_.size() - read_position);
+        std::memcpy(out, ring + read_position, first_run * sizeof(float));
+        std::memcpy(out + first_run, ring, (nframes - first_run) * sizeof(float));
+    }
+    else if (whole == 0)
+    {
+        // Less than a frame: the sample after the delayed position is the current one, so interpolate linearly
+        for (size_t n = 0; n < nframes; ++n)
+        {
+            const float older = ring[(start + n - 1) & mask_];
+            const float newer = ring[(start + n) & mask_];
+            out[n] = newer + fraction * (older - newer);
+        }
+    }
+    else
+    {
+        // Cubic (Catmull-Rom) interpolation between the two frames around the delayed position, t of the way from the older
+        const float t = 1.0f - fraction;
+        const size_t base = start - whole - 1;
+        for (size_t n = 0; n < nframes; ++n)
+        {
+            const float y0 = ring[(base + n - 1) & mask_];
+            const float y1 = ring[(base + n) & mask_];
+            const float y2 = ring[(base + n + 1) & mask_];
+            const float y3 = ring[(base + n + 2) & mask_];
+            const float c1 = 0.5f * (y2 - y0);
+            const float c2 = y0 - 2.5f * y1 + 2.0f * y2 - 0.5f * y3;
+            const float c3 = 0.5f * (y3 - y0) + 1.5f * (y1 - y2);
+            out[n] = ((c3 * t + c2) * t + c1) * t + y1;
+        }
+    }
+}
+
+// Function to process a block of samples
+void Delay::process(const float *const *in, float **out, size_t nframes)
+{
+    // Keep only the latest delay change. A change waits for a running crossfade to finish.
+    double new_delay_frames;
+    while (delay_commands_.pop(new_delay_frames))
+    {
+        pending_delay_frames_ = new_delay_frames;
+    }
+    if (fade_remaining_ == 0 && pending_delay_frames_ != delay_frames_)
+    {
+        previous_delay_frames_ = delay_frames_;
+        delay_frames_ = pending_delay_frames_;
+        fade_remaining_ = fade_frames_;
+    }
+
+    // Write the block in one or two runs before reading, since a delay below the block length reads from it
+    const size_t start = write_position_;
+    const size_t first_run = std::min(nframes, ring_.size() - start);
+    std::memcpy(ring_.data() + start, in[0], first_run * sizeof(float));
+    std::memcpy(ring_.data(), in[0] + first_run, (nframes - first_run) * sizeof(float));
+    write_position_ = (start + nframes) & mask_;
+
+    read(start, delay_frames_, out[0], nframes);
+    if (fade_remaining_ > 0)
+    {
+        read(start, previous_delay_frames_, fade_buffer_.data(), nframes);
+        const float step = 1.0f / fade_frames_;
+        float fade = static_cast<float>(fade_frames_ - fade_remaining_) * step;
+        for (size_t n = 0; n < nframes; ++n)
+        {
+            fade = std::min(fade + step, 1.0f);
+            out[0][n] = fade_buffer_[n] + fade * (out[0][n] - fade_buffer_[n]);
+        }
+        fade_remaining_ -= std::min(fade_remaining_, nframes);
+    }
+}
+
+#endif // DELAY_H
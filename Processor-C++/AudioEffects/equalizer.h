@@ -1,17 +1,66 @@
 // equalizer.h
-// Creates a vector of filters and processes each sample through all enabled filters
+// Keeps the filter settings of one channel and hands them to the channel's lane of a BiquadBank, which processes the samples.
+// The control side stores the settings in a flat array indexed by filter ID. Every change rebuilds the whole cascade of coefficients
+// off the audio thread and publishes it through a triple buffer, so the audio thread never takes filters_mutex_ and never
+// sees a partly updated cascade.
+// In the linear-phase mode the same settings are turned into a linear-phase FIR on the designer thread, which replaces the
+// cascade once it is ready and runs in a ConvolutionRunner after the bank. The FIR travels in the published state together
+// with the cascade it replaces, so both switch in the same block. The mode trades the phase shifts of the biquads
+// for a constant delay of half the FIR and the CPU time of its convolution, so it is chosen per channel.
+// The combined frequency response of the filters is computed here for the UI and kept until the settings change, so any
+// number of clients can ask for it without recomputing it.
 
 #ifndef EQUALIZER_H
 #define EQUALIZER_H
 
 #include <iostream>
 #include <vector>
-#include <map>
+#include <array>
+#include <algorithm>
 #include <string>
 #include <mutex>
+#include <memory>
 #include "biquad_filter.h"
+#include "biquad_bank.h"
+#include "convolver.h"
+#include "linear_phase.h"
 #include "../Utilities/event_manager.h"
 #include "../Utilities/type_aliases.h"
+#include "../Utilities/triple_buffer.h"
+
+// Processing mode of an equalizer
+enum class EqualizerMode
+{
+    IIR,
+    LinearPhase
+};
+
+// Function to return the name of an equalizer mode as used by the WebSocket commands and the database
+constexpr const char *equalizer_mode_name(EqualizerMode mode)
+{
+    switch (mode)
+    {
+    case EqualizerMode::IIR:
+        return "iir";
+    case EqualizerMode::LinearPhase:
+        return "linear_phase";
+    }
+    return "";
+}
+
+// Function to parse the name of an equalizer mode. Returns false and leaves mode untouched if the name is unknown.
+inline bool parse_equalizer_mode(const std::string &name, EqualizerMode &mode)
+{
+    for (EqualizerMode candidate : {EqualizerMode::IIR, EqualizerMode::LinearPhase})
+    {
+        if (name == equalizer_mode_name(candidate))
+        {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
 
 class Equalizer
 {
@@ -19,45 +68,128 @@ public:
     // Default constructor
     Equalizer() : Equalizer(0.0, "", 0) {}
 
-    // Constructor
-    explicit Equalizer(double sample_rate, const std::string &channel_type, unsigned int channel_number);
+    // Constructor. partition_frames is the partition size of the linear-phase convolution, see convolution_partition_frames().
+    explicit Equalizer(double sample_rate, const std::string &channel_type, unsigned int channel_number, size_t partition_frames = 128);
 
     // Destructor
     ~Equalizer();
 
-    // Function to set the parameters of a BiquadFilter instance and enable/disable it
+    // Function to set the parameters of a filter and enable/disable it
     void set_filter(
         const std::string &channel_type, unsigned int channel_number, unsigned int filter_id, bool is_enabled,
-        std::string filter_type, double center_frequency, double q_factor, double gain_db, SetFilterCallbackType callback = [](const std::string &, const std::string &, unsigned int, unsigned int, bool, std::string, double, double, double) {});
+        FilterType filter_type, double center_frequency, double q_factor, double gain_db, SetFilterCallbackType callback = [](const std::string &, const std::string &, unsigned int, unsigned int, bool, FilterType, double, double, double) {});
 
-    // Function to return the parameters of a BiquadFilter instance
+    // Function to return the parameters of a filter
     void get_filter(
         const std::string &channel_type, unsigned int channel_number, unsigned int filter_id,
-        SetFilterCallbackType callback = [](const std::string &, const std::string &, unsigned int, unsigned int, bool, std::string, double, double, double) {});
+        SetFilterCallbackType callback = [](const std::string &, const std::string &, unsigned int, unsigned int, bool, FilterType, double, double, double) {});
+
+    // Function to return the combined magnitude and phase response of the enabled filters at points frequencies spaced
+    // logarithmically from 20 Hz to 20 kHz, or to the Nyquist frequency if that is lower
+    void get_eq_response(
+        const std::string &channel_type, unsigned int channel_number, unsigned int points,
+        GetEqResponseCallbackType callback = [](const std::string &, const std::string &, unsigned int, const FrequencyResponse &) {});
+
+    // Function to apply the newest published cascade to this channel's lane of bank, which then processes the channel's samples,
+    // and to switch process() to the linear-phase FIR published with it. Called from the audio thread only, before the bank
+    // processes the channel's group.
+    void update(BiquadBank &bank, unsigned int channel);
 
-    // Function to process a single sample through all enabled filters
-    short process(short sample);
+    // Function to switch between the IIR and the linear-phase mode. The answer reports the latency the mode adds in
+    // milliseconds and the average time the audio thread spends in the linear-phase convolution per block in microseconds.
+    void set_equalizer_mode(
+        const std::string &channel_type, unsigned int channel_number, EqualizerMode mode,
+        SetEqualizerModeCallbackType callback = [](const std::string &, const std::string &, unsigned int, EqualizerMode, double, double) {});
+
+    // Function to return the mode, its latency and its processing time
+    void get_equalizer_mode(
+        const std::string &channel_type, unsigned int channel_number,
+        SetEqualizerModeCallbackType callback = [](const std::string &, const std::string &, unsigned int, EqualizerMode, double, double) {});
+
+    // Function to size the buffers of the linear-phase convolution for blocks of up to max_frames frames, with partitions
+    // that fit them. Called from the audio thread before processing.
+    void allocate(size_t max_frames);
+
+    // Function to run the linear-phase FIR on this channel's samples (in[0] -> out[0]) after the bank processed them. Passes
+    // the samples through in the IIR mode. Called from the audio thread only.
+    void process(const float *const *in, float **out, size_t nframes);
+
+    // Number of filters per channel, which is also the number of bands of the BiquadBank
+    static constexpr unsigned int MAX_FILTERS = 16;
+
+    // Limits of the number of points of get_eq_response
+    static constexpr unsigned int MIN_RESPONSE_POINTS = 2;
+    static constexpr unsigned int MAX_RESPONSE_POINTS = 2048;
 
 private:
-    // Map of BiquadFilter instances, indexed by ID
-    std::map<unsigned int, BiquadFilter> enabled_filters_;
-    std::map<unsigned int, BiquadFilter> disabled_filters_;
+    // Control side settings of one filter. A filter that was never set reports these defaults.
+    struct FilterSettings
+    {
+        bool is_enabled = false;
+        FilterType filter_type = FilterType::Peaking;
+        double center_frequency = 1000;
+        double q_factor = 0.707;
+        double gain_db = 0;
+        BiquadCoefficients coefficients{1.0, 0.0, 0.0, 0.0, 0.0};
+    };
+
+    // Coefficients of every filter slot and a bit mask of the enabled ones, and the linear-phase FIR adopted by runner_ that
+    // runs instead of them, as handed to the audio thread
+    struct FilterCascade
+    {
+        std::array<BiquadCoefficients, MAX_FILTERS> coefficients;
+        uint32_t enabled_mask;
+        ConvolutionEngine *engine;
+    };
+
+    // Function to publish the cascade of the filter settings, or, with a linear-phase FIR, one with every filter disabled and
+    // the FIR. Called with filters_mutex_ held.
+    void publish_cascade(ConvolutionEngine *engine);
+
+    // Function to queue the design of a FIR for the current filter settings. Called with filters_mutex_ held.
+    void request_design();
+
+    // Function to return the latency of the current mode in milliseconds. Called with filters_mutex_ held.
+    double latency_ms() const;
+
+    // Control side settings, indexed by filter ID - 1 and guarded by filters_mutex_
+    std::array<FilterSettings, MAX_FILTERS> filters_;
     // Sampling rate of the audio signal
     double sample_rate_;
     std::string channelType;
     unsigned int channelNumber;
-    unsigned int MAX_FILTERS;
     // EventManager function ID
     size_t event_manager_set_function_id_, event_manager_get_function_id_;
+    size_t event_manager_set_mode_function_id_, event_manager_get_mode_function_id_;
+    size_t event_manager_get_response_function_id_;
     std::mutex filters_mutex_;
+    // Cascades on their way to the audio thread
+    TripleBuffer<FilterCascade> cascades_;
+
+    // Linear-phase mode. The mode, the partition size and the design generation are guarded by filters_mutex_; a finished
+    // design is only published if no newer one was requested and the mode did not change meanwhile.
+    EqualizerMode mode_ = EqualizerMode::IIR;
+    size_t partition_frames_;
+    size_t taps_;
+    uint64_t design_generation_ = 0;
+    std::atomic<size_t> max_frames_{0};
+    // The engine of the linear-phase FIR, none in the IIR mode
+    ConvolutionRunner runner_;
+
+    // Version of the filter settings and the mode, counted up by every change, and the last computed response with the
+    // version and number of points it was computed for. Guarded by filters_mutex_.
+    uint64_t parameter_version_ = 0;
+    std::shared_ptr<const FrequencyResponse> response_;
+    uint64_t response_version_ = 0;
 };
 
 // Constructor
-Equalizer::Equalizer(double sample_rate, const std::string &channel_type, unsigned int channel_number)
+Equalizer::Equalizer(double sample_rate, const std::string &channel_type, unsigned int channel_number, size_t partition_frames)
     : sample_rate_(sample_rate),
       channelType(channel_type),
       channelNumber(channel_number),
-      MAX_FILTERS(16)
+      partition_frames_(partition_frames),
+      taps_(linear_phase_taps(sample_rate))
 {
 
     // Emit a get filter event for each filter in the array to syncronize the filter settings from the database when the server starts
@@ -66,153 +198,314 @@ Equalizer::Equalizer(double sample_rate, const std::string &channel_type, unsign
         EventManager::getInstance().emitEvent<std::string, unsigned int, unsigned int, SetFilterCallbackType>(
             "get_database_filter", channel_type, channel_number, j + 1,
             [this](const std::string &command_type, const std::string &channel_type, unsigned int channel_number, unsigned int filter_id, bool is_enabled,
-                   const std::string &filter_type, double center_frequency, double q_factor, double gain_db)
+                   FilterType filter_type, double center_frequency, double q_factor, double gain_db)
             { this->set_filter(channel_type, channel_number, filter_id, is_enabled, filter_type, center_frequency, q_factor, gain_db); });
     }
 
+    // Load the mode after the filters, so a linear-phase channel designs its FIR once
+    EventManager::getInstance().emitEvent<std::string, unsigned int, SetEqualizerModeCallbackType>(
+        "get_database_equalizer_mode", channel_type, channel_number,
+        [this](const std::string &command_type, const std::string &channel_type, unsigned int channel_number, EqualizerMode mode, double, double)
+        {
+            if (command_type == "notify_equalizer_mode")
+            {
+                this->set_equalizer_mode(channel_type, channel_number, mode);
+            }
+        });
+
     // Register a listener for the "set_filter" event
-    event_manager_set_function_id_ = EventManager::getInstance().on<const std::string &, unsigned int, unsigned int, bool, std::string, double, double, double, SetFilterCallbackType>(
+    event_manager_set_function_id_ = EventManager::getInstance().on<const std::string &, unsigned int, unsigned int, bool, FilterType, double, double, double, SetFilterCallbackType>(
         "set_filter", [this](const std::string &channel_type, unsigned int channel_number, unsigned int filter_id, bool is_enabled,
-                             std::string filter_type, double center_frequency, double q_factor, double gain_db, SetFilterCallbackType callback)
+                             FilterType filter_type, double center_frequency, double q_factor, double gain_db, SetFilterCallbackType callback)
         { this->set_filter(channel_type, channel_number, filter_id, is_enabled, filter_type, center_frequency, q_factor, gain_db, callback); });
 
     // Register a listener for the "get_filter" event
     event_manager_get_function_id_ = EventManager::getInstance().on<const std::string &, unsigned int, unsigned int, SetFilterCallbackType>(
         "get_filter", [this](const std::string &channel_type, unsigned int channel_number, unsigned int filter_id, SetFilterCallbackType callback)
         { this->get_filter(channel_type, channel_number, filter_id, callback); });
+
+    // Register a listener for the "set_equalizer_mode" event
+    event_manager_set_mode_function_id_ = EventManager::getInstance().on<const std::string &, unsigned int, EqualizerMode, SetEqualizerModeCallbackType>(
+        "set_equalizer_mode", [this](const std::string &channel_type, unsigned int channel_number, EqualizerMode mode, SetEqualizerModeCallbackType callback)
+        { this->set_equalizer_mode(channel_type, channel_number, mode, callback); });
+
+    // Register a listener for the "get_equalizer_mode" event
+    event_manager_get_mode_function_id_ = EventManager::getInstance().on<const std::string &, unsigned int, SetEqualizerModeCallbackType>(
+        "get_equalizer_mode", [this](const std::string &channel_type, unsigned int channel_number, SetEqualizerModeCallbackType callback)
+        { this->get_equalizer_mode(channel_type, channel_number, callback); });
+
+    // Register a listener for the "get_eq_response" event
+    event_manager_get_response_function_id_ = EventManager::getInstance().on<const std::string &, unsigned int, unsigned int, GetEqResponseCallbackType>(
+        "get_eq_response", [this](const std::string &channel_type, unsigned int channel_number, unsigned int points, GetEqResponseCallbackType callback)
+        { this->get_eq_response(channel_type, channel_number, points, callback); });
 }
 
-// Destructor
+// Destructor. A design still running for this equalizer is waited for, since it publishes into runner_.
 Equalizer::~Equalizer()
 {
+    LinearPhaseDesigner::getInstance().cancel(this);
     EventManager::getInstance().off("set_filter", event_manager_set_function_id_);
     EventManager::getInstance().off("get_filter", event_manager_get_function_id_);
+    EventManager::getInstance().off("set_equalizer_mode", event_manager_set_mode_function_id_);
+    EventManager::getInstance().off("get_equalizer_mode", event_manager_get_mode_function_id_);
+    EventManager::getInstance().off("get_eq_response", event_manager_get_response_function_id_);
 }
 
-// Function to set the parameters of a BiquadFilter instance and enable/disable it
+// Function to set the parameters of a filter and enable/disable it
 void Equalizer::set_filter(const std::string &channel_type, unsigned int channel_number, unsigned int filter_id, bool is_enabled,
-                           std::string filter_type, double center_frequency, double q_factor, double gain_db, SetFilterCallbackType callback)
+                           FilterType filter_type, double center_frequency, double q_factor, double gain_db, SetFilterCallbackType callback)
 {
     // std::cout << "set_filter called, channelType: " << channelType << std::endl;
     // std::cout << "set_filter called, channelNumber: " << channelNumber << std::endl;
 
     if (channel_type == channelType && channel_number == channelNumber)
     {
+        // The audio thread keeps one slot per filter ID, so IDs outside 1..MAX_FILTERS cannot be applied
+        if (filter_id < 1 || filter_id > MAX_FILTERS)
+        {
+            callback("set_filter_failed", channel_type, channel_number, filter_id, is_enabled, filter_type, center_frequency, q_factor, gain_db);
+            return;
+        }
+
         // lock the mutex
         std::lock_guard<std::mutex> lock(filters_mutex_);
 
-        // Find the filter with the given ID, if it exists
-        auto disabled_filter_iter = disabled_filters_.find(filter_id);
-        auto enabled_filter_iter = enabled_filters_.find(filter_id);
-
-        // Pointer to the filter
-        BiquadFilter *filter_ptr = nullptr;
+        // Compute the new coefficients here, off the audio thread
+        FilterSettings &filter = filters_[filter_id - 1];
+        filter.is_enabled = is_enabled;
+        filter.filter_type = filter_type;
+        filter.center_frequency = center_frequency;
+        filter.q_factor = q_factor;
+        filter.gain_db = gain_db;
+        filter.coefficients = design_biquad(filter_type, sample_rate_, center_frequency, q_factor, gain_db);
+        ++parameter_version_;
 
-        // If the filter exists in one of the maps, set the pointer to it
-        if (disabled_filter_iter != disabled_filters_.end())
+        // The linear-phase mode keeps the current FIR until the new one is designed
+        if (mode_ == EqualizerMode::LinearPhase)
         {
-            filter_ptr = &(disabled_filter_iter->second);
+            request_design();
         }
-        else if (enabled_filter_iter != enabled_filters_.end())
+        else
         {
-            filter_ptr = &(enabled_filter_iter->second);
+            publish_cascade(nullptr);
         }
 
-        // If the filter doesn't exist, add a new one to the map
-        if (filter_ptr == nullptr)
+        callback("notify_filter", channel_type, channel_number, filter_id, is_enabled, filter_type, center_frequency, q_factor, gain_db);
+    }
+}
+
+// Function to get the parameters of a filter
+void Equalizer::get_filter(const std::string &channel_type, unsigned int channel_number, unsigned int filter_id, SetFilterCallbackType callback)
+{
+    if (channel_type == channelType && channel_number == channelNumber)
+    {
+        // lock the mutex
+        std::lock_guard<std::mutex> lock(filters_mutex_);
+
+        // IDs outside 1..MAX_FILTERS were never set and report the defaults
+        const FilterSettings filter = filter_id >= 1 && filter_id <= MAX_FILTERS ? filters_[filter_id - 1] : FilterSettings();
+        callback("notify_filter", channel_type, channel_number, filter_id, filter.is_enabled, filter.filter_type, filter.center_frequency,
+                 filter.q_factor, filter.gain_db);
+    }
+}
+
+// Function to switch the mode
+void Equalizer::set_equalizer_mode(const std::string &channel_type, unsigned int channel_number, EqualizerMode mode, SetEqualizerModeCallbackType callback)
+{
+    if (channel_type != channelType || channel_number != channelNumber)
+    {
+        return;
+    }
+
+    // lock the mutex
+    std::lock_guard<std::mutex> lock(filters_mutex_);
+
+    if (mode != mode_)
+    {
+        mode_ = mode;
+        ++parameter_version_;
+        if (mode_ == EqualizerMode::LinearPhase)
         {
-            BiquadFilter new_filter(filter_type, sample_rate_, center_frequency, q_factor, gain_db);
-            if (is_enabled)
-            {
-                enabled_filters_.emplace(filter_id, new_filter);
-            }
-            else
-            {
-                disabled_filters_.emplace(filter_id, new_filter);
-            }
+            // The cascade keeps running until the FIR replaces it
+            request_design();
         }
-        // If the filter already exists, update its parameters
         else
         {
-            filter_ptr->set_params(filter_type, sample_rate_, center_frequency, q_factor, gain_db);
+            // Drop a design in progress, then fade the FIR out while the cascade comes back
+            ++design_generation_;
+            publish_cascade(nullptr);
+        }
+    }
+
+    callback("notify_equalizer_mode", channel_type, channel_number, mode_, latency_ms(), runner_.get_processing_us());
+}
+
+// Function to return the mode
+void Equalizer::get_equalizer_mode(const std::string &channel_type, unsigned int channel_number, SetEqualizerModeCallbackType callback)
+{
+    if (channel_type != channelType || channel_number != channelNumber)
+    {
+        return;
+    }
+
+    // lock the mutex
+    std::lock_guard<std::mutex> lock(filters_mutex_);
+
+    callback("notify_equalizer_mode", channel_type, channel_number, mode_, latency_ms(), runner_.get_processing_us());
+}
+
+// Function to return the combined response. It is computed on the first request after a change and shared by later ones.
+void Equalizer::get_eq_response(const std::string &channel_type, unsigned int channel_number, unsigned int points, GetEqResponseCallbackType callback)
+{
+    if (channel_type != channelType || channel_number != channelNumber)
+    {
+        return;
+    }
+    if (points < MIN_RESPONSE_POINTS || points > MAX_RESPONSE_POINTS || sample_rate_ <= 0.0)
+    {
+        callback("get_eq_response_failed", channel_type, channel_number, FrequencyResponse());
+        return;
+    }
 
-            // Enable or disable the filter
-            if (is_enabled)
+    std::shared_ptr<const FrequencyResponse> response;
+    {
+        // lock the mutex
+        std::lock_guard<std::mutex> lock(filters_mutex_);
+
+        if (!response_ || response_version_ != parameter_version_ || response_->frequencies.size() != points)
+        {
+            auto computed = std::make_shared<FrequencyResponse>();
+            computed->frequencies = log_spaced_frequencies(points, 20.0, std::min(20000.0, sample_rate_ / 2.0));
+            std::array<BiquadCoefficients, MAX_FILTERS> coefficients;
+            uint32_t enabled_mask = 0;
+            for (unsigned int i = 0; i < MAX_FILTERS; ++i)
             {
-                enabled_filters_.emplace(filter_id, *filter_ptr);
-                if (disabled_filter_iter != disabled_filters_.end())
-                {
-                    disabled_filters_.erase(disabled_filter_iter);
-                }
+                coefficients[i] = filters_[i].coefficients;
+                enabled_mask |= filters_[i].is_enabled ? 1u << i : 0u;
             }
-            else
+            evaluate_biquad_response(coefficients.data(), enabled_mask, MAX_FILTERS, sample_rate_, *computed);
+
+            // The linear-phase FIR has the magnitude of the filters and the phase of its delay
+            if (mode_ == EqualizerMode::LinearPhase)
             {
-                disabled_filters_.emplace(filter_id, *filter_ptr);
-                if (enabled_filter_iter != enabled_filters_.end())
+                const double delay = static_cast<double>(linear_phase_latency(taps_));
+                for (size_t i = 0; i < points; ++i)
                 {
-                    enabled_filters_.erase(enabled_filter_iter);
+                    const double cycles = computed->frequencies[i] * delay / sample_rate_;
+                    computed->phase_deg[i] = -360.0 * (cycles - std::round(cycles));
                 }
             }
+            response_ = std::move(computed);
+            response_version_ = parameter_version_;
         }
-        callback("notify_filter", channel_type, channel_number, filter_id, is_enabled, filter_type, center_frequency, q_factor, gain_db);
+        response = response_;
     }
+
+    // Answer outside the lock; the response stays alive while the callback serializes it
+    callback("notify_eq_response", channel_type, channel_number, *response);
 }
 
-// Function to get the parameters of a BiquadFilter instance
-void Equalizer::get_filter(const std::string &channel_type, unsigned int channel_number, unsigned int filter_id, SetFilterCallbackType callback)
+// Function to rebuild the cascade and publish it. The previous cascade is replaced even if the audio thread has not taken it
+// yet; a FIR in a cascade it skipped is freed, as the audio thread never switched to it.
+void Equalizer::publish_cascade(ConvolutionEngine *engine)
 {
-    if (channel_type == channelType && channel_number == channelNumber)
+    FilterCascade &cascade = cascades_.back();
+    cascade.enabled_mask = 0;
+    for (unsigned int i = 0; i < MAX_FILTERS; ++i)
     {
-        // lock the mutex
-        std::lock_guard<std::mutex> lock(filters_mutex_);
+        cascade.coefficients[i] = filters_[i].coefficients;
+        cascade.enabled_mask |= engine == nullptr && filters_[i].is_enabled ? 1u << i : 0u;
+    }
+    cascade.engine = engine;
+    if (cascades_.publish() && cascades_.back().engine != nullptr)
+    {
+        runner_.release(cascades_.back().engine);
+    }
+}
 
-        // Find the filter with the given ID, if it exists
-        auto disabled_filter_iter = disabled_filters_.find(filter_id);
-        auto enabled_filter_iter = enabled_filters_.find(filter_id);
+// Function to queue the design of a FIR. The design runs on the designer thread, which then publishes the FIR and the
+// disabled cascade in one state. The cascade glides out over the equalizer smoothing time while the FIR fades in over one
+// block, so the channel never runs both or neither at full level.
+void Equalizer::request_design()
+{
+    std::array<BiquadCoefficients, MAX_FILTERS> coefficients;
+    uint32_t enabled_mask = 0;
+    for (unsigned int i = 0; i < MAX_FILTERS; ++i)
+    {
+        coefficients[i] = filters_[i].coefficients;
+        enabled_mask |= filters_[i].is_enabled ? 1u << i : 0u;
+    }
+    const uint64_t generation = ++design_generation_;
+    const size_t partition_frames = partition_frames_;
+    LinearPhaseDesigner::getInstance().submit(this, [this, coefficients, enabled_mask, generation, partition_frames]()
+                                              {
+        std::unique_ptr<ConvolutionEngine> engine = std::make_unique<ConvolutionEngine>(
+            design_linear_phase_fir(coefficients.data(), enabled_mask, MAX_FILTERS, taps_), partition_frames);
 
-        // Pointer to the filter
-        BiquadFilter *filter_ptr = nullptr;
-        bool is_enabled = false;
+        // lock the mutex
+        std::lock_guard<std::mutex> lock(filters_mutex_);
 
-        // If the filter exists in one of the maps, set the pointer to it
-        if (disabled_filter_iter != disabled_filters_.end())
-        {
-            filter_ptr = &(disabled_filter_iter->second);
-        }
-        else if (enabled_filter_iter != enabled_filters_.end())
+        // Neither the hand-over nor the release of a skipped FIR waits for the audio thread
+        if (mode_ == EqualizerMode::LinearPhase && generation == design_generation_)
         {
-            filter_ptr = &(enabled_filter_iter->second);
-            is_enabled = true;
-        }
+            publish_cascade(runner_.adopt(std::move(engine)));
+        } });
+}
 
-        // If the filter doesn't exist, notify a filter with the default parameters
-        if (filter_ptr == nullptr)
-        {
-            callback("notify_filter", channel_type, channel_number, filter_id, false, "peaking", 1000, 0.707, 0);
-        }
-        else
-        {
-            callback("notify_filter", channel_type, channel_number, filter_id, is_enabled, filter_ptr->get_filter_type(), filter_ptr->get_center_frequency(),
-                     filter_ptr->get_q_factor(), filter_ptr->get_gain_db());
-        }
+// Function to return the latency of the current mode. The convolution adds a partition of latency when the blocks are not
+// a whole number of partitions.
+double Equalizer::latency_ms() const
+{
+    if (mode_ == EqualizerMode::IIR || sample_rate_ <= 0.0)
+    {
+        return 0.0;
     }
+    const size_t max_frames = max_frames_.load(std::memory_order_relaxed);
+    const size_t fifo_frames = max_frames % partition_frames_ == 0 ? 0 : partition_frames_;
+    return (linear_phase_latency(taps_) + fifo_frames) * 1000.0 / sample_rate_;
 }
 
-// Function to process a single sample through all enabled filters
-short Equalizer::process(short sample)
+// Function to size the buffers of the linear-phase convolution and fit its partitions to the block size. A FIR designed for
+// another partition size is designed again.
+void Equalizer::allocate(size_t max_frames)
 {
+    runner_.allocate(max_frames);
+    max_frames_.store(max_frames, std::memory_order_relaxed);
+
     // lock the mutex
     std::lock_guard<std::mutex> lock(filters_mutex_);
 
-    // Sample to be processed
-    double out = sample;
-    for (auto &pair : enabled_filters_)
+    const size_t partition_frames = convolution_partition_frames(max_frames);
+    if (partition_frames != partition_frames_)
     {
-        // Process the sample through the enabled filter
-        out = pair.second.process(out);
+        partition_frames_ = partition_frames;
+        if (mode_ == EqualizerMode::LinearPhase)
+        {
+            request_design();
+        }
     }
+}
 
-    return static_cast<short>(out);
+// Function to run the linear-phase FIR
+void Equalizer::process(const float *const *in, float **out, size_t nframes)
+{
+    runner_.process(in, out, nframes);
+}
+
+// Function to apply the newest cascade and its FIR at the block boundary. The bank resets a band's delay line only when the
+// band is switched on, so unchanged bands continue without a click.
+void Equalizer::update(BiquadBank &bank, unsigned int channel)
+{
+    const FilterCascade *cascade = cascades_.consume();
+    if (cascade == nullptr)
+    {
+        return;
+    }
+    runner_.switch_to(cascade->engine);
+    for (unsigned int band = 0; band < MAX_FILTERS; ++band)
+    {
+        bank.set_filter(channel, band, (cascade->enabled_mask >> band) & 1u, cascade->coefficients[band]);
+    }
 }
 
 #endif // EQUALIZER_H
@@ -0,0 +1,167 @@
+// fft.h
+// Fast Fourier transform of real signals, for the FFT convolution. A real signal of size samples is transformed through a
+// complex radix-2 FFT of half the size, with the even samples as real and the odd samples as imaginary parts, and the two
+// interleaved spectra are then separated. Spectra are kept as separate arrays of real and imaginary parts, so the complex
+// arithmetic on them vectorizes. Both directions are unnormalized: inverse(forward(x)) returns size * x.
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+
+class RealFft
+{
+public:
+    // Constructor. size must be a power of two of at least 4. All tables are computed here, so the transforms do not allocate.
+    explicit RealFft(size_t size);
+
+    size_t get_size() const { return size_; }
+
+    // Function to transform size real samples into size / 2 bins. The DC and Nyquist bins are real, so they are packed
+    // into bin 0: re[0] holds the DC bin and im[0] the Nyquist bin.
+    void forward(const float *in, float *re, float *im);
+
+    // Function to transform size / 2 packed bins back into size real samples, scaled by size
+    void inverse(const float *re, const float *im, float *out);
+
+private:
+    // Function to run the in-place complex FFT of half_ points on the bit-reversed work arrays
+    void complex_fft(float *re, float *im) const;
+
+    size_t size_;
+    size_t half_;
+    // Bit-reversed index of every complex point
+    std::vector<uint32_t> bit_reverse_;
+    // Twiddle factors exp(-i * pi * k / span) of every stage, stored at [span + k]
+    std::vector<float> twiddle_re_, twiddle_im_;
+    // Factors exp(-2i * pi * k / size) that separate the spectra of the even and the odd samples
+    std::vector<float> split_re_, split_im_;
+    // Complex work arrays
+    std::vector<float> work_re_, work_im_;
+};
+
+// Constructor
+RealFft::RealFft(size_t size)
+    : size_(size),
+      half_(size / 2),
+      bit_reverse_(size / 2),
+      twiddle_re_(size / 2),
+      twiddle_im_(size / 2),
+      split_re_(size / 2),
+      split_im_(size / 2),
+      work_re_(size / 2),
+      work_im_(size / 2)
+{
+    unsigned int bits = 0;
+    while ((size_t{1} << bits) < half_)
+    {
+        ++bits;
+    }
+    for (size_t n = 0; n < half_; ++n)
+    {
+        uint32_t reversed = 0;
+        for (unsigned int bit = 0; bit < bits; ++bit)
+        {
+            reversed |= ((n >> bit) & 1u) << (bits - 1 - bit);
+        }
+        bit_reverse_[n] = reversed;
+    }
+    for (size_t span = 1; span < half_; span *= 2)
+    {
+        for (size_t k = 0; k < span; ++k)
+        {
+            twiddle_re_[span + k] = static_cast<float>(std::cos(M_PI * k / span));
+            twiddle_im_[span + k] = static_cast<float>(-std::sin(M_PI * k / span));
+        }
+    }
+    for (size_t k = 0; k < half_; ++k)
+    {
+        split_re_[k] = static_cast<float>(std::cos(2 * M_PI * k / size_));
+        split_im_[k] = static_cast<float>(-std::sin(2 * M_PI * k / size_));
+    }
+}
+
+// Decimation in time: every stage combines pairs of spectra of span points into spectra of twice the span
+void RealFft::complex_fft(float *re, float *im) const
+{
+    for (size_t span = 1; span < half_; span *= 2)
+    {
+        const float *w_re = twiddle_re_.data() + span, *w_im = twiddle_im_.data() + span;
+        for (size_t start = 0; start < half_; start += 2 * span)
+        {
+            float *a_re = re + start, *a_im = im + start, *b_re = re + start + span, *b_im = im + start + span;
+            for (size_t k = 0; k < span; ++k)
+            {
+                const float t_re = w_re[k] * b_re[k] - w_im[k] * b_im[k];
+                const float t_im = w_re[k] * b_im[k] + w_im[k] * b_re[k];
+                b_re[k] = a_re[k] - t_re;
+                b_im[k] = a_im[k] - t_im;
+                a_re[k] += t_re;
+                a_im[k] += t_im;
+            }
+        }
+    }
+}
+
+// Forward transform
+void RealFft::forward(const float *in, float *re, float *im)
+{
+    for (size_t n = 0; n < half_; ++n)
+    {
+        work_re_[bit_reverse_[n]] = in[2 * n];
+        work_im_[bit_reverse_[n]] = in[2 * n + 1];
+    }
+    complex_fft(work_re_.data(), work_im_.data());
+
+    // With Z the spectrum of z[n] = x[2n] + i * x[2n+1], the spectra of the even and the odd samples are
+    // E[k] = (Z[k] + conj(Z[half - k])) / 2 and O[k] = (Z[k] - conj(Z[half - k])) / 2i, and X[k] = E[k] + exp(-2i * pi * k / size) * O[k]
+    re[0] = work_re_[0] + work_im_[0];
+    im[0] = work_re_[0] - work_im_[0];
+    for (size_t k = 1; k < half_; ++k)
+    {
+        const float z_re = work_re_[k], z_im = work_im_[k], m_re = work_re_[half_ - k], m_im = work_im_[half_ - k];
+        const float e_re = 0.5f * (z_re + m_re), e_im = 0.5f * (z_im - m_im);
+        const float o_re = 0.5f * (z_im + m_im), o_im = -0.5f * (z_re - m_re);
+        re[k] = e_re + split_re_[k] * o_re - split_im_[k] * o_im;
+        im[k] = e_im + split_re_[k] * o_im + split_im_[k] * o_re;
+    }
+}
+
+// Inverse transform. The even and odd spectra are recombined into Z, scaled by 2, and transformed back with the forward FFT
+// of the conjugate, which leaves the conjugate of the inverse.
+void RealFft::inverse(const float *re, const float *im, float *out)
+{
+    for (size_t k = 0; k < half_; ++k)
+    {
+        float z_re, z_im;
+        if (k == 0)
+        {
+            z_re = re[0] + im[0];
+            z_im = re[0] - im[0];
+        }
+        else
+        {
+            const float x_re = re[k], x_im = im[k], m_re = re[half_ - k], m_im = im[half_ - k];
+            const float e_re = x_re + m_re, e_im = x_im - m_im;
+            const float d_re = x_re - m_re, d_im = x_im + m_im;
+            // O = D * conj(exp(-2i * pi * k / size))
+            const float o_re = d_re * split_re_[k] + d_im * split_im_[k];
+            const float o_im = d_im * split_re_[k] - d_re * split_im_[k];
+            z_re = e_re - o_im;
+            z_im = e_im + o_re;
+        }
+        work_re_[bit_reverse_[k]] = z_re;
+        work_im_[bit_reverse_[k]] = -z_im;
+    }
+    complex_fft(work_re_.data(), work_im_.data());
+    for (size_t n = 0; n < half_; ++n)
+    {
+        out[2 * n] = work_re_[n];
+        out[2 * n + 1] = -work_im_[n];
+    }
+}
+
+#endif // FFT_H
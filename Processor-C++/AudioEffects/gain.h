@@ -1,5 +1,10 @@
 // gain.h
 // Creates a gain element that can be used to increase or decrease the gain of an audio signal.
+// The target gain is an atomic float, so the audio thread reads gain changes at the next block boundary without a lock or a
+// queue. A change ramps from the gain in use to the target over ramp_frames frames, linearly in amplitude or exponentially,
+// which is linear in dB, so level jumps do not click. Blocks without a ramp are scaled by a constant through a kernel
+// vectorized with SSE2 and AVX on x86 and NEON on ARM.
+// The control side keeps the gain in dB as it was set, so get_gain returns exactly what set_gain stored.
 
 #ifndef GAIN_H
 #define GAIN_H
@@ -9,22 +14,163 @@
 #include <map>
 #include <string>
 #include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
 #include "../Utilities/event_manager.h"
 #include "../Utilities/type_aliases.h"
+#include "../Utilities/cpu_dispatch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GAIN_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GAIN_NEON 1
+#endif
+
+// Shape of a gain change: a straight line in amplitude, or a constant number of dB per frame
+enum class GainRamp
+{
+    Linear,
+    Exponential
+};
+
+// Function to return the name of a ramp shape as used on the command line
+constexpr const char *gain_ramp_name(GainRamp gain_ramp)
+{
+    switch (gain_ramp)
+    {
+    case GainRamp::Linear:
+        return "linear";
+    case GainRamp::Exponential:
+        return "exponential";
+    }
+    return "";
+}
+
+// Function to parse the name of a ramp shape. Returns false and leaves gain_ramp untouched if the name is unknown.
+inline bool parse_gain_ramp(const std::string &name, GainRamp &gain_ramp)
+{
+    for (GainRamp candidate : {GainRamp::Linear, GainRamp::Exponential})
+    {
+        if (name == gain_ramp_name(candidate))
+        {
+            gain_ramp = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Block kernel for one instruction set
+struct GainKernels
+{
+    // Writes in times gain to out. in and out may be the same buffer.
+    void (*scale)(const float *in, float *out, size_t nframes, float gain);
+    // Number of frames per instruction and name of the instruction set, for logging
+    unsigned int width;
+    const char *name;
+};
+
+// Scalar kernel for CPUs without SSE2 or NEON, and for the frames left over by the unrolled vector loops
+void gain_scale_scalar(const float *in, float *out, size_t nframes, float gain)
+{
+    for (size_t n = 0; n < nframes; ++n)
+    {
+        out[n] = in[n] * gain;
+    }
+}
+
+#if defined(GAIN_X86)
+// SSE2 kernel, 4 frames per instruction, unrolled to two vectors per iteration
+__attribute__((target("sse2"))) void gain_scale_sse2(const float *in, float *out, size_t nframes, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    size_t n = 0;
+    for (; n + 8 <= nframes; n += 8)
+    {
+        const __m128 a = _mm_loadu_ps(in + n), b = _mm_loadu_ps(in + n + 4);
+        _mm_storeu_ps(out + n, _mm_mul_ps(a, g));
+        _mm_storeu_ps(out + n + 4, _mm_mul_ps(b, g));
+    }
+    gain_scale_scalar(in + n, out + n, nframes - n, gain);
+}
+
+// AVX kernel, 8 frames per instruction, unrolled to two vectors per iteration
+__attribute__((target("avx"))) void gain_scale_avx(const float *in, float *out, size_t nframes, float gain)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    size_t n = 0;
+    for (; n + 16 <= nframes; n += 16)
+    {
+        const __m256 a = _mm256_loadu_ps(in + n), b = _mm256_loadu_ps(in + n + 8);
+        _mm256_storeu_ps(out + n, _mm256_mul_ps(a, g));
+        _mm256_storeu_ps(out + n + 8, _mm256_mul_ps(b, g));
+    }
+    gain_scale_scalar(in + n, out + n, nframes - n, gain);
+}
+#endif // GAIN_X86
+
+#if defined(GAIN_NEON)
+// NEON kernel, 4 frames per instruction, unrolled to two vectors per iteration
+void gain_scale_neon(const float *in, float *out, size_t nframes, float gain)
+{
+    size_t n = 0;
+    for (; n + 8 <= nframes; n += 8)
+    {
+        const float32x4_t a = vld1q_f32(in + n), b = vld1q_f32(in + n + 4);
+        vst1q_f32(out + n, vmulq_n_f32(a, gain));
+        vst1q_f32(out + n + 4, vmulq_n_f32(b, gain));
+    }
+    gain_scale_scalar(in + n, out + n, nframes - n, gain);
+}
+#endif // GAIN_NEON
+
+// Returns the block kernels this CPU can run, narrowest first
+std::vector<GainKernels> get_supported_gain_kernels()
+{
+    std::vector<GainKernels> supported = {{gain_scale_scalar, 1, "scalar"}};
+#if defined(GAIN_X86)
+    if (__builtin_cpu_supports("sse2"))
+    {
+        supported.push_back({gain_scale_sse2, 4, "SSE2"});
+    }
+    if (__builtin_cpu_supports("avx"))
+    {
+        supported.push_back({gain_scale_avx, 8, "AVX"});
+    }
+#elif defined(GAIN_NEON)
+    supported.push_back({gain_scale_neon, 4, "NEON"});
+#endif
+    return supported;
+}
+
+// Returns the block kernel the gain elements run with
+const GainKernels &get_gain_kernels()
+{
+    return select_widest_kernels<GainKernels, get_supported_gain_kernels>();
+}
 
 class Gain
 {
 public:
+    // Gains at or below MIN_GAIN_DB are silent. MAX_GAIN_DB allows make-up gain; the float path has the headroom for it and
+    // the output conversion saturates.
+    static constexpr double MIN_GAIN_DB = -120.0;
+    static constexpr double MAX_GAIN_DB = 24.0;
+
     // Default constructor
     Gain() : Gain("", 0) {}
 
-    // Constructor
-    explicit Gain(const std::string &channel_type, unsigned int channel_number);
+    // Constructor. Gain changes ramp over ramp_frames frames with the shape ramp, 0 applies them at the next block.
+    explicit Gain(const std::string &channel_type, unsigned int channel_number, size_t ramp_frames = 0, GainRamp ramp = GainRamp::Exponential);
 
     // Destructor
     ~Gain();
 
-    // Function to set the gain
+    // Function to set the gain. Gains above MAX_GAIN_DB are answered with set_gain_failed; MIN_GAIN_DB and below are
+    // stored as MIN_GAIN_DB and silence the channel.
     void set_gain(
         const std::string &channel_type, unsigned int channel_number, double gain_db,
         SetGainCallbackType callback = [](const std::string &, const std::string &, unsigned int, double) {});
@@ -34,29 +180,54 @@ public:
         const std::string &channel_type, unsigned int channel_number,
         SetGainCallbackType callback = [](const std::string &, const std::string &, unsigned int, double) {});
 
-    // Function to process a single sample through all enabled filters
-    short process(short sample);
+    // Function to process a block of samples of this channel (in[0] -> out[0]). Called from the audio thread only.
+    void process(const float *const *in, float **out, size_t nframes);
+
+    // Function to return the block kernel in use
+    const GainKernels &get_kernels() const { return kernels_; }
 
 private:
-    double gain = 0.0;
+    // Function to return the linear gain of a level
+    static float level_gain(double gain_db) { return gain_db <= MIN_GAIN_DB ? 0.0f : static_cast<float>(std::pow(10.0, gain_db / 20.0)); }
+
+    // Control side gain in dB, guarded by gain_mutex_. Only control threads take the mutex.
+    double gain_db_ = 0.0;
     std::string channelType;
     unsigned int channelNumber;
     // EventManager function ID
     size_t event_manager_set_function_id_, event_manager_get_function_id_;
     std::mutex gain_mutex_;
+    // Linear gain the audio thread ramps to
+    std::atomic<float> target_gain_{1.0f};
+
+    // Audio thread side: the gain applied at the start of the next frame, the target of the running ramp, the change per
+    // frame (added for linear ramps, multiplied for exponential ones) and the frames left
+    GainKernels kernels_;
+    size_t ramp_frames_;
+    GainRamp ramp_;
+    float current_gain_ = 1.0f;
+    float ramp_target_ = 1.0f;
+    float ramp_step_ = 0.0f;
+    size_t ramp_remaining_ = 0;
 };
 
 // Constructor
-Gain::Gain(const std::string &channel_type, unsigned int channel_number)
+Gain::Gain(const std::string &channel_type, unsigned int channel_number, size_t ramp_frames, GainRamp ramp)
     : channelType(channel_type),
-      channelNumber(channel_number)
+      channelNumber(channel_number),
+      kernels_(get_gain_kernels()),
+      ramp_frames_(ramp_frames),
+      ramp_(ramp)
 {
 
     // Emit get_database_gain event to get the gain from the database
     EventManager::getInstance().emitEvent<std::string, unsigned int, SetGainCallbackType>(
         "get_database_gain", channelType, channelNumber,
         [this](const std::string &command_type, const std::string &channel_type, unsigned int channel_number, double gain_db)
-        { this->set_gain(channel_type, channel_number, gain_db); });
+        { this->set_gain(channel_type, channel_number, std::min(gain_db, MAX_GAIN_DB)); });
+
+    // The audio thread starts at the stored gain instead of ramping to it
+    current_gain_ = ramp_target_ = target_gain_.load(std::memory_order_relaxed);
 
     // Register callback for set_gain event
     event_manager_set_function_id_ = EventManager::getInstance().on<const std::string &, unsigned int, double, SetGainCallbackType>(
@@ -81,22 +252,23 @@ void Gain::set_gain(
     const std::string &channel_type, unsigned int channel_number, double gain_db,
     SetGainCallbackType callback)
 {
-    // std::cout << "set_filter called, channelType: " << channelType << std::endl;
-    // std::cout << "set_filter called, channelNumber: " << channelNumber << std::endl;
-
     if (channel_type == channelType && channel_number == channelNumber)
     {
+        if (std::isnan(gain_db) || gain_db > MAX_GAIN_DB)
+        {
+            callback("set_gain_failed", channel_type, channel_number, gain_db);
+            return;
+        }
+
         // lock mutex
         std::lock_guard<std::mutex> lock(gain_mutex_);
+        gain_db_ = std::max(gain_db, MIN_GAIN_DB);
 
-        // convert gain_db to linear gain
-        gain = std::pow(10, gain_db / 20.0);
-
-        // clamp gain between 0.0 and 1.0
-        gain = std::max(0.0, std::min(1.0, gain));
+        // hand the new gain to the audio thread, which picks it up at the next block
+        target_gain_.store(level_gain(gain_db_), std::memory_order_relaxed);
 
         // execute callback
-        callback("notify_gain", channel_type, channel_number, gain_db);
+        callback("notify_gain", channel_type, channel_number, gain_db_);
     }
 }
 
@@ -105,30 +277,74 @@ void Gain::get_gain(
     const std::string &channel_type, unsigned int channel_number,
     SetGainCallbackType callback)
 {
-    // std::cout << "get_gain called, channelType: " << channelType << std::endl;
-    // std::cout << "get_gain called, channelNumber: " << channelNumber << std::endl;
-
     if (channel_type == channelType && channel_number == channelNumber)
     {
         // lock mutex
         std::lock_guard<std::mutex> lock(gain_mutex_);
 
         // execute callback
-        callback("notify_gain", channel_type, channel_number, 20.0 * std::log10(gain));
+        callback("notify_gain", channel_type, channel_number, gain_db_);
     }
 }
 
-// Function to process a single sample
-short Gain::process(short sample)
+// Function to process a block of samples
+void Gain::process(const float *const *in, float **out, size_t nframes)
 {
-    // lock mutex
-    std::lock_guard<std::mutex> lock(gain_mutex_);
+    // Start a ramp from the gain in use when the target changed since the last block, or jump to it without ramping
+    const float target = target_gain_.load(std::memory_order_relaxed);
+    if (target != ramp_target_)
+    {
+        ramp_target_ = target;
+        if (ramp_frames_ == 0)
+        {
+            current_gain_ = target;
+            ramp_remaining_ = 0;
+        }
+        else if (ramp_ == GainRamp::Linear)
+        {
+            ramp_step_ = (target - current_gain_) / ramp_frames_;
+            ramp_remaining_ = ramp_frames_;
+        }
+        else
+        {
+            // An exponential ramp never reaches zero, so ramps from and to silence run from and to the MIN_GAIN_DB level
+            const float floor = static_cast<float>(std::pow(10.0, MIN_GAIN_DB / 20.0));
+            current_gain_ = std::max(current_gain_, floor);
+            ramp_step_ = static_cast<float>(std::pow(static_cast<double>(std::max(target, floor)) / current_gain_, 1.0 / ramp_frames_));
+            ramp_remaining_ = ramp_frames_;
+        }
+    }
 
-    // apply gain
-    double out = sample * gain;
+    const float *input = in[0];
+    float *output = out[0];
+    size_t n = 0;
+    if (ramp_remaining_ > 0)
+    {
+        const size_t frames = std::min(nframes, ramp_remaining_);
+        float gain = current_gain_;
+        if (ramp_ == GainRamp::Linear)
+        {
+            for (; n < frames; ++n)
+            {
+                output[n] = input[n] * gain;
+                gain += ramp_step_;
+            }
+        }
+        else
+        {
+            for (; n < frames; ++n)
+            {
+                output[n] = input[n] * gain;
+                gain *= ramp_step_;
+            }
+        }
+        ramp_remaining_ -= frames;
+        // Land exactly on the target, without the rounding the steps add up to
+        current_gain_ = ramp_remaining_ == 0 ? ramp_target_ : gain;
+    }
 
-    // Return the processed sample
-    return static_cast<short>(out);
+    // apply the constant gain to the rest of the block
+    kernels_.scale(input + n, output + n, nframes - n, current_gain_);
 }
 
 #endif // GAIN_H
@@ -0,0 +1,179 @@
+// linear_phase.h
+// Design of linear-phase FIR filters with the magnitude response of a cascade of biquads, for the linear-phase equalizer mode.
+// The combined magnitude of the enabled sections is sampled on a grid of twice the FIR length, transformed back into a
+// zero-phase impulse response, centered in the FIR and tapered with a Hann window. The result has the equalizer's magnitude
+// response with a constant delay of half its length instead of the phase shifts of the biquads.
+// Designs run on a background thread, so dragging an EQ control never blocks the control threads on an FFT of this size.
+
+#ifndef LINEAR_PHASE_H
+#define LINEAR_PHASE_H
+
+#include <vector>
+#include <complex>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <cmath>
+#include "biquad_filter.h"
+#include "fft.h"
+
+// Function to return the FIR length of the linear-phase equalizer at a sample rate: the power of two that covers about
+// 1/6 s, which resolves bands down to about 20 Hz. 8192 taps at 44.1 and 48 kHz.
+inline size_t linear_phase_taps(double sample_rate)
+{
+    size_t taps = 1024;
+    while (taps < sample_rate / 6.0)
+    {
+        taps *= 2;
+    }
+    return taps;
+}
+
+// Function to return the delay in frames of a FIR from design_linear_phase_fir
+constexpr size_t linear_phase_latency(size_t taps)
+{
+    return taps / 2 - 1;
+}
+
+// Function to design a linear-phase FIR of taps taps (a power of two) with the magnitude response of the sections of
+// coefficients whose bit is set in enabled_mask. The last tap is zero, so the response is symmetric around an integer delay.
+std::vector<float> design_linear_phase_fir(const BiquadCoefficients *coefficients, uint32_t enabled_mask, unsigned int sections, size_t taps)
+{
+    const size_t size = 2 * taps;
+    auto magnitude = [&](double omega)
+    {
+        const std::complex<double> z1 = std::polar(1.0, -omega), z2 = z1 * z1;
+        double result = 1.0;
+        for (unsigned int i = 0; i < sections; ++i)
+        {
+            if ((enabled_mask >> i) & 1u)
+            {
+                const BiquadCoefficients &c = coefficients[i];
+                result *= std::abs(c.b0 + c.b1 * z1 + c.b2 * z2) / std::abs(1.0 + c.a1 * z1 + c.a2 * z2);
+            }
+        }
+        return result;
+    };
+
+    // Zero-phase spectrum, packed as RealFft expects it: the DC bin in re[0] and the Nyquist bin in im[0]
+    std::vector<float> re(size / 2), im(size / 2, 0.0f), response(size);
+    for (size_t k = 1; k < size / 2; ++k)
+    {
+        re[k] = static_cast<float>(magnitude(2.0 * M_PI * k / size));
+    }
+    re[0] = static_cast<float>(magnitude(0.0));
+    im[0] = static_cast<float>(magnitude(M_PI));
+    RealFft fft(size);
+    fft.inverse(re.data(), im.data(), response.data());
+
+    // The zero-phase response is symmetric around sample 0 of the circular inverse; rotate its center to the FIR's center
+    const size_t center = linear_phase_latency(taps);
+    std::vector<float> fir(taps, 0.0f);
+    for (size_t n = 0; n + 1 < taps; ++n)
+    {
+        const double window = 0.5 - 0.5 * std::cos(2.0 * M_PI * (n + 1) / taps);
+        fir[n] = static_cast<float>(response[(n + size - center) % size] * window / size);
+    }
+    return fir;
+}
+
+// Background thread running design jobs. Every owner has at most one job waiting: a new job replaces the waiting one, so a
+// burst of changes only designs the last. Jobs run one at a time in the order their owners first queued them.
+class LinearPhaseDesigner
+{
+public:
+    // Function to return the designer shared by all equalizers. The thread starts on the first call.
+    static LinearPhaseDesigner &getInstance()
+    {
+        static LinearPhaseDesigner instance;
+        return instance;
+    }
+
+    // Function to queue job for owner, replacing the job owner has waiting
+    void submit(const void *owner, std::function<void()> job);
+
+    // Function to drop the waiting job of owner and wait for its running job to finish. Called before the owner is destroyed.
+    void cancel(const void *owner);
+
+private:
+    LinearPhaseDesigner();
+    ~LinearPhaseDesigner();
+    // Thread entry point
+    void run();
+
+    std::mutex mutex_;
+    std::condition_variable wake_, finished_;
+    std::vector<std::pair<const void *, std::function<void()>>> jobs_;
+    const void *running_owner_ = nullptr;
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+// Constructor
+LinearPhaseDesigner::LinearPhaseDesigner()
+    : thread_(&LinearPhaseDesigner::run, this)
+{
+}
+
+// Destructor
+LinearPhaseDesigner::~LinearPhaseDesigner()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+// Function to queue a job
+void LinearPhaseDesigner::submit(const void *owner, std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto waiting = std::find_if(jobs_.begin(), jobs_.end(), [owner](const auto &entry) { return entry.first == owner; });
+        if (waiting != jobs_.end())
+        {
+            waiting->second = std::move(job);
+        }
+        else
+        {
+            jobs_.emplace_back(owner, std::move(job));
+        }
+    }
+    wake_.notify_one();
+}
+
+// Function to drop the jobs of an owner
+void LinearPhaseDesigner::cancel(const void *owner)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    jobs_.erase(std::remove_if(jobs_.begin(), jobs_.end(), [owner](const auto &entry) { return entry.first == owner; }), jobs_.end());
+    finished_.wait(lock, [this, owner]() { return running_owner_ != owner; });
+}
+
+// Thread entry point: runs the waiting jobs until the designer is destroyed
+void LinearPhaseDesigner::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        wake_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+        if (stopping_)
+        {
+            return;
+        }
+        std::pair<const void *, std::function<void()>> job = std::move(jobs_.front());
+        jobs_.erase(jobs_.begin());
+        running_owner_ = job.first;
+        lock.unlock();
+        job.second();
+        lock.lock();
+        running_owner_ = nullptr;
+        finished_.notify_all();
+    }
+}
+
+#endif // LINEAR_PHASE_H
@@ -1,5 +1,7 @@
 // meter.h
 // Creates a Meter element that can be used to measure the amplitude of an audio signal.
+// The audio thread accumulates the signal power over 100 ms windows and publishes each finished window through
+// atomics, so reading the meter never blocks the audio thread.
 
 #ifndef METER_H
 #define METER_H
@@ -7,8 +9,10 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <string>
-#include <mutex>
+#include <atomic>
+#include <memory>
 #include "../Utilities/event_manager.h"
 #include "../Utilities/type_aliases.h"
 
@@ -30,29 +34,38 @@ public:
     // Function to get the amplitude of all channels
     void get_meter(const std::string &channel_type, GetMeterCallbackType callback);
 
-    // Function to store a single sample
-    void store(const std::vector<short> &frame);
+    // Function to store a block of planar samples, one buffer per channel. Called from the audio thread only.
+    void store(const float *const *block, size_t nframes);
 
 private:
     std::string channel_type_;
     unsigned int channel_count_;
-    std::vector<std::vector<short>> frame_buffer_;
+    // Sum of squares of the current window, per channel. Only touched by the audio thread.
+    std::vector<double> window_sums_;
+    // Mean square of the last finished window, per channel, read by the control side
+    std::unique_ptr<std::atomic<float>[]> window_mean_squares_;
     // EventManager function ID
     size_t event_manager_function_id_;
-    std::mutex meter_mutex_;
     unsigned int buffer_size_;
     double sample_rate_;
     unsigned int current_frame_buffer_pos = 0;
-    const float DBFS_CONSTANT = 14000.0f;
+    // Level of the audio interface 0 dBFS in normalized float samples (14000 in 16 bit samples)
+    const float DBFS_CONSTANT = 14000.0f / 32768.0f;
 };
 
 // Constructor
 Meter::Meter(double sample_rate, const std::string &channel_type, unsigned int channel_count)
     : sample_rate_(sample_rate), channel_type_(channel_type), channel_count_(channel_count),
       buffer_size_(static_cast<unsigned int>(sample_rate * 0.1)),
-      frame_buffer_(channel_count, std::vector<short>(static_cast<unsigned int>(sample_rate * 0.1), 0))
+      window_sums_(channel_count, 0.0),
+      window_mean_squares_(new std::atomic<float>[channel_count])
 {
-    EventManager::getInstance().on<const std::string &, GetMeterCallbackType>(
+    for (unsigned int i = 0; i < channel_count_; i++)
+    {
+        window_mean_squares_[i].store(0.0f);
+    }
+
+    event_manager_function_id_ = EventManager::getInstance().on<const std::string &, GetMeterCallbackType>(
         "get_meter", [this](const std::string &channel_type, GetMeterCallbackType callback)
         { this->get_meter(channel_type, callback); });
 }
@@ -66,24 +79,12 @@ Meter::~Meter()
 // Function to store a single sample
 double Meter::get_channel_amplitude_db(unsigned int channel_number)
 {
-    // Lock the mutex
-    std::lock_guard<std::mutex> lock(meter_mutex_);
-
-    // Get the buffer for the channel
-    const std::vector<short> &samples_buffer = frame_buffer_[channel_number];
+    // Get the mean square of the last finished window for the channel
+    double mean_square = window_mean_squares_[channel_number].load(std::memory_order_relaxed);
 
-    // Initialize the sum as 0
-    double sum = 0.0;
-
-    // Calculate the sum of the squares of the samples. Divide by a constant to normalize the samples to the actual audio interface 0 dbFS level.
-    for (short sample : samples_buffer)
-    {
-        double normalized_sample = static_cast<double>(sample) / DBFS_CONSTANT;
-        sum += normalized_sample * normalized_sample;
-    }
-
-    // Calculate the root mean square of the samples and clamp it between 0 and 1
-    double amplitude_linear = std::clamp(static_cast<double>(std::sqrt(sum / static_cast<double>(buffer_size_))), 0.0, 1.0);
+    // Calculate the root mean square of the samples and clamp it between 0 and 1.
+    // Divide by a constant to normalize the samples to the actual audio interface 0 dbFS level.
+    double amplitude_linear = std::clamp(std::sqrt(mean_square) / DBFS_CONSTANT, 0.0, 1.0);
 
     // Convert the amplitude to decibels
     double amplitude_db = static_cast<double>(20 * std::log10(amplitude_linear));
@@ -107,26 +108,40 @@ void Meter::get_meter(const std::string &channel_type, GetMeterCallbackType call
     }
 }
 
-// Function to store a single frame
-void Meter::store(const std::vector<short> &frame)
+// Function to store a block of samples
+void Meter::store(const float *const *block, size_t nframes)
 {
-    // Lock the mutex
-    std::lock_guard<std::mutex> lock(meter_mutex_);
-
-    // Reset the position in the buffer if it has reached the end
-    if (current_frame_buffer_pos >= buffer_size_)
+    // Accumulate the block into the current window, splitting it where the window ends
+    size_t stored = 0;
+    while (stored < nframes)
     {
-        current_frame_buffer_pos = 0;
-    }
+        size_t run = std::min<size_t>(nframes - stored, buffer_size_ - current_frame_buffer_pos);
+        for (unsigned int i = 0; i < channel_count_; i++)
+        {
+            // Calculate the sum of the squares of the samples
+            float sum = 0.0f;
+            for (size_t n = stored; n < stored + run; n++)
+            {
+                sum += block[i][n] * block[i][n];
+            }
+            window_sums_[i] += sum;
+        }
 
-    // Store the received frame in the buffer
-    for (unsigned int i = 0; i < channel_count_; i++)
-    {
-        frame_buffer_[i][current_frame_buffer_pos] = frame[i];
-    }
+        // Increment the position in the window
+        current_frame_buffer_pos += run;
+        stored += run;
 
-    // Increment the position in the buffer
-    current_frame_buffer_pos++;
+        // Publish the finished window and start a new one if it has reached the end
+        if (current_frame_buffer_pos >= buffer_size_)
+        {
+            for (unsigned int i = 0; i < channel_count_; i++)
+            {
+                window_mean_squares_[i].store(static_cast<float>(window_sums_[i] / buffer_size_), std::memory_order_relaxed);
+                window_sums_[i] = 0.0;
+            }
+            current_frame_buffer_pos = 0;
+        }
+    }
 }
 
 #endif // METER_H
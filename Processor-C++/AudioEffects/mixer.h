@@ -1,5 +1,22 @@
 // Mixer.h
-// Creates a Mixer element that can be used to Mix inputs to outputs.
+// Creates a Mixer element that can be used to Mix inputs to outputs, directly or through buses (subgroups and aux sends).
+// The mixer is one matrix from its sources, the input channels and then the buses, to its destinations, the output channels
+// and then the buses. Inputs and buses feed buses and outputs, and buses may feed other buses as long as no bus feeds back
+// into itself; the buses are mixed in an order where each comes after the buses feeding it, found by a topological sort
+// whenever the routing changes. Every bus runs its own channel strip right after it is mixed, so processing shared by a
+// group of inputs runs once on their bus instead of on every output the group reaches.
+// Every crosspoint has a level in dB; MIN_LEVEL_DB and below switch it off. Every routing change compiles a new routing state
+// on the control thread, which is handed to the audio thread through a triple buffer and applied at the next block boundary.
+// The state holds the gains in one contiguous aligned array, one row per destination padded to whole tiles of
+// MIXER_TILE_INPUTS sources, and the same routing compiled into a list of the active sources of each destination. A dense
+// matrix is mixed as the product of each row with all source blocks; a sparse one only through its active routes, so its
+// cost follows the number of routes instead of the matrix size. Both go a tile at a time in float: the tile kernel reads
+// MIXER_TILE_INPUTS source blocks at once and adds their weighted sum into the destination block, with SSE2 and AVX2/FMA
+// variants on x86 and a NEON one on ARM, so a destination block is loaded and stored once per tile instead of once per source.
+// A crosspoint whose gain changes ramps linearly from the gain it had to the new one over the ramp time, so switching routes
+// does not click. The mix runs at the new gains and every ramping crosspoint adds the difference to its ramp on top; the
+// ramps are kept in a short list, so blocks without a routing change cost nothing extra. A snapshot recall changes many
+// crosspoints at once and ramps them all together.
 
 #ifndef MIXER_H
 #define MIXER_H
@@ -7,60 +24,401 @@
 #include <iostream>
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <string>
 #include <mutex>
+#include <cmath>
 #include "../Utilities/event_manager.h"
 #include "../Utilities/type_aliases.h"
+#include "../Utilities/triple_buffer.h"
+#include "../Utilities/aligned_allocator.h"
+#include "../Utilities/cpu_dispatch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIXER_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MIXER_NEON 1
+#endif
+
+// Number of inputs mixed by one kernel call
+constexpr unsigned int MIXER_TILE_INPUTS = 4;
+
+// Level of one crosspoint, as set by a snapshot recall
+struct MixerCrosspoint
+{
+    unsigned int input_channel;
+    unsigned int output_channel;
+    double level_db;
+};
+
+// How the mixer walks the routing: by density, always through the whole matrix or always through the active routes
+enum class MixerRouting
+{
+    Automatic,
+    Dense,
+    Sparse
+};
+
+// Tile kernel for one instruction set
+struct MixerKernels
+{
+    // Writes to out, or adds to it if accumulate is set, the sum of the MIXER_TILE_INPUTS blocks of in times their gains
+    void (*mix_tile)(const float *const *in, const float *gains, bool accumulate, float *out, size_t nframes);
+    // Number of frames per instruction and name of the instruction set, for logging
+    unsigned int width;
+    const char *name;
+};
+
+// Scalar kernel for CPUs without SSE2 or NEON. The vector kernels finish the frames after their last whole vector with it.
+void mixer_tile_scalar(const float *const *in, const float *gains, bool accumulate, float *out, size_t nframes)
+{
+    for (size_t n = 0; n < nframes; ++n)
+    {
+        const float sum = gains[0] * in[0][n] + gains[1] * in[1][n] + gains[2] * in[2][n] + gains[3] * in[3][n];
+        out[n] = accumulate ? out[n] + sum : sum;
+    }
+}
+
+#if defined(MIXER_X86)
+// SSE2 kernel, 4 frames per instruction
+__attribute__((target("sse2"))) void mixer_tile_sse2(const float *const *in, const float *gains, bool accumulate, float *out, size_t nframes)
+{
+    const __m128 g0 = _mm_set1_ps(gains[0]), g1 = _mm_set1_ps(gains[1]), g2 = _mm_set1_ps(gains[2]), g3 = _mm_set1_ps(gains[3]);
+    size_t n = 0;
+    for (; n + 4 <= nframes; n += 4)
+    {
+        __m128 acc = accumulate ? _mm_loadu_ps(out + n) : _mm_setzero_ps();
+        acc = _mm_add_ps(acc, _mm_mul_ps(g0, _mm_loadu_ps(in[0] + n)));
+        acc = _mm_add_ps(acc, _mm_mul_ps(g1, _mm_loadu_ps(in[1] + n)));
+        acc = _mm_add_ps(acc, _mm_mul_ps(g2, _mm_loadu_ps(in[2] + n)));
+        acc = _mm_add_ps(acc, _mm_mul_ps(g3, _mm_loadu_ps(in[3] + n)));
+        _mm_storeu_ps(out + n, acc);
+    }
+    const float *const tail[MIXER_TILE_INPUTS] = {in[0] + n, in[1] + n, in[2] + n, in[3] + n};
+    mixer_tile_scalar(tail, gains, accumulate, out + n, nframes - n);
+}
+
+// AVX2 kernel with fused multiply-add, 8 frames per instruction
+__attribute__((target("avx2,fma"))) void mixer_tile_avx2(const float *const *in, const float *gains, bool accumulate, float *out, size_t nframes)
+{
+    const __m256 g0 = _mm256_set1_ps(gains[0]), g1 = _mm256_set1_ps(gains[1]), g2 = _mm256_set1_ps(gains[2]), g3 = _mm256_set1_ps(gains[3]);
+    size_t n = 0;
+    for (; n + 8 <= nframes; n += 8)
+    {
+        __m256 acc = accumulate ? _mm256_loadu_ps(out + n) : _mm256_setzero_ps();
+        acc = _mm256_fmadd_ps(g0, _mm256_loadu_ps(in[0] + n), acc);
+        acc = _mm256_fmadd_ps(g1, _mm256_loadu_ps(in[1] + n), acc);
+        acc = _mm256_fmadd_ps(g2, _mm256_loadu_ps(in[2] + n), acc);
+        acc = _mm256_fmadd_ps(g3, _mm256_loadu_ps(in[3] + n), acc);
+        _mm256_storeu_ps(out + n, acc);
+    }
+    const float *const tail[MIXER_TILE_INPUTS] = {in[0] + n, in[1] + n, in[2] + n, in[3] + n};
+    mixer_tile_scalar(tail, gains, accumulate, out + n, nframes - n);
+}
+#endif // MIXER_X86
+
+#if defined(MIXER_NEON)
+// NEON kernel, 4 frames per instruction. AArch64 has a fused multiply-add; 32-bit ARM multiplies and adds.
+void mixer_tile_neon(const float *const *in, const float *gains, bool accumulate, float *out, size_t nframes)
+{
+#if defined(__aarch64__)
+#define MIXER_NEON_MLA vfmaq_n_f32
+#else
+#define MIXER_NEON_MLA vmlaq_n_f32
+#endif
+    size_t n = 0;
+    for (; n + 4 <= nframes; n += 4)
+    {
+        float32x4_t acc = accumulate ? vld1q_f32(out + n) : vdupq_n_f32(0.0f);
+        acc = MIXER_NEON_MLA(acc, vld1q_f32(in[0] + n), gains[0]);
+        acc = MIXER_NEON_MLA(acc, vld1q_f32(in[1] + n), gains[1]);
+        acc = MIXER_NEON_MLA(acc, vld1q_f32(in[2] + n), gains[2]);
+        acc = MIXER_NEON_MLA(acc, vld1q_f32(in[3] + n), gains[3]);
+        vst1q_f32(out + n, acc);
+    }
+#undef MIXER_NEON_MLA
+    const float *const tail[MIXER_TILE_INPUTS] = {in[0] + n, in[1] + n, in[2] + n, in[3] + n};
+    mixer_tile_scalar(tail, gains, accumulate, out + n, nframes - n);
+}
+#endif // MIXER_NEON
+
+// Returns the tile kernels this CPU can run, narrowest first
+std::vector<MixerKernels> get_supported_mixer_kernels()
+{
+    std::vector<MixerKernels> supported = {{mixer_tile_scalar, 1, "scalar"}};
+#if defined(MIXER_X86)
+    if (__builtin_cpu_supports("sse2"))
+    {
+        supported.push_back({mixer_tile_sse2, 4, "SSE2"});
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        supported.push_back({mixer_tile_avx2, 8, "AVX2/FMA"});
+    }
+#elif defined(MIXER_NEON)
+    supported.push_back({mixer_tile_neon, 4, "NEON"});
+#endif
+    return supported;
+}
+
+// Returns the tile kernel the mixer runs with
+const MixerKernels &get_mixer_kernels()
+{
+    return select_widest_kernels<MixerKernels, get_supported_mixer_kernels>();
+}
+
+// Gains of the routing state, aligned to a cache line so the gains of a tile never straddle two
+using MixerGains = std::vector<float, AlignedAllocator<float, 64>>;
+
 
 class Mixer
 {
 public:
+    // Crosspoint levels at or below MIN_LEVEL_DB are off. MAX_LEVEL_DB leaves headroom for summing into the float path.
+    static constexpr double MIN_LEVEL_DB = -120.0;
+    static constexpr double MAX_LEVEL_DB = 12.0;
+    // Automatic routing mixes through the active routes while their tiles are at most this share of the matrix tiles
+    static constexpr double SPARSE_MAX_FILL = 0.75;
+
     // Default constructor
     Mixer() : Mixer(0, 0) {}
 
-    // Constructor
-    explicit Mixer(unsigned int input_channels, unsigned int output_channels);
+    // Constructor. Gain changes ramp over ramp_frames frames, 0 applies them at the next block. kernels selects the tile kernel;
+    // nullptr uses the widest one supported by the CPU.
+    explicit Mixer(unsigned int input_channels, unsigned int output_channels, unsigned int bus_count = 0, size_t ramp_frames = 0,
+                   const MixerKernels *kernels = nullptr, MixerRouting routing = MixerRouting::Automatic);
 
     // Destructor
     ~Mixer();
 
-    // Function to set the mixer routing. If mix_bool is true, the input channel will be mixed to the output channel.
+    // Function to set the mixer routing. If mix_bool is true, the input channel is mixed to the output channel at 0 dB.
     void set_mixer(
         unsigned int input_channel_number, unsigned int output_channel_number, bool mix_bool,
         SetMixerCallbackType callback = [](const std::string &, unsigned int, unsigned int, bool) {});
 
-    // Function to return the mixing_matrix_ value for a given input and output channel
+    // Function to return whether an input channel is mixed to an output channel, at any level
     void get_mixer(unsigned int input_channel_number, unsigned int output_channel_number, SetMixerCallbackType callback);
 
-    // Function to process a single sample through the mixer
-    std::vector<short> process(const std::vector<short> &input_frame);
+    // Function to set the level in dB at which an input channel is mixed to an output channel. MIN_LEVEL_DB and below switch
+    // the crosspoint off; levels above MAX_LEVEL_DB are answered with set_mixer_level_failed.
+    void set_mixer_level(
+        unsigned int input_channel_number, unsigned int output_channel_number, double level_db,
+        SetMixerLevelCallbackType callback = [](const std::string &, unsigned int, unsigned int, double) {});
+
+    // Function to return the level of a crosspoint in dB, MIN_LEVEL_DB if it is off
+    void get_mixer_level(unsigned int input_channel_number, unsigned int output_channel_number, SetMixerLevelCallbackType callback);
+
+    // Function to set the levels of many crosspoints at once, ramping together. If any crosspoint is out of range or any level
+    // invalid, nothing changes and the recall is answered with set_mixer_snapshot_failed.
+    void set_mixer_snapshot(
+        const std::vector<MixerCrosspoint> &crosspoints,
+        SetMixerSnapshotCallbackType callback = [](const std::string &, const std::vector<MixerCrosspoint> &) {});
+
+    // Function to set the level in dB at which an input ("input") or a bus ("bus") is mixed to a bus ("bus") or an output
+    // ("output"). Input to output crosspoints belong to set_mixer_level. A route that would feed a bus back into itself, like
+    // an invalid level, is answered with set_bus_route_failed.
+    void set_bus_route(
+        const std::string &source_type, unsigned int source_number, const std::string &destination_type, unsigned int destination_number,
+        double level_db,
+        SetBusRouteCallbackType callback = [](const std::string &, const std::string &, unsigned int, const std::string &, unsigned int, double) {});
+
+    // Function to return the level of a bus route in dB, MIN_LEVEL_DB if it is off
+    void get_bus_route(const std::string &source_type, unsigned int source_number, const std::string &destination_type, unsigned int destination_number,
+                       SetBusRouteCallbackType callback);
+
+    // Function to process a block of planar samples through the mixer. Called from the audio thread only.
+    // in holds one buffer per source and out one buffer per destination, each nframes long: the input channels followed by the
+    // buses, and the output channels followed by the buses, with every bus's buffer in both. process_bus(bus) is called with
+    // the 0-based number of every bus right after the bus is mixed, to run its channel strip in place.
+    template <typename ProcessBus>
+    void process(const float *const *in, float **out, size_t nframes, ProcessBus &&process_bus);
+
+    // Function to process a block without buses, or with buses that have no channel strip
+    void process(const float *const *in, float **out, size_t nframes)
+    {
+        process(in, out, nframes, [](unsigned int) {});
+    }
+
+    // Function to return the tile kernel in use
+    const MixerKernels &get_kernels() const { return kernels_; }
+
+    // Function to return whether the current routing is mixed through the active routes
+    bool is_sparse();
 
 private:
-    std::vector<std::vector<float>> mixing_matrix_;
+    // Routing compiled for the audio thread
+    struct MixerState
+    {
+        // Whether to mix through the routes instead of the matrix
+        bool sparse = false;
+        // The gains, indexed [destination * row_stride_ + source], with the padding of each row at zero
+        MixerGains gains;
+        // The active routes of a destination are route_sources and route_gains [route_offsets[destination],
+        // route_offsets[destination + 1]), padded to whole tiles with gain zero
+        std::vector<unsigned int> route_offsets;
+        std::vector<unsigned int> route_sources;
+        MixerGains route_gains;
+        // The buses in the order they are mixed, each after the buses feeding it
+        std::vector<unsigned int> bus_order;
+    };
+
+    // A crosspoint ramping to its gain in the state. The mix runs at the new gain, and offset is how far the ramp still is from
+    // it, (remaining / ramp_frames_) of the way at the start of the next block.
+    struct MixerRamp
+    {
+        unsigned int source;
+        unsigned int destination;
+        float offset;
+        size_t remaining;
+    };
+
+    // Function to return whether a crosspoint and level are valid
+    bool is_valid(unsigned int input_channel_number, unsigned int output_channel_number) const;
+    static bool is_valid_level(double level_db) { return !std::isnan(level_db) && level_db <= MAX_LEVEL_DB; }
+
+    // Function to find the source and destination of a bus route. Returns false if there is no such bus route.
+    bool find_bus_route(const std::string &source_type, unsigned int source_number, const std::string &destination_type, unsigned int destination_number,
+                        unsigned int &source, unsigned int &destination) const;
+
+    // Function to store a crosspoint level. Called with mixer_mutex_ held, or from the constructor.
+    void store_level(unsigned int source, unsigned int destination, double level_db);
+
+    // Function to store the level of a bus route and update the bus order. If the route would close a loop, the level is left
+    // as it was and false is returned. Called with mixer_mutex_ held, or from the constructor.
+    bool store_bus_route(unsigned int source, unsigned int destination, double level_db);
+
+    // Function to sort the buses so that every bus comes after the buses feeding it. Returns false if the buses feed each
+    // other in a loop.
+    bool sort_buses(std::vector<unsigned int> &order) const;
+
+    // Function to compile the routing into the back state and hand it to the audio thread. Called with mixer_mutex_ held.
+    void publish_state();
+
+    // Function to mix the block of one destination from its sources, with the active routes or the whole row of the state
+    void mix_destination(unsigned int destination, const float *const *in, float **out, size_t nframes);
+
+    // Function to start a ramp for every crosspoint whose gain differs from the gain the audio thread mixed it at
+    void start_ramps(const MixerState &state);
+    // Function to add the ramps of the destinations [first_destination, last_destination) to the mixed block and drop the
+    // finished ones
+    void apply_ramps(const float *const *in, float **out, size_t nframes, unsigned int first_destination, unsigned int last_destination);
+
+    // Function to return the linear gain of a level
+    static float level_gain(double level_db) { return level_db <= MIN_LEVEL_DB ? 0.0f : static_cast<float>(std::pow(10.0, level_db / 20.0)); }
+
     unsigned int input_channels_;
     unsigned int output_channels_;
-    std::vector<short> output_frame_;
+    unsigned int bus_count_;
+    // Number of matrix sources (inputs, then buses) and destinations (outputs, then buses)
+    unsigned int sources_;
+    unsigned int destinations_;
+    unsigned int row_stride_;
+    MixerRouting routing_;
+    // Control side levels in dB, indexed [source * destinations_ + destination], their gains in the audio thread's layout and
+    // the bus order, guarded by mixer_mutex_. Only control threads take the mutex.
+    std::vector<double> levels_db_;
+    std::vector<float> gains_;
+    std::vector<unsigned int> bus_order_;
+    bool sparse_ = false;
     // EventManager function ID
     size_t event_manager_set_function_id_, event_manager_get_function_id_;
+    size_t event_manager_set_level_function_id_, event_manager_get_level_function_id_, event_manager_set_snapshot_function_id_;
+    size_t event_manager_set_bus_route_function_id_, event_manager_get_bus_route_function_id_;
     std::mutex mixer_mutex_;
+    // Routing states on their way to the audio thread
+    TripleBuffer<MixerState> states_;
+
+    // Audio thread side: the state in use, the source of every matrix column with the padding pointing at source 0, the
+    // gains of the state last taken, and the running ramps with the index of each crosspoint's ramp in the matrix layout.
+    // ramps_ has room for every crosspoint, so starting a ramp never allocates.
+    MixerKernels kernels_;
+    const MixerState *state_ = nullptr;
+    std::vector<const float *> dense_sources_;
+    size_t ramp_frames_;
+    std::vector<float> targets_;
+    std::vector<MixerRamp> ramps_;
+    std::vector<unsigned int> ramp_index_;
+    static constexpr unsigned int NO_RAMP = ~0u;
 };
 
 // Constructor
-Mixer::Mixer(unsigned int input_channels, unsigned int output_channels)
-    : input_channels_(input_channels), output_channels_(output_channels),
-      mixing_matrix_(input_channels, std::vector<float>(output_channels, 0.0f)),
-      output_frame_(output_channels, 0)
+Mixer::Mixer(unsigned int input_channels, unsigned int output_channels, unsigned int bus_count, size_t ramp_frames, const MixerKernels *kernels,
+             MixerRouting routing)
+    : input_channels_(input_channels), output_channels_(output_channels), bus_count_(bus_count),
+      sources_(input_channels + bus_count), destinations_(output_channels + bus_count),
+      row_stride_((sources_ + MIXER_TILE_INPUTS - 1) / MIXER_TILE_INPUTS * MIXER_TILE_INPUTS),
+      routing_(routing),
+      levels_db_(static_cast<size_t>(sources_) * destinations_, MIN_LEVEL_DB),
+      gains_(static_cast<size_t>(row_stride_) * destinations_, 0.0f),
+      kernels_(kernels ? *kernels : get_mixer_kernels()),
+      dense_sources_(row_stride_, nullptr),
+      ramp_frames_(ramp_frames),
+      targets_(gains_.size(), 0.0f),
+      ramp_index_(gains_.size(), NO_RAMP)
 {
-    for (int i = 0; i < input_channels_; ++i)
+    ramps_.reserve(gains_.size());
+    sort_buses(bus_order_);
+
+    // Load the routing from the database: the crosspoints first, then the levels of those that have one, then the bus routes.
+    // The audio thread is not running yet, so the levels are stored directly and compiled once at the end.
+    auto load_level = [this](unsigned int input_channel_number, unsigned int output_channel_number, double level_db)
     {
-        for (int j = 0; j < output_channels_; ++j)
+        if (is_valid(input_channel_number, output_channel_number))
+        {
+            store_level(input_channel_number - 1, output_channel_number - 1, level_db);
+        }
+    };
+    for (unsigned int i = 0; i < input_channels_; ++i)
+    {
+        for (unsigned int j = 0; j < output_channels_; ++j)
         {
             EventManager::getInstance().emitEvent<unsigned int, unsigned int, SetMixerCallbackType>(
                 "get_database_mixer", i + 1, j + 1,
-                [this](const std::string &command_type, unsigned int input_channel_number, unsigned int output_channel_number, bool mix_bool)
-                { this->set_mixer(input_channel_number, output_channel_number, mix_bool); });
+                [&load_level](const std::string &command_type, unsigned int input_channel_number, unsigned int output_channel_number, bool mix_bool)
+                { load_level(input_channel_number, output_channel_number, mix_bool ? 0.0 : MIN_LEVEL_DB); });
+            EventManager::getInstance().emitEvent<unsigned int, unsigned int, SetMixerLevelCallbackType>(
+                "get_database_mixer_level", i + 1, j + 1,
+                [&load_level](const std::string &command_type, unsigned int input_channel_number, unsigned int output_channel_number, double level_db)
+                {
+                    if (command_type == "notify_mixer_level")
+                    {
+                        load_level(input_channel_number, output_channel_number, std::clamp(level_db, MIN_LEVEL_DB, MAX_LEVEL_DB));
+                    }
+                });
+        }
+    }
+    // A stored bus route that would close a loop is dropped
+    auto load_bus_route = [this](const std::string &command_type, const std::string &source_type, unsigned int source_number,
+                                 const std::string &destination_type, unsigned int destination_number, double level_db)
+    {
+        unsigned int source, destination;
+        if (command_type == "notify_bus_route" && find_bus_route(source_type, source_number, destination_type, destination_number, source, destination))
+        {
+            store_bus_route(source, destination, std::clamp(level_db, MIN_LEVEL_DB, MAX_LEVEL_DB));
+        }
+    };
+    for (const std::string source_type : {"input", "bus"})
+    {
+        for (const std::string destination_type : {"bus", "output"})
+        {
+            const unsigned int source_count = source_type == "input" ? input_channels_ : bus_count_;
+            const unsigned int destination_count = destination_type == "output" ? output_channels_ : bus_count_;
+            for (unsigned int i = 1; i <= source_count && !(source_type == "input" && destination_type == "output"); ++i)
+            {
+                for (unsigned int j = 1; j <= destination_count; ++j)
+                {
+                    EventManager::getInstance().emitEvent<std::string, unsigned int, std::string, unsigned int, SetBusRouteCallbackType>(
+                        "get_database_bus_route", source_type, i, destination_type, j, load_bus_route);
+                }
+            }
         }
     }
+    {
+        std::lock_guard<std::mutex> lock(mixer_mutex_);
+        publish_state();
+    }
 
     // Register the set_mixer function with the corresponding event
     event_manager_set_function_id_ = EventManager::getInstance().on<unsigned int, unsigned int, bool, SetMixerCallbackType>(
@@ -71,6 +429,33 @@ Mixer::Mixer(unsigned int input_channels, unsigned int output_channels)
     event_manager_get_function_id_ = EventManager::getInstance().on<unsigned int, unsigned int, SetMixerCallbackType>(
         "get_mixer", [this](unsigned int input_channel_number, unsigned int output_channel_number, SetMixerCallbackType callback)
         { this->get_mixer(input_channel_number, output_channel_number, callback); });
+
+    // Register the set_mixer_level function with the corresponding event
+    event_manager_set_level_function_id_ = EventManager::getInstance().on<unsigned int, unsigned int, double, SetMixerLevelCallbackType>(
+        "set_mixer_level", [this](unsigned int input_channel_number, unsigned int output_channel_number, double level_db, SetMixerLevelCallbackType callback)
+        { this->set_mixer_level(input_channel_number, output_channel_number, level_db, callback); });
+
+    // Register the get_mixer_level function with the corresponding event
+    event_manager_get_level_function_id_ = EventManager::getInstance().on<unsigned int, unsigned int, SetMixerLevelCallbackType>(
+        "get_mixer_level", [this](unsigned int input_channel_number, unsigned int output_channel_number, SetMixerLevelCallbackType callback)
+        { this->get_mixer_level(input_channel_number, output_channel_number, callback); });
+
+    // Register the set_mixer_snapshot function with the corresponding event
+    event_manager_set_snapshot_function_id_ = EventManager::getInstance().on<const std::vector<MixerCrosspoint> &, SetMixerSnapshotCallbackType>(
+        "set_mixer_snapshot", [this](const std::vector<MixerCrosspoint> &crosspoints, SetMixerSnapshotCallbackType callback)
+        { this->set_mixer_snapshot(crosspoints, callback); });
+
+    // Register the set_bus_route function with the corresponding event
+    event_manager_set_bus_route_function_id_ = EventManager::getInstance().on<const std::string &, unsigned int, const std::string &, unsigned int, double, SetBusRouteCallbackType>(
+        "set_bus_route", [this](const std::string &source_type, unsigned int source_number, const std::string &destination_type, unsigned int destination_number,
+                                double level_db, SetBusRouteCallbackType callback)
+        { this->set_bus_route(source_type, source_number, destination_type, destination_number, level_db, callback); });
+
+    // Register the get_bus_route function with the corresponding event
+    event_manager_get_bus_route_function_id_ = EventManager::getInstance().on<const std::string &, unsigned int, const std::string &, unsigned int, SetBusRouteCallbackType>(
+        "get_bus_route", [this](const std::string &source_type, unsigned int source_number, const std::string &destination_type, unsigned int destination_number,
+                                SetBusRouteCallbackType callback)
+        { this->get_bus_route(source_type, source_number, destination_type, destination_number, callback); });
 }
 
 // Destructor
@@ -78,59 +463,438 @@ Mixer::~Mixer()
 {
     EventManager::getInstance().off("set_mixer", event_manager_set_function_id_);
     EventManager::getInstance().off("get_mixer", event_manager_get_function_id_);
+    EventManager::getInstance().off("set_mixer_level", event_manager_set_level_function_id_);
+    EventManager::getInstance().off("get_mixer_level", event_manager_get_level_function_id_);
+    EventManager::getInstance().off("set_mixer_snapshot", event_manager_set_snapshot_function_id_);
+    EventManager::getInstance().off("set_bus_route", event_manager_set_bus_route_function_id_);
+    EventManager::getInstance().off("get_bus_route", event_manager_get_bus_route_function_id_);
+}
+
+// Function to return whether a crosspoint exists
+bool Mixer::is_valid(unsigned int input_channel_number, unsigned int output_channel_number) const
+{
+    return input_channel_number >= 1 && input_channel_number <= input_channels_ && output_channel_number >= 1 && output_channel_number <= output_channels_;
+}
+
+// Function to find the source and destination of a bus route
+bool Mixer::find_bus_route(const std::string &source_type, unsigned int source_number, const std::string &destination_type,
+                           unsigned int destination_number, unsigned int &source, unsigned int &destination) const
+{
+    if (source_type == "input" && source_number >= 1 && source_number <= input_channels_)
+    {
+        source = source_number - 1;
+    }
+    else if (source_type == "bus" && source_number >= 1 && source_number <= bus_count_)
+    {
+        source = input_channels_ + source_number - 1;
+    }
+    else
+    {
+        return false;
+    }
+
+    if (destination_type == "output" && destination_number >= 1 && destination_number <= output_channels_)
+    {
+        destination = destination_number - 1;
+    }
+    else if (destination_type == "bus" && destination_number >= 1 && destination_number <= bus_count_)
+    {
+        destination = output_channels_ + destination_number - 1;
+    }
+    else
+    {
+        return false;
+    }
+    return source_type == "bus" || destination_type == "bus";
+}
+
+// Function to store a crosspoint level
+void Mixer::store_level(unsigned int source, unsigned int destination, double level_db)
+{
+    levels_db_[source * destinations_ + destination] = level_db;
+    gains_[destination * row_stride_ + source] = level_gain(level_db);
+}
+
+// Function to store the level of a bus route
+bool Mixer::store_bus_route(unsigned int source, unsigned int destination, double level_db)
+{
+    const double previous_level_db = levels_db_[source * destinations_ + destination];
+    store_level(source, destination, level_db);
+    if (source < input_channels_ || destination < output_channels_)
+    {
+        return true;
+    }
+    // Only a route between two buses can close a loop
+    if (!sort_buses(bus_order_))
+    {
+        store_level(source, destination, previous_level_db);
+        return false;
+    }
+    return true;
+}
+
+// Function to sort the buses (Kahn's algorithm). Among the buses that are ready, the lowest number goes first.
+bool Mixer::sort_buses(std::vector<unsigned int> &order) const
+{
+    auto feeds = [this](unsigned int from, unsigned int to)
+    { return gains_[static_cast<size_t>(output_channels_ + to) * row_stride_ + input_channels_ + from] != 0.0f; };
+
+    std::vector<unsigned int> pending_feeds(bus_count_, 0);
+    for (unsigned int to = 0; to < bus_count_; ++to)
+    {
+        for (unsigned int from = 0; from < bus_count_; ++from)
+        {
+            pending_feeds[to] += feeds(from, to);
+        }
+    }
+    std::vector<unsigned int> sorted;
+    std::vector<bool> done(bus_count_, false);
+    while (sorted.size() < bus_count_)
+    {
+        unsigned int next = 0;
+        while (next < bus_count_ && (done[next] || pending_feeds[next] != 0))
+        {
+            ++next;
+        }
+        if (next == bus_count_)
+        {
+            // Every bus left is fed by another one left: a loop
+            return false;
+        }
+        done[next] = true;
+        sorted.push_back(next);
+        for (unsigned int to = 0; to < bus_count_; ++to)
+        {
+            pending_feeds[to] -= feeds(next, to);
+        }
+    }
+    order = sorted;
+    return true;
+}
+
+// Function to compile the routing. The back state belongs to this thread, so it is rebuilt in place: its vectors keep their
+// capacity from the previous time this slot was filled, and the audio thread never allocates or frees.
+void Mixer::publish_state()
+{
+    MixerState &state = states_.back();
+    state.gains.assign(gains_.begin(), gains_.end());
+    state.route_offsets.assign(destinations_ + 1, 0);
+    state.route_sources.clear();
+    state.route_gains.clear();
+    for (unsigned int destination = 0; destination < destinations_; ++destination)
+    {
+        const float *row = gains_.data() + static_cast<size_t>(destination) * row_stride_;
+        const size_t first = state.route_sources.size();
+        for (unsigned int source = 0; source < sources_; ++source)
+        {
+            if (row[source] != 0.0f)
+            {
+                state.route_sources.push_back(source);
+                state.route_gains.push_back(row[source]);
+            }
+        }
+        // Pad the last tile with the first route of the destination at gain zero
+        while ((state.route_sources.size() - first) % MIXER_TILE_INPUTS != 0)
+        {
+            state.route_sources.push_back(state.route_sources[first]);
+            state.route_gains.push_back(0.0f);
+        }
+        state.route_offsets[destination + 1] = static_cast<unsigned int>(state.route_sources.size());
+    }
+    state.bus_order.assign(bus_order_.begin(), bus_order_.end());
+
+    if (routing_ == MixerRouting::Automatic)
+    {
+        state.sparse = state.route_sources.size() <= SPARSE_MAX_FILL * state.gains.size();
+    }
+    else
+    {
+        state.sparse = routing_ == MixerRouting::Sparse;
+    }
+    sparse_ = state.sparse;
+    states_.publish();
 }
 
 // Function to set the mixer routing. If mix_bool is true, the input channel will be mixed to the output channel.
 void Mixer::set_mixer(unsigned int input_channel_number, unsigned int output_channel_number, bool mix_bool,
                       SetMixerCallbackType callback)
 {
-    if (input_channel_number <= input_channels_ && output_channel_number <= output_channels_)
+    if (is_valid(input_channel_number, output_channel_number))
     {
-        // Lock the mixer_mutex_ to prevent the mixing_matrix_ from being modified while it is being read.
+        // Lock the mixer_mutex_ to prevent the levels from being modified while they are being read by another control thread.
         std::lock_guard<std::mutex> lock(mixer_mutex_);
-        // If mix_bool is true, set the mixing_matrix_ value to 1.0f. Otherwise, set the mixing_matrix_ value to 0.0f.
-        float mix = mix_bool ? 1.0f : 0.0f;
-        mixing_matrix_[input_channel_number - 1][output_channel_number - 1] = mix;
+        store_level(input_channel_number - 1, output_channel_number - 1, mix_bool ? 0.0 : MIN_LEVEL_DB);
+        publish_state();
         // Execute callback function
         callback("notify_mixer", input_channel_number, output_channel_number, mix_bool);
     }
 }
 
-// Function to return the mixing_matrix_ value for a given input and output channel
+// Function to return whether a crosspoint is on
 void Mixer::get_mixer(unsigned int input_channel_number, unsigned int output_channel_number, SetMixerCallbackType callback)
 {
-    if (input_channel_number <= input_channels_ && output_channel_number <= output_channels_)
+    if (is_valid(input_channel_number, output_channel_number))
     {
-        // Lock the mixer_mutex_ to prevent the mixing_matrix_ from being modified while it is being read.
+        // Lock the mixer_mutex_ to prevent the levels from being modified while they are being read.
         std::lock_guard<std::mutex> lock(mixer_mutex_);
         // Execute callback function
-        callback("notify_mixer", input_channel_number, output_channel_number, mixing_matrix_[input_channel_number - 1][output_channel_number - 1] ? true : false);
+        callback("notify_mixer", input_channel_number, output_channel_number,
+                 levels_db_[(input_channel_number - 1) * destinations_ + output_channel_number - 1] > MIN_LEVEL_DB);
     }
 }
 
-// Function to process a frame of one sample of each input channel through the mixer
-std::vector<short> Mixer::process(const std::vector<short> &input_frame)
+// Function to set the level of a crosspoint
+void Mixer::set_mixer_level(unsigned int input_channel_number, unsigned int output_channel_number, double level_db,
+                            SetMixerLevelCallbackType callback)
 {
-    // Lock the mixer_mutex_ to prevent the mixing_matrix_ from being modified while it is being read.
+    if (is_valid(input_channel_number, output_channel_number))
+    {
+        if (!is_valid_level(level_db))
+        {
+            callback("set_mixer_level_failed", input_channel_number, output_channel_number, level_db);
+            return;
+        }
+        const double stored_level_db = std::max(level_db, MIN_LEVEL_DB);
+
+        std::lock_guard<std::mutex> lock(mixer_mutex_);
+        store_level(input_channel_number - 1, output_channel_number - 1, stored_level_db);
+        publish_state();
+        callback("notify_mixer_level", input_channel_number, output_channel_number, stored_level_db);
+    }
+}
+
+// Function to return the level of a crosspoint
+void Mixer::get_mixer_level(unsigned int input_channel_number, unsigned int output_channel_number, SetMixerLevelCallbackType callback)
+{
+    if (is_valid(input_channel_number, output_channel_number))
+    {
+        std::lock_guard<std::mutex> lock(mixer_mutex_);
+        callback("notify_mixer_level", input_channel_number, output_channel_number,
+                 levels_db_[(input_channel_number - 1) * destinations_ + output_channel_number - 1]);
+    }
+}
+
+// Function to set the levels of many crosspoints at once
+void Mixer::set_mixer_snapshot(const std::vector<MixerCrosspoint> &crosspoints, SetMixerSnapshotCallbackType callback)
+{
+    for (const MixerCrosspoint &crosspoint : crosspoints)
+    {
+        if (!is_valid(crosspoint.input_channel, crosspoint.output_channel) || !is_valid_level(crosspoint.level_db))
+        {
+            callback("set_mixer_snapshot_failed", crosspoints);
+            return;
+        }
+    }
+
+    std::vector<MixerCrosspoint> stored = crosspoints;
     std::lock_guard<std::mutex> lock(mixer_mutex_);
+    for (MixerCrosspoint &crosspoint : stored)
+    {
+        crosspoint.level_db = std::max(crosspoint.level_db, MIN_LEVEL_DB);
+        store_level(crosspoint.input_channel - 1, crosspoint.output_channel - 1, crosspoint.level_db);
+    }
+    // One state for the whole recall, so all its crosspoints start ramping in the same block
+    publish_state();
+    callback("notify_mixer_snapshot", stored);
+}
 
-    // Reset the mixed_samples vector to zero for the current frame.
-    // IMPORTANT! This is necessary because the mixed_samples vector is used to store the sum of the samples from each input channel.
-    // If the mixed_samples vector is not reset to zero, the sum of the samples from each input channel will be added to the previous sum,
-    // which will result in an incorrect output.
-    std::fill(output_frame_.begin(), output_frame_.end(), 0);
+// Function to set the level of a bus route
+void Mixer::set_bus_route(const std::string &source_type, unsigned int source_number, const std::string &destination_type,
+                          unsigned int destination_number, double level_db, SetBusRouteCallbackType callback)
+{
+    unsigned int source, destination;
+    if (!find_bus_route(source_type, source_number, destination_type, destination_number, source, destination))
+    {
+        return;
+    }
+    if (!is_valid_level(level_db))
+    {
+        callback("set_bus_route_failed", source_type, source_number, destination_type, destination_number, level_db);
+        return;
+    }
+    const double stored_level_db = std::max(level_db, MIN_LEVEL_DB);
 
-    // Multiply each input channel sample by the corresponding mixing_matrix_ value and add the result to the output_frame_ vector.
-    for (unsigned int in_ch = 0; in_ch < input_channels_; ++in_ch)
+    std::lock_guard<std::mutex> lock(mixer_mutex_);
+    if (!store_bus_route(source, destination, stored_level_db))
     {
-        for (unsigned int out_ch = 0; out_ch < output_channels_; ++out_ch)
+        callback("set_bus_route_failed", source_type, source_number, destination_type, destination_number, levels_db_[source * destinations_ + destination]);
+        return;
+    }
+    publish_state();
+    callback("notify_bus_route", source_type, source_number, destination_type, destination_number, stored_level_db);
+}
+
+// Function to return the level of a bus route
+void Mixer::get_bus_route(const std::string &source_type, unsigned int source_number, const std::string &destination_type,
+                          unsigned int destination_number, SetBusRouteCallbackType callback)
+{
+    unsigned int source, destination;
+    if (find_bus_route(source_type, source_number, destination_type, destination_number, source, destination))
+    {
+        std::lock_guard<std::mutex> lock(mixer_mutex_);
+        callback("notify_bus_route", source_type, source_number, destination_type, destination_number, levels_db_[source * destinations_ + destination]);
+    }
+}
+
+// Function to return whether the current routing is mixed through the active routes
+bool Mixer::is_sparse()
+{
+    std::lock_guard<std::mutex> lock(mixer_mutex_);
+    return sparse_;
+}
+
+// Function to start the ramps of a new state. Runs only in blocks that take a new state.
+void Mixer::start_ramps(const MixerState &state)
+{
+    for (unsigned int destination = 0; destination < destinations_; ++destination)
+    {
+        for (unsigned int source = 0; source < sources_; ++source)
+        {
+            const size_t crosspoint = static_cast<size_t>(destination) * row_stride_ + source;
+            const float target = state.gains[crosspoint];
+            if (target == targets_[crosspoint])
+            {
+                continue;
+            }
+            // Ramp from where the crosspoint is now, which is part of the way along its ramp if it has one
+            unsigned int &index = ramp_index_[crosspoint];
+            float current = targets_[crosspoint];
+            if (index != NO_RAMP)
+            {
+                current += ramps_[index].offset * ramps_[index].remaining / ramp_frames_;
+            }
+            else
+            {
+                index = static_cast<unsigned int>(ramps_.size());
+                ramps_.push_back({source, destination, 0.0f, 0});
+            }
+            ramps_[index].offset = current - target;
+            ramps_[index].remaining = ramp_frames_;
+            targets_[crosspoint] = target;
+        }
+    }
+}
+
+// Function to add the ramps to the block
+void Mixer::apply_ramps(const float *const *in, float **out, size_t nframes, unsigned int first_destination, unsigned int last_destination)
+{
+    const float step_scale = 1.0f / ramp_frames_;
+    for (size_t r = 0; r < ramps_.size();)
+    {
+        MixerRamp &ramp = ramps_[r];
+        if (ramp.destination < first_destination || ramp.destination >= last_destination)
+        {
+            ++r;
+            continue;
+        }
+        const float *input = in[ramp.source];
+        float *output = out[ramp.destination];
+        // The ramp's distance from the target shrinks by offset / ramp_frames_ per frame and reaches zero after remaining frames
+        const float step = ramp.offset * step_scale;
+        float difference = step * (ramp.remaining - 1);
+        const size_t frames = std::min(nframes, ramp.remaining);
+        for (size_t n = 0; n < frames; ++n)
+        {
+            output[n] += difference * input[n];
+            difference -= step;
+        }
+        ramp.remaining -= frames;
+        if (ramp.remaining > 0)
+        {
+            ++r;
+            continue;
+        }
+        // Finished: move the last ramp into its place
+        ramp_index_[static_cast<size_t>(ramp.destination) * row_stride_ + ramp.source] = NO_RAMP;
+        if (r + 1 < ramps_.size())
+        {
+            ramp = ramps_.back();
+            ramp_index_[static_cast<size_t>(ramp.destination) * row_stride_ + ramp.source] = static_cast<unsigned int>(r);
+        }
+        ramps_.pop_back();
+    }
+}
+
+// Function to mix the block of one destination
+void Mixer::mix_destination(unsigned int destination, const float *const *in, float **out, size_t nframes)
+{
+    if (state_->sparse)
+    {
+        // Only the active routes of the destination, a tile of them at a time
+        const unsigned int first = state_->route_offsets[destination], last = state_->route_offsets[destination + 1];
+        if (first == last)
         {
-            output_frame_[out_ch] +=
-                static_cast<short>(input_frame[in_ch] * mixing_matrix_[in_ch][out_ch]);
+            // A destination without any routed source is silent
+            std::fill(out[destination], out[destination] + nframes, 0.0f);
+            return;
         }
+        const float *tile_sources[MIXER_TILE_INPUTS];
+        for (unsigned int route = first; route < last; route += MIXER_TILE_INPUTS)
+        {
+            for (unsigned int i = 0; i < MIXER_TILE_INPUTS; ++i)
+            {
+                tile_sources[i] = in[state_->route_sources[route + i]];
+            }
+            kernels_.mix_tile(tile_sources, state_->route_gains.data() + route, route != first, out[destination], nframes);
+        }
+        return;
     }
 
-    return output_frame_;
+    // The product of the destination's row with all source blocks
+    const float *row = state_->gains.data() + static_cast<size_t>(destination) * row_stride_;
+    for (unsigned int first = 0; first < sources_; first += MIXER_TILE_INPUTS)
+    {
+        kernels_.mix_tile(dense_sources_.data() + first, row + first, first != 0, out[destination], nframes);
+    }
+}
+
+// Function to process a block of samples of each source through the mixer
+template <typename ProcessBus>
+void Mixer::process(const float *const *in, float **out, size_t nframes, ProcessBus &&process_bus)
+{
+    // Apply the newest routing at the block boundary. The state stays valid until the next consume(). The first state is
+    // taken as it is; later ones ramp the crosspoints they change.
+    if (const MixerState *state = states_.consume())
+    {
+        if (state_ == nullptr || ramp_frames_ == 0)
+        {
+            targets_.assign(state->gains.begin(), state->gains.end());
+        }
+        else
+        {
+            start_ramps(*state);
+        }
+        state_ = state;
+    }
+    if (state_ == nullptr || sources_ == 0)
+    {
+        for (unsigned int destination = 0; destination < destinations_; ++destination)
+        {
+            std::fill(out[destination], out[destination] + nframes, 0.0f);
+        }
+        return;
+    }
+
+    // The padding of the last tile reads source 0 at gain zero
+    for (unsigned int source = 0; source < row_stride_; ++source)
+    {
+        dense_sources_[source] = in[source < sources_ ? source : 0];
+    }
+
+    // Every bus after the buses feeding it, then the outputs. A bus to bus route that is fading out while the reverse route
+    // fades in reads the previous block of its source during the fade.
+    for (unsigned int bus : state_->bus_order)
+    {
+        const unsigned int destination = output_channels_ + bus;
+        mix_destination(destination, in, out, nframes);
+        apply_ramps(in, out, nframes, destination, destination + 1);
+        process_bus(bus);
+    }
+    for (unsigned int destination = 0; destination < output_channels_; ++destination)
+    {
+        mix_destination(destination, in, out, nframes);
+    }
+    apply_ramps(in, out, nframes, 0, output_channels_);
 }
 
 #endif // MIXER_H
@@ -1,5 +1,6 @@
 // Mute.h
 // Creates a Mute element that can be used to Mute an audio signal.
+// Mute changes are handed to the audio thread through a lock-free queue and applied at the next block boundary.
 
 #ifndef MUTE_H
 #define MUTE_H
@@ -11,6 +12,7 @@
 #include <mutex>
 #include "../Utilities/event_manager.h"
 #include "../Utilities/type_aliases.h"
+#include "../Utilities/spsc_queue.h"
 
 class Mute
 {
@@ -33,16 +35,20 @@ public:
     void get_mute(
         const std::string &channel_type, unsigned int channel_number, SetMuteCallbackType callback = [](const std::string &, const std::string &, unsigned int, bool) {});
 
-    // Function to process a single sample through all enabled filters
-    short process(short sample);
+    // Function to process a block of samples of this channel (in[0] -> out[0]). Called from the audio thread only.
+    void process(const float *const *in, float **out, size_t nframes);
 
 private:
+    // Control side mute value, guarded by mute_mutex_. Only control threads take the mutex.
     double mute = 0.0;
     std::string channelType;
     unsigned int channelNumber;
     // EventManager function ID
     size_t event_manager_set_function_id_, event_manager_get_function_id_;
     std::mutex mute_mutex_;
+    // Mute changes on their way to the audio thread, and the mute factor the audio thread currently applies
+    SpscQueue<float, 16> mute_commands_;
+    float audio_mute_ = 0.0f;
 };
 
 // Constructor
@@ -88,8 +94,16 @@ void Mute::set_mute(
         // lock the mutex
         std::lock_guard<std::mutex> lock(mute_mutex_);
 
+        // hand the new mute value to the audio thread. If the audio thread has fallen behind and the queue is full, report the failure.
+        double new_mute = mute_bool ? 0.0 : 1.0;
+        if (!mute_commands_.push(static_cast<float>(new_mute)))
+        {
+            callback("set_mute_failed", channel_type, channel_number, mute == 0.0);
+            return;
+        }
+
         // set the mute value
-        mute = mute_bool ? 0.0 : 1.0;
+        mute = new_mute;
 
         // call the callback function
         callback("notify_mute", channel_type, channel_number, mute_bool);
@@ -114,17 +128,22 @@ void Mute::get_mute(
     }
 }
 
-// Function to process a single sample
-short Mute::process(short sample)
+// Function to process a block of samples
+void Mute::process(const float *const *in, float **out, size_t nframes)
 {
-    // lock the mutex
-    std::lock_guard<std::mutex> lock(mute_mutex_);
+    // apply pending mute changes at the block boundary, keeping only the latest one
+    float new_mute;
+    while (mute_commands_.pop(new_mute))
+    {
+        audio_mute_ = new_mute;
+    }
+    const float block_mute = audio_mute_;
 
     // apply the mute
-    double out = sample * mute;
-
-    // return the processed sample
-    return static_cast<short>(out);
+    for (size_t n = 0; n < nframes; ++n)
+    {
+        out[0][n] = in[0][n] * block_mute;
+    }
 }
 
 #endif // MUTE_H
@@ -0,0 +1,180 @@
+// biquad_bank.cpp
+// Benchmark of the equalizer filters: per-channel double precision direct form I BiquadT sections against the BiquadBank with
+// every section kernel this CPU supports. All channels run the same number of enabled peaking bands on synthetic audio.
+// Prints the time per sample per band in nanoseconds, the speedup over the sections and the largest deviation from their output.
+// The "sweep" rows retune every band of every channel before each period, so every period runs with coefficient ramps
+// of -smoothing: ms, the worst case while operators drag EQ sliders.
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include "../AudioEffects/biquad_filter.h"
+#include "../AudioEffects/biquad_bank.h"
+
+// Function to fill every channel buffer with the same noise sequence for each implementation
+void fill_noise(std::vector<std::vector<float>> &buffers, unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+    for (auto &buffer : buffers)
+    {
+        std::generate(buffer.begin(), buffer.end(), [&]() { return noise(generator); });
+    }
+}
+
+// Function to design the filter of one band: peaking bands spaced logarithmically from 20 Hz to 20 kHz, kept below Nyquist
+BiquadCoefficients make_band(unsigned int band, unsigned int bands, unsigned int rate, double detune = 1.0)
+{
+    double frequency = std::min(20.0 * std::pow(1000.0, bands > 1 ? band / (bands - 1.0) : 0.0) * detune, 0.45 * rate);
+    return design_biquad(FilterType::Peaking, rate, frequency, 1.0, band % 2 ? 3.0 : -3.0);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int channels = 16, bands = 16, period_frames = 128, rate = 48000, periods = 2000, smoothing_ms = 20;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        auto value = [&arg](const std::string &flag) { return arg.substr(flag.length()); };
+        if (arg.find("-channels:") == 0)
+            std::istringstream(value("-channels:")) >> channels;
+        else if (arg.find("-bands:") == 0)
+            std::istringstream(value("-bands:")) >> bands;
+        else if (arg.find("-period:") == 0)
+            std::istringstream(value("-period:")) >> period_frames;
+        else if (arg.find("-rate:") == 0)
+            std::istringstream(value("-rate:")) >> rate;
+        else if (arg.find("-periods:") == 0)
+            std::istringstream(value("-periods:")) >> periods;
+        else if (arg.find("-smoothing:") == 0)
+            std::istringstream(value("-smoothing:")) >> smoothing_ms;
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [-channels:<channels>] [-bands:<bands>] [-period:<frames>] [-rate:<sample_rate>] [-periods:<measured_periods>] [-smoothing:<ms>]" << std::endl;
+            return 1;
+        }
+    }
+    if (channels == 0 || bands == 0 || period_frames == 0 || rate == 0 || periods == 0)
+    {
+        std::cerr << "All arguments must be positive" << std::endl;
+        return 1;
+    }
+
+    const double samples_per_band = static_cast<double>(channels) * period_frames * periods * bands;
+    std::vector<std::vector<float>> buffers(channels, std::vector<float>(period_frames));
+    std::vector<float *> channel_ptrs;
+    for (auto &buffer : buffers)
+    {
+        channel_ptrs.push_back(buffer.data());
+    }
+    std::cout << channels << " channels, " << bands << " bands, period " << period_frames << " frames at " << rate << " Hz, "
+              << periods << " periods" << std::endl
+              << std::endl;
+
+    // Reference: one double precision section per band and channel, run band after band over each channel's block
+    std::vector<std::vector<BiquadT<double, BiquadTopology::DirectForm1>>> filters(channels, std::vector<BiquadT<double, BiquadTopology::DirectForm1>>(bands));
+    for (auto &channel_filters : filters)
+    {
+        for (unsigned int band = 0; band < bands; ++band)
+        {
+            channel_filters[band].set_coefficients(make_band(band, bands, rate));
+        }
+    }
+    std::vector<float> reference_output;
+    double reference_ns = 0.0;
+    for (unsigned int period = 0; period < periods; ++period)
+    {
+        fill_noise(buffers, period);
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int ch = 0; ch < channels; ++ch)
+        {
+            for (auto &filter : filters[ch])
+            {
+                filter.process(buffers[ch].data(), buffers[ch].data(), period_frames);
+            }
+        }
+        reference_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+    for (auto &buffer : buffers)
+    {
+        reference_output.insert(reference_output.end(), buffer.begin(), buffer.end());
+    }
+
+    std::cout << std::setw(14) << "kernel" << std::setw(16) << "ns/sample/band" << std::setw(10) << "speedup" << std::setw(14) << "max error" << std::endl;
+    std::cout << std::fixed << std::setw(14) << "double DF-I" << std::setw(16) << std::setprecision(3) << reference_ns / samples_per_band
+              << std::setw(10) << std::setprecision(2) << 1.0 << std::setw(14) << "-" << std::endl;
+
+    // BiquadBank with every supported kernel, fed the same audio
+    for (const BiquadBankKernels &kernels : get_supported_biquad_bank_kernels())
+    {
+        BiquadBank bank(channels, bands, 0, &kernels);
+        for (unsigned int ch = 0; ch < channels; ++ch)
+        {
+            for (unsigned int band = 0; band < bands; ++band)
+            {
+                bank.set_filter(ch, band, true, make_band(band, bands, rate));
+            }
+        }
+        double bank_ns = 0.0;
+        for (unsigned int period = 0; period < periods; ++period)
+        {
+            fill_noise(buffers, period);
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned int group = 0; group < bank.get_group_count(); ++group)
+            {
+                bank.process_group(group, channel_ptrs.data(), period_frames);
+            }
+            bank_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        }
+        double max_error = 0.0;
+        for (unsigned int ch = 0; ch < channels; ++ch)
+        {
+            for (unsigned int n = 0; n < period_frames; ++n)
+            {
+                max_error = std::max(max_error, std::fabs(static_cast<double>(buffers[ch][n]) - reference_output[ch * period_frames + n]));
+            }
+        }
+        std::cout << std::setw(14) << (std::string("bank ") + kernels.name) << std::setw(16) << std::setprecision(3) << bank_ns / samples_per_band
+                  << std::setw(10) << std::setprecision(2) << reference_ns / bank_ns << std::setw(14) << std::scientific << std::setprecision(1)
+                  << max_error << std::fixed << std::endl;
+    }
+
+    // BiquadBank while every band is swept, alternating between two tunings a sixth of an octave apart
+    std::vector<std::vector<BiquadCoefficients>> tunings(2);
+    for (unsigned int band = 0; band < bands; ++band)
+    {
+        tunings[0].push_back(make_band(band, bands, rate));
+        tunings[1].push_back(make_band(band, bands, rate, std::pow(2.0, 1.0 / 6.0)));
+    }
+    for (const BiquadBankKernels &kernels : get_supported_biquad_bank_kernels())
+    {
+        BiquadBank bank(channels, bands, static_cast<size_t>(smoothing_ms) * rate / 1000, &kernels);
+        double bank_ns = 0.0;
+        for (unsigned int period = 0; period < periods; ++period)
+        {
+            fill_noise(buffers, period);
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned int ch = 0; ch < channels; ++ch)
+            {
+                for (unsigned int band = 0; band < bands; ++band)
+                {
+                    bank.set_filter(ch, band, true, tunings[period % 2][band]);
+                }
+            }
+            for (unsigned int group = 0; group < bank.get_group_count(); ++group)
+            {
+                bank.process_group(group, channel_ptrs.data(), period_frames);
+            }
+            bank_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        }
+        std::cout << std::setw(14) << (std::string("sweep ") + kernels.name) << std::setw(16) << std::setprecision(3) << bank_ns / samples_per_band
+                  << std::setw(10) << std::setprecision(2) << reference_ns / bank_ns << std::setw(14) << "-" << std::endl;
+    }
+
+    return 0;
+}
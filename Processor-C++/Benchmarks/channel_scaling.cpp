@@ -0,0 +1,251 @@
+// channel_scaling.cpp
+// Benchmark of the per-period processing time against the channel count and the number of worker threads.
+// Runs the same signal path as AudioProcessor::process_block (16 enabled EQ bands, a 5 ms delay, gain and mute per channel, with the mixer
+// between the input and the output stage) on synthetic audio, without an audio device or a database.
+// For every worker count it prints the mean and the worst period time in microseconds for 2 to 128 channels in and out,
+// next to the period budget.
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include "../AudioEffects/equalizer.h"
+#include "../AudioEffects/biquad_bank.h"
+#include "../AudioEffects/gain.h"
+#include "../AudioEffects/mute.h"
+#include "../AudioEffects/mixer.h"
+#include "../AudioEffects/delay.h"
+#include "../Utilities/realtime.h"
+#include "../Utilities/worker_pool.h"
+
+// Channel strips and buffers of one benchmark run
+struct ChannelScalingPath
+{
+    size_t nframes = 0;
+    std::vector<std::vector<float>> input_buffers, output_buffers;
+    std::vector<float *> input_ptrs, output_ptrs;
+    std::vector<std::unique_ptr<Equalizer>> input_equalizers, output_equalizers;
+    std::vector<std::unique_ptr<Delay>> input_delays, output_delays;
+    std::unique_ptr<BiquadBank> input_equalizer_bank, output_equalizer_bank;
+    std::vector<std::unique_ptr<Gain>> input_volumes, output_volumes;
+    std::vector<std::unique_ptr<Mute>> input_mutes, output_mutes;
+    std::unique_ptr<Mixer> mixer;
+};
+
+// Function to run one group of channel strips through the equalizer bank in place, as AudioProcessor does
+void process_group(std::vector<std::unique_ptr<Equalizer>> &equalizers, BiquadBank &equalizer_bank, std::vector<float *> &channels, size_t group,
+                   size_t nframes)
+{
+    const size_t first = group * BIQUAD_BANK_LANES;
+    const size_t last = std::min(first + BIQUAD_BANK_LANES, channels.size());
+    for (size_t ch = first; ch < last; ++ch)
+    {
+        equalizers[ch]->update(equalizer_bank, ch);
+    }
+    equalizer_bank.process_group(group, channels.data(), nframes);
+}
+
+// Function to apply the rest of one channel strip in place, as AudioProcessor does
+void process_channel(std::vector<std::unique_ptr<Equalizer>> &equalizers, std::vector<std::unique_ptr<Delay>> &delays, std::vector<std::unique_ptr<Gain>> &volumes,
+                     std::vector<std::unique_ptr<Mute>> &mutes, std::vector<float *> &channels, size_t ch, size_t nframes)
+{
+    equalizers[ch]->process(&channels[ch], &channels[ch], nframes);
+    delays[ch]->process(&channels[ch], &channels[ch], nframes);
+    volumes[ch]->process(&channels[ch], &channels[ch], nframes);
+    mutes[ch]->process(&channels[ch], &channels[ch], nframes);
+}
+
+void process_input_group(void *context, size_t group)
+{
+    ChannelScalingPath *path = static_cast<ChannelScalingPath *>(context);
+    process_group(path->input_equalizers, *path->input_equalizer_bank, path->input_ptrs, group, path->nframes);
+}
+
+void process_input_channel(void *context, size_t ch)
+{
+    ChannelScalingPath *path = static_cast<ChannelScalingPath *>(context);
+    process_channel(path->input_equalizers, path->input_delays, path->input_volumes, path->input_mutes, path->input_ptrs, ch, path->nframes);
+}
+
+void process_output_group(void *context, size_t group)
+{
+    ChannelScalingPath *path = static_cast<ChannelScalingPath *>(context);
+    process_group(path->output_equalizers, *path->output_equalizer_bank, path->output_ptrs, group, path->nframes);
+}
+
+void process_output_channel(void *context, size_t ch)
+{
+    ChannelScalingPath *path = static_cast<ChannelScalingPath *>(context);
+    process_channel(path->output_equalizers, path->output_delays, path->output_volumes, path->output_mutes, path->output_ptrs, ch, path->nframes);
+}
+
+// Function to build the signal path for channels inputs and outputs with every EQ band enabled and input n routed to output n
+void build_path(ChannelScalingPath &path, unsigned int channels, size_t nframes, unsigned int rate)
+{
+    path.nframes = nframes;
+    path.input_buffers.assign(channels, std::vector<float>(nframes, 0.0f));
+    path.output_buffers.assign(channels, std::vector<float>(nframes, 0.0f));
+    for (unsigned int ch = 0; ch < channels; ++ch)
+    {
+        path.input_ptrs.push_back(path.input_buffers[ch].data());
+        path.output_ptrs.push_back(path.output_buffers[ch].data());
+        path.input_equalizers.emplace_back(std::make_unique<Equalizer>(rate, "input", ch + 1, convolution_partition_frames(nframes)));
+        path.output_equalizers.emplace_back(std::make_unique<Equalizer>(rate, "output", ch + 1, convolution_partition_frames(nframes)));
+        path.input_equalizers[ch]->allocate(nframes);
+        path.output_equalizers[ch]->allocate(nframes);
+        path.input_delays.emplace_back(std::make_unique<Delay>(rate, "input", ch + 1));
+        path.output_delays.emplace_back(std::make_unique<Delay>(rate, "output", ch + 1));
+        path.input_delays[ch]->allocate(nframes);
+        path.output_delays[ch]->allocate(nframes);
+        path.input_delays[ch]->set_delay("input", ch + 1, 5.0);
+        path.output_delays[ch]->set_delay("output", ch + 1, 5.0);
+        path.input_volumes.emplace_back(std::make_unique<Gain>("input", ch + 1));
+        path.output_volumes.emplace_back(std::make_unique<Gain>("output", ch + 1));
+        path.input_mutes.emplace_back(std::make_unique<Mute>("input", ch + 1));
+        path.output_mutes.emplace_back(std::make_unique<Mute>("output", ch + 1));
+        // 16 peaking bands spaced logarithmically from 20 Hz to 20 kHz, kept below Nyquist
+        for (unsigned int band = 0; band < 16; ++band)
+        {
+            double frequency = std::min(20.0 * std::pow(1000.0, band / 15.0), 0.45 * rate);
+            path.input_equalizers[ch]->set_filter("input", ch + 1, band + 1, true, FilterType::Peaking, frequency, 1.0, 3.0);
+            path.output_equalizers[ch]->set_filter("output", ch + 1, band + 1, true, FilterType::Peaking, frequency, 1.0, -3.0);
+        }
+    }
+    // Filter changes glide over the default 20 ms of AudioProcessor
+    path.input_equalizer_bank = std::make_unique<BiquadBank>(channels, Equalizer::MAX_FILTERS, 20 * rate / 1000);
+    path.output_equalizer_bank = std::make_unique<BiquadBank>(channels, Equalizer::MAX_FILTERS, 20 * rate / 1000);
+    path.mixer = std::make_unique<Mixer>(channels, channels);
+    for (unsigned int ch = 0; ch < channels; ++ch)
+    {
+        path.mixer->set_mixer(ch + 1, ch + 1, true);
+    }
+}
+
+// Function to run one period through the path: input stage, mixer as the join point, output stage
+void process_period(ChannelScalingPath &path, WorkerPool &worker_pool)
+{
+    worker_pool.run(path.input_equalizer_bank->get_group_count(), &process_input_group, &path);
+    worker_pool.run(path.input_ptrs.size(), &process_input_channel, &path);
+    path.mixer->process(path.input_ptrs.data(), path.output_ptrs.data(), path.nframes);
+    worker_pool.run(path.output_equalizer_bank->get_group_count(), &process_output_group, &path);
+    worker_pool.run(path.output_ptrs.size(), &process_output_channel, &path);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int period_frames = 128, rate = 48000, periods = 2000, priority = 0;
+    unsigned int max_workers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    std::string cpu_list;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        auto value = [&arg](const std::string &flag) { return arg.substr(flag.length()); };
+        if (arg.find("-period:") == 0)
+            std::istringstream(value("-period:")) >> period_frames;
+        else if (arg.find("-rate:") == 0)
+            std::istringstream(value("-rate:")) >> rate;
+        else if (arg.find("-periods:") == 0)
+            std::istringstream(value("-periods:")) >> periods;
+        else if (arg.find("-workers:") == 0)
+            std::istringstream(value("-workers:")) >> max_workers;
+        else if (arg.find("-priority:") == 0)
+            std::istringstream(value("-priority:")) >> priority;
+        else if (arg.find("-cpus:") == 0)
+            cpu_list = value("-cpus:");
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [-period:<frames>] [-rate:<sample_rate>] [-periods:<measured_periods>] [-workers:<max_worker_threads>]"
+                      << " [-priority:<rt_priority 0-99>] [-cpus:<cpu_list>]" << std::endl;
+            return 1;
+        }
+    }
+    if (period_frames == 0 || rate == 0 || periods == 0)
+    {
+        std::cerr << "Period size, rate and period count must be positive" << std::endl;
+        return 1;
+    }
+
+    // The calling thread stands in for the audio thread and gets the same settings as the workers
+    RealtimeConfig realtime_config;
+    realtime_config.priority = static_cast<int>(std::min(priority, 99u));
+    realtime_config.prefault_stack_size = 0;
+    if (!cpu_list.empty() && !parse_cpu_list(cpu_list, realtime_config.cpus))
+    {
+        std::cerr << "Invalid CPU list: " << cpu_list << std::endl;
+        return 1;
+    }
+    configure_realtime_thread(realtime_config, "Benchmark thread");
+
+    const std::vector<unsigned int> channel_counts = {2, 4, 8, 16, 32, 64, 128};
+    const double budget_us = period_frames * 1e6 / rate;
+    std::cout << "Using " << get_biquad_bank_kernels().name << " equalizer kernels, " << BIQUAD_BANK_LANES << " channels per task" << std::endl;
+    std::cout << "Period " << period_frames << " frames at " << rate << " Hz, budget " << std::fixed << std::setprecision(1) << budget_us
+              << " us, " << periods << " periods per measurement" << std::endl;
+
+    // Build every path up front, so the workers of each pool only see processing
+    std::vector<ChannelScalingPath> paths(channel_counts.size());
+    for (size_t i = 0; i < channel_counts.size(); ++i)
+    {
+        build_path(paths[i], channel_counts[i], period_frames, rate);
+    }
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+
+    // mean_us[workers][channel count index] and worst_us[workers][channel count index]
+    std::vector<std::vector<double>> mean_us(max_workers + 1), worst_us(max_workers + 1);
+    for (unsigned int workers = 0; workers <= max_workers; ++workers)
+    {
+        WorkerPool worker_pool(workers, realtime_config);
+        for (auto &path : paths)
+        {
+            double total_ns = 0.0, worst_ns = 0.0;
+            // The first periods drain the parameter queues and warm the caches, so they are not measured
+            for (unsigned int period = 0; period < periods + 16; ++period)
+            {
+                for (auto &buffer : path.input_buffers)
+                {
+                    std::generate(buffer.begin(), buffer.end(), [&]() { return noise(generator); });
+                }
+                auto start = std::chrono::steady_clock::now();
+                process_period(path, worker_pool);
+                double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                if (period >= 16)
+                {
+                    total_ns += elapsed_ns;
+                    worst_ns = std::max(worst_ns, elapsed_ns);
+                }
+            }
+            mean_us[workers].push_back(total_ns / periods / 1000.0);
+            worst_us[workers].push_back(worst_ns / 1000.0);
+        }
+    }
+
+    // Print one row per channel count and one mean/worst column pair per worker count
+    std::cout << std::endl << std::setw(8) << "channels";
+    for (unsigned int workers = 0; workers <= max_workers; ++workers)
+    {
+        std::cout << std::setw(20) << (std::to_string(workers) + " workers mean/max");
+    }
+    std::cout << std::endl;
+    for (size_t i = 0; i < channel_counts.size(); ++i)
+    {
+        std::cout << std::setw(8) << channel_counts[i];
+        for (unsigned int workers = 0; workers <= max_workers; ++workers)
+        {
+            std::ostringstream cell;
+            cell << std::fixed << std::setprecision(1) << mean_us[workers][i] << "/" << worst_us[workers][i]
+                 << (worst_us[workers][i] > budget_us ? "!" : "");
+            std::cout << std::setw(20) << cell.str();
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::endl << "Times in us per period; ! marks a worst case over the period budget" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+// convolution.cpp
+// Benchmark of the output convolution: the processing time per period against the impulse response length, for every
+// multiply-accumulate kernel this CPU supports. All channels run their own engine, on one thread, like one output group task.
+// Prints the mean and the worst period time in microseconds next to the period budget, and the largest deviation of the
+// first channel's output from a direct time-domain convolution.
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include "../AudioEffects/convolver.h"
+#include "../Utilities/realtime.h"
+
+// Function to build a room-like impulse response: a direct sound followed by exponentially decaying noise
+std::vector<float> make_impulse_response(size_t taps, unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::vector<float> impulse_response(taps);
+    for (size_t n = 0; n < taps; ++n)
+    {
+        impulse_response[n] = 0.05f * noise(generator) * std::exp(-6.9f * n / taps);
+    }
+    impulse_response[0] = 1.0f;
+    return impulse_response;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int channels = 8, period_frames = 128, rate = 48000, periods = 2000, max_taps = 65536;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        auto value = [&arg](const std::string &flag) { return arg.substr(flag.length()); };
+        if (arg.find("-channels:") == 0)
+            std::istringstream(value("-channels:")) >> channels;
+        else if (arg.find("-period:") == 0)
+            std::istringstream(value("-period:")) >> period_frames;
+        else if (arg.find("-rate:") == 0)
+            std::istringstream(value("-rate:")) >> rate;
+        else if (arg.find("-periods:") == 0)
+            std::istringstream(value("-periods:")) >> periods;
+        else if (arg.find("-taps:") == 0)
+            std::istringstream(value("-taps:")) >> max_taps;
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [-channels:<channels>] [-period:<frames>] [-rate:<sample_rate>] [-periods:<measured_periods>] [-taps:<max_taps>]" << std::endl;
+            return 1;
+        }
+    }
+    if (channels == 0 || period_frames == 0 || rate == 0 || periods == 0 || max_taps == 0 || max_taps > Convolver::MAX_TAPS)
+    {
+        std::cerr << "All arguments must be positive and the taps at most " << Convolver::MAX_TAPS << std::endl;
+        return 1;
+    }
+
+    // Flush denormals like the audio thread, so the decaying tails cost the same as the rest
+    set_denormals_flush(true);
+
+    const size_t partition_frames = convolution_partition_frames(period_frames);
+    const double budget_us = period_frames * 1e6 / rate;
+    std::cout << channels << " channels, period " << period_frames << " frames at " << rate << " Hz, budget " << std::fixed << std::setprecision(1)
+              << budget_us << " us, partitions of " << partition_frames << " frames"
+              << (period_frames % partition_frames == 0 ? "" : " (FIFO, " + std::to_string(partition_frames) + " frames latency)") << ", "
+              << periods << " periods per measurement" << std::endl
+              << std::endl;
+
+    std::vector<size_t> tap_counts;
+    for (size_t taps = 1024; taps < max_taps; taps *= 2)
+    {
+        tap_counts.push_back(taps);
+    }
+    tap_counts.push_back(max_taps);
+
+    std::vector<std::vector<float>> buffers(channels, std::vector<float>(period_frames));
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+    const size_t latency = period_frames % partition_frames == 0 ? 0 : partition_frames;
+
+    std::cout << std::setw(8) << "taps" << std::setw(12) << "kernel" << std::setw(12) << "mean us" << std::setw(12) << "worst us"
+              << std::setw(10) << "load %" << std::setw(14) << "max error" << std::endl;
+    for (size_t taps : tap_counts)
+    {
+        std::vector<std::vector<float>> impulse_responses;
+        for (unsigned int ch = 0; ch < channels; ++ch)
+        {
+            impulse_responses.push_back(make_impulse_response(taps, ch + 1));
+        }
+        for (const ConvolutionKernels &kernels : get_supported_convolution_kernels())
+        {
+            std::vector<std::unique_ptr<ConvolutionEngine>> engines;
+            for (unsigned int ch = 0; ch < channels; ++ch)
+            {
+                engines.emplace_back(std::make_unique<ConvolutionEngine>(impulse_responses[ch], partition_frames, &kernels));
+            }
+
+            // The first channel's input and output of the first periods are kept for the comparison with direct convolution
+            const size_t checked_frames = std::min<size_t>(4096, static_cast<size_t>(periods) * period_frames);
+            std::vector<float> checked_input, checked_output;
+            double total_ns = 0.0, worst_ns = 0.0;
+            for (unsigned int period = 0; period < periods; ++period)
+            {
+                for (auto &buffer : buffers)
+                {
+                    std::generate(buffer.begin(), buffer.end(), [&]() { return noise(generator); });
+                }
+                if (checked_input.size() < checked_frames)
+                {
+                    checked_input.insert(checked_input.end(), buffers[0].begin(), buffers[0].end());
+                }
+                auto start = std::chrono::steady_clock::now();
+                for (unsigned int ch = 0; ch < channels; ++ch)
+                {
+                    engines[ch]->process(buffers[ch].data(), buffers[ch].data(), period_frames);
+                }
+                double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                total_ns += elapsed_ns;
+                worst_ns = std::max(worst_ns, elapsed_ns);
+                if (checked_output.size() < checked_frames)
+                {
+                    checked_output.insert(checked_output.end(), buffers[0].begin(), buffers[0].end());
+                }
+            }
+
+            double max_error = 0.0;
+            for (size_t n = latency; n < std::min(checked_input.size(), checked_output.size()); ++n)
+            {
+                double expected = 0.0;
+                for (size_t k = 0; k < taps && k <= n - latency; ++k)
+                {
+                    expected += static_cast<double>(impulse_responses[0][k]) * checked_input[n - latency - k];
+                }
+                max_error = std::max(max_error, std::fabs(expected - checked_output[n]));
+            }
+
+            const double mean_us = total_ns / periods / 1000.0;
+            std::cout << std::setw(8) << taps << std::setw(12) << kernels.name << std::setw(12) << std::setprecision(1) << mean_us
+                      << std::setw(12) << worst_ns / 1000.0 << (worst_ns / 1000.0 > budget_us ? "!" : " ") << std::setw(9)
+                      << 100.0 * mean_us / budget_us << std::setw(14) << std::scientific << std::setprecision(1) << max_error << std::fixed << std::endl;
+        }
+    }
+    std::cout << std::endl << "! marks a worst case over the period budget" << std::endl;
+    set_denormals_flush(false);
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+// denormals.cpp
+// Benchmark of the equalizer filters in silence. Every filter variant gets a burst of noise followed by silence, during which
+// the feedback of low-frequency peaking bands decays towards zero and, unless denormals are flushed, through the denormal range.
+// For each variant it prints the time per sample per band during the burst and during the last second of silence, with
+// denormal flushing off and on. Without flushing the silence runs many times slower than the burst once the decay reaches
+// denormals; with flushing, as set on the audio thread, both take the same time.
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <cmath>
+#include "../AudioEffects/biquad_filter.h"
+#include "../AudioEffects/biquad_bank.h"
+#include "../Utilities/realtime.h"
+
+// Time per sample per band during the burst and during the end of the silence
+struct DenormalsResult
+{
+    double burst_ns;
+    double silence_ns;
+};
+
+// Function to build the coefficients of one band: peaking bands from 20 Hz to 200 Hz, whose poles sit closest to the unit circle
+BiquadCoefficients make_band(unsigned int band, unsigned int bands, unsigned int rate)
+{
+    double frequency = 20.0 * std::pow(10.0, bands > 1 ? band / (bands - 1.0) : 0.0);
+    return design_biquad(FilterType::Peaking, rate, frequency, 2.0, band % 2 ? 6.0 : -6.0);
+}
+
+// Function to run burst_seconds of noise and then silence_seconds of silence through process(channels, nframes), one period
+// at a time, and to time the burst and the last second of silence
+DenormalsResult run(const std::function<void(std::vector<float *> &, size_t)> &process, unsigned int channels, unsigned int bands,
+                    unsigned int period_frames, unsigned int rate, double burst_seconds, double silence_seconds)
+{
+    std::vector<std::vector<float>> buffers(channels, std::vector<float>(period_frames));
+    std::vector<float *> channel_ptrs;
+    for (auto &buffer : buffers)
+    {
+        channel_ptrs.push_back(buffer.data());
+    }
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+
+    const size_t burst_periods = static_cast<size_t>(burst_seconds * rate / period_frames);
+    const size_t silence_periods = static_cast<size_t>(silence_seconds * rate / period_frames);
+    const size_t measured_silence_periods = std::min<size_t>(silence_periods, rate / period_frames);
+    double burst_ns = 0.0, silence_ns = 0.0;
+    for (size_t period = 0; period < burst_periods + silence_periods; ++period)
+    {
+        const bool burst = period < burst_periods;
+        for (auto &buffer : buffers)
+        {
+            std::generate(buffer.begin(), buffer.end(), [&]() { return burst ? noise(generator) : 0.0f; });
+        }
+        auto start = std::chrono::steady_clock::now();
+        process(channel_ptrs, period_frames);
+        double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (burst)
+        {
+            burst_ns += elapsed_ns;
+        }
+        else if (period >= burst_periods + silence_periods - measured_silence_periods)
+        {
+            silence_ns += elapsed_ns;
+        }
+    }
+    const double samples_per_band = static_cast<double>(channels) * period_frames * bands;
+    return {burst_ns / (burst_periods * samples_per_band), silence_ns / (measured_silence_periods * samples_per_band)};
+}
+
+// Function to build a runner for one BiquadT variant: one section per band and channel
+template <typename Sample, BiquadTopology Topology>
+std::function<void(std::vector<float *> &, size_t)> make_biquad_runner(unsigned int channels, unsigned int bands, unsigned int rate)
+{
+    auto sections = std::make_shared<std::vector<BiquadT<Sample, Topology>>>(channels * bands);
+    for (unsigned int i = 0; i < sections->size(); ++i)
+    {
+        (*sections)[i].set_coefficients(make_band(i % bands, bands, rate));
+    }
+    return [sections, bands](std::vector<float *> &channels, size_t nframes)
+    {
+        for (size_t ch = 0; ch < channels.size(); ++ch)
+        {
+            for (unsigned int band = 0; band < bands; ++band)
+            {
+                (*sections)[ch * bands + band].process(channels[ch], channels[ch], nframes);
+            }
+        }
+    };
+}
+
+// Function to build a runner for the equalizer's BiquadBank
+std::function<void(std::vector<float *> &, size_t)> make_bank_runner(unsigned int channels, unsigned int bands, unsigned int rate)
+{
+    auto bank = std::make_shared<BiquadBank>(channels, bands);
+    for (unsigned int ch = 0; ch < channels; ++ch)
+    {
+        for (unsigned int band = 0; band < bands; ++band)
+        {
+            bank->set_filter(ch, band, true, make_band(band, bands, rate));
+        }
+    }
+    return [bank](std::vector<float *> &channels, size_t nframes)
+    {
+        for (unsigned int group = 0; group < bank->get_group_count(); ++group)
+        {
+            bank->process_group(group, channels.data(), nframes);
+        }
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int channels = 8, bands = 16, period_frames = 128, rate = 44100, silence_seconds = 30;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        auto value = [&arg](const std::string &flag) { return arg.substr(flag.length()); };
+        if (arg.find("-channels:") == 0)
+            std::istringstream(value("-channels:")) >> channels;
+        else if (arg.find("-bands:") == 0)
+            std::istringstream(value("-bands:")) >> bands;
+        else if (arg.find("-period:") == 0)
+            std::istringstream(value("-period:")) >> period_frames;
+        else if (arg.find("-rate:") == 0)
+            std::istringstream(value("-rate:")) >> rate;
+        else if (arg.find("-silence:") == 0)
+            std::istringstream(value("-silence:")) >> silence_seconds;
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [-channels:<channels>] [-bands:<bands>] [-period:<frames>] [-rate:<sample_rate>] [-silence:<seconds>]" << std::endl;
+            return 1;
+        }
+    }
+    if (channels == 0 || bands == 0 || period_frames == 0 || rate < period_frames || silence_seconds == 0)
+    {
+        std::cerr << "All arguments must be positive and the rate at least one period" << std::endl;
+        return 1;
+    }
+
+    // Double precision decays take far longer to reach denormals, so they only slow down with a long enough silence
+    std::cout << channels << " channels, " << bands << " bands from 20 Hz to 200 Hz, period " << period_frames << " frames at " << rate
+              << " Hz, 1 s burst, " << silence_seconds << " s silence" << std::endl
+              << std::endl;
+    std::cout << std::setw(18) << "variant" << std::setw(12) << "flush" << std::setw(12) << "burst" << std::setw(12) << "silence"
+              << std::setw(10) << "ratio" << "   (ns/sample/band)" << std::endl;
+
+    const std::vector<std::pair<std::string, std::function<std::function<void(std::vector<float *> &, size_t)>()>>> variants = {
+        {"float DF-I", [&]() { return make_biquad_runner<float, BiquadTopology::DirectForm1>(channels, bands, rate); }},
+        {"float TDF-II", [&]() { return make_biquad_runner<float, BiquadTopology::TransposedDirectForm2>(channels, bands, rate); }},
+        {"double DF-I", [&]() { return make_biquad_runner<double, BiquadTopology::DirectForm1>(channels, bands, rate); }},
+        {"double TDF-II", [&]() { return make_biquad_runner<double, BiquadTopology::TransposedDirectForm2>(channels, bands, rate); }},
+        {std::string("bank ") + get_biquad_bank_kernels().name, [&]() { return make_bank_runner(channels, bands, rate); }}};
+    for (const auto &variant : variants)
+    {
+        for (bool flush : {false, true})
+        {
+            if (!set_denormals_flush(flush) && flush)
+            {
+                std::cout << std::setw(18) << variant.first << std::setw(12) << "unsupported" << std::endl;
+                continue;
+            }
+            DenormalsResult result = run(variant.second(), channels, bands, period_frames, rate, 1.0, silence_seconds);
+            std::cout << std::fixed << std::setprecision(3) << std::setw(18) << variant.first << std::setw(12) << (flush ? "on" : "off")
+                      << std::setw(12) << result.burst_ns << std::setw(12) << result.silence_ns << std::setw(10) << std::setprecision(1)
+                      << result.silence_ns / result.burst_ns << std::endl;
+        }
+    }
+    set_denormals_flush(false);
+
+    return 0;
+}
@@ -0,0 +1,150 @@
+// mixer.cpp
+// Benchmark of the mixer: the processing time per period of dense and sparse routing against the matrix size and the share
+// of crosspoints that are on, with the tile kernel the CPU runs best. Each matrix gets at least one route per output,
+// the rest of the crosspoints are picked at random.
+// Prints the mean period time in microseconds of both routings next to the period budget, the routing automatic mode picks
+// and the largest difference between the outputs of the two.
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include "../AudioEffects/mixer.h"
+#include "../Utilities/realtime.h"
+
+// Function to turn on a share fill of the crosspoints of mixer, at random levels, and at least one input per output
+void set_routing(Mixer &mixer, unsigned int channels, double fill, unsigned int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> chance(0.0, 1.0), level(-24.0, 0.0);
+    for (unsigned int out_ch = 1; out_ch <= channels; ++out_ch)
+    {
+        for (unsigned int in_ch = 1; in_ch <= channels; ++in_ch)
+        {
+            if (in_ch == out_ch || chance(generator) < fill)
+            {
+                mixer.set_mixer_level(in_ch, out_ch, level(generator));
+            }
+        }
+    }
+}
+
+// Function to return the mean time per period in microseconds of mixing the inputs into the outputs
+double time_mixer(Mixer &mixer, const std::vector<const float *> &inputs, std::vector<float *> &outputs, size_t nframes, unsigned int periods)
+{
+    // Take the routing and warm the caches before measuring
+    mixer.process(inputs.data(), outputs.data(), nframes);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int period = 0; period < periods; ++period)
+    {
+        mixer.process(inputs.data(), outputs.data(), nframes);
+    }
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / periods;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int max_channels = 128, period_frames = 128, rate = 48000, periods = 2000;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        auto value = [&arg](const std::string &flag) { return arg.substr(flag.length()); };
+        if (arg.find("-channels:") == 0)
+            std::istringstream(value("-channels:")) >> max_channels;
+        else if (arg.find("-period:") == 0)
+            std::istringstream(value("-period:")) >> period_frames;
+        else if (arg.find("-rate:") == 0)
+            std::istringstream(value("-rate:")) >> rate;
+        else if (arg.find("-periods:") == 0)
+            std::istringstream(value("-periods:")) >> periods;
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [-channels:<max_channels>] [-period:<frames>] [-rate:<sample_rate>] [-periods:<measured_periods>]" << std::endl;
+            return 1;
+        }
+    }
+    if (max_channels == 0 || period_frames == 0 || rate == 0 || periods == 0)
+    {
+        std::cerr << "All arguments must be positive" << std::endl;
+        return 1;
+    }
+
+    set_denormals_flush(true);
+
+    const double budget_us = period_frames * 1e6 / rate;
+    std::cout << "Period " << period_frames << " frames at " << rate << " Hz, budget " << std::fixed << std::setprecision(1) << budget_us
+              << " us, " << periods << " periods per measurement, " << get_mixer_kernels().name << " kernel" << std::endl
+              << std::endl;
+
+    std::vector<unsigned int> channel_counts;
+    for (unsigned int channels = 8; channels < max_channels; channels *= 2)
+    {
+        channel_counts.push_back(channels);
+    }
+    channel_counts.push_back(max_channels);
+    const std::vector<double> fills = {0.0, 0.02, 0.05, 0.1, 0.25, 0.5, 1.0};
+
+    std::cout << std::setw(10) << "channels" << std::setw(8) << "fill %" << std::setw(10) << "routes" << std::setw(12) << "dense us"
+              << std::setw(12) << "sparse us" << std::setw(11) << "automatic" << std::setw(14) << "max diff" << std::endl;
+    for (unsigned int channels : channel_counts)
+    {
+        std::mt19937 generator(channels);
+        std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+        std::vector<std::vector<float>> input_buffers(channels, std::vector<float>(period_frames));
+        for (auto &buffer : input_buffers)
+        {
+            std::generate(buffer.begin(), buffer.end(), [&]() { return noise(generator); });
+        }
+        std::vector<std::vector<float>> dense_buffers(channels, std::vector<float>(period_frames)), sparse_buffers = dense_buffers;
+        std::vector<const float *> inputs;
+        std::vector<float *> dense_outputs, sparse_outputs;
+        for (unsigned int ch = 0; ch < channels; ++ch)
+        {
+            inputs.push_back(input_buffers[ch].data());
+            dense_outputs.push_back(dense_buffers[ch].data());
+            sparse_outputs.push_back(sparse_buffers[ch].data());
+        }
+
+        for (double fill : fills)
+        {
+            Mixer dense(channels, channels, 0, 0, nullptr, MixerRouting::Dense), sparse(channels, channels, 0, 0, nullptr, MixerRouting::Sparse),
+                automatic(channels, channels);
+            set_routing(dense, channels, fill, channels + 1);
+            set_routing(sparse, channels, fill, channels + 1);
+            set_routing(automatic, channels, fill, channels + 1);
+
+            unsigned int routes = 0;
+            for (unsigned int in_ch = 1; in_ch <= channels; ++in_ch)
+            {
+                for (unsigned int out_ch = 1; out_ch <= channels; ++out_ch)
+                {
+                    dense.get_mixer(in_ch, out_ch, [&routes](const std::string &, unsigned int, unsigned int, bool mix_bool) { routes += mix_bool; });
+                }
+            }
+
+            const double dense_us = time_mixer(dense, inputs, dense_outputs, period_frames, periods);
+            const double sparse_us = time_mixer(sparse, inputs, sparse_outputs, period_frames, periods);
+            double max_difference = 0.0;
+            for (unsigned int ch = 0; ch < channels; ++ch)
+            {
+                for (unsigned int n = 0; n < period_frames; ++n)
+                {
+                    max_difference = std::max(max_difference, static_cast<double>(std::fabs(dense_buffers[ch][n] - sparse_buffers[ch][n])));
+                }
+            }
+
+            std::cout << std::setw(10) << channels << std::setw(8) << std::setprecision(0) << 100.0 * fill << std::setw(10) << routes
+                      << std::setw(12) << std::setprecision(2) << dense_us << (dense_us > budget_us ? "!" : " ") << std::setw(11) << sparse_us
+                      << (sparse_us > budget_us ? "!" : " ") << std::setw(10) << (automatic.is_sparse() ? "sparse" : "dense") << std::setw(14)
+                      << std::scientific << std::setprecision(1) << max_difference << std::fixed << std::endl;
+        }
+    }
+    std::cout << std::endl << "! marks a mean over the period budget" << std::endl;
+    set_denormals_flush(false);
+
+    return 0;
+}
@@ -0,0 +1,245 @@
+// parameter_stress.cpp
+// Stress test of the parameter hand-over between the control threads and the audio thread.
+// Runs the input strips (16 enabled EQ bands, volume and mute per channel), the mixer and the output strips like
+// AudioProcessor::process_block on synthetic audio, first without and then with control threads that call set_gain, set_filter
+// and set_mixer_level on random channels as fast as they can, the way WebSocket and database threads do.
+// Prints the mean and the worst period time in microseconds of both runs next to the period budget, the periods over budget
+// and the number of parameter changes made while processing.
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include "../AudioEffects/equalizer.h"
+#include "../AudioEffects/biquad_bank.h"
+#include "../AudioEffects/gain.h"
+#include "../AudioEffects/mute.h"
+#include "../AudioEffects/mixer.h"
+#include "../Utilities/realtime.h"
+
+// Channel strips and buffers of the stress test
+struct ParameterStressPath
+{
+    size_t nframes = 0;
+    std::vector<std::vector<float>> input_buffers, output_buffers;
+    std::vector<float *> input_ptrs, output_ptrs;
+    std::vector<std::unique_ptr<Equalizer>> input_equalizers, output_equalizers;
+    std::unique_ptr<BiquadBank> input_equalizer_bank, output_equalizer_bank;
+    std::vector<std::unique_ptr<Gain>> input_volumes, output_volumes;
+    std::vector<std::unique_ptr<Mute>> input_mutes, output_mutes;
+    std::unique_ptr<Mixer> mixer;
+};
+
+// Function to build the signal path for channels inputs and outputs with every EQ band enabled and input n routed to output n.
+// Parameter changes ramp over the default smoothing times of AudioProcessor.
+void build_path(ParameterStressPath &path, unsigned int channels, size_t nframes, unsigned int rate)
+{
+    path.nframes = nframes;
+    path.input_buffers.assign(channels, std::vector<float>(nframes, 0.0f));
+    path.output_buffers.assign(channels, std::vector<float>(nframes, 0.0f));
+    for (unsigned int ch = 0; ch < channels; ++ch)
+    {
+        path.input_ptrs.push_back(path.input_buffers[ch].data());
+        path.output_ptrs.push_back(path.output_buffers[ch].data());
+        path.input_equalizers.emplace_back(std::make_unique<Equalizer>(rate, "input", ch + 1, convolution_partition_frames(nframes)));
+        path.output_equalizers.emplace_back(std::make_unique<Equalizer>(rate, "output", ch + 1, convolution_partition_frames(nframes)));
+        path.input_equalizers[ch]->allocate(nframes);
+        path.output_equalizers[ch]->allocate(nframes);
+        path.input_volumes.emplace_back(std::make_unique<Gain>("input", ch + 1, 10 * rate / 1000));
+        path.output_volumes.emplace_back(std::make_unique<Gain>("output", ch + 1, 10 * rate / 1000));
+        path.input_mutes.emplace_back(std::make_unique<Mute>("input", ch + 1));
+        path.output_mutes.emplace_back(std::make_unique<Mute>("output", ch + 1));
+        // 16 peaking bands spaced logarithmically from 20 Hz to 20 kHz, kept below Nyquist
+        for (unsigned int band = 0; band < 16; ++band)
+        {
+            double frequency = std::min(20.0 * std::pow(1000.0, band / 15.0), 0.45 * rate);
+            path.input_equalizers[ch]->set_filter("input", ch + 1, band + 1, true, FilterType::Peaking, frequency, 1.0, 3.0);
+            path.output_equalizers[ch]->set_filter("output", ch + 1, band + 1, true, FilterType::Peaking, frequency, 1.0, -3.0);
+        }
+    }
+    path.input_equalizer_bank = std::make_unique<BiquadBank>(channels, Equalizer::MAX_FILTERS, 20 * rate / 1000);
+    path.output_equalizer_bank = std::make_unique<BiquadBank>(channels, Equalizer::MAX_FILTERS, 20 * rate / 1000);
+    path.mixer = std::make_unique<Mixer>(channels, channels, 0, 10 * rate / 1000);
+    for (unsigned int ch = 0; ch < channels; ++ch)
+    {
+        path.mixer->set_mixer(ch + 1, ch + 1, true);
+    }
+}
+
+// Function to run the strips of one stage in place: the equalizer bank per group, then the rest of every channel strip
+void process_stage(std::vector<std::unique_ptr<Equalizer>> &equalizers, BiquadBank &equalizer_bank, std::vector<std::unique_ptr<Gain>> &volumes,
+                   std::vector<std::unique_ptr<Mute>> &mutes, std::vector<float *> &channels, size_t nframes)
+{
+    for (size_t ch = 0; ch < channels.size(); ++ch)
+    {
+        equalizers[ch]->update(equalizer_bank, ch);
+    }
+    for (size_t group = 0; group < equalizer_bank.get_group_count(); ++group)
+    {
+        equalizer_bank.process_group(group, channels.data(), nframes);
+    }
+    for (size_t ch = 0; ch < channels.size(); ++ch)
+    {
+        equalizers[ch]->process(&channels[ch], &channels[ch], nframes);
+        volumes[ch]->process(&channels[ch], &channels[ch], nframes);
+        mutes[ch]->process(&channels[ch], &channels[ch], nframes);
+    }
+}
+
+// Function to run one period through the path: input stage, mixer, output stage
+void process_period(ParameterStressPath &path)
+{
+    process_stage(path.input_equalizers, *path.input_equalizer_bank, path.input_volumes, path.input_mutes, path.input_ptrs, path.nframes);
+    path.mixer->process(path.input_ptrs.data(), path.output_ptrs.data(), path.nframes);
+    process_stage(path.output_equalizers, *path.output_equalizer_bank, path.output_volumes, path.output_mutes, path.output_ptrs, path.nframes);
+}
+
+// Function to change one random parameter of the kind selected by thread_index
+void change_parameter(ParameterStressPath &path, unsigned int thread_index, std::mt19937 &generator)
+{
+    const unsigned int channels = static_cast<unsigned int>(path.input_ptrs.size());
+    std::uniform_int_distribution<unsigned int> channel(1, channels), band(1, 16);
+    std::uniform_real_distribution<double> gain_db(-24.0, 6.0), frequency(20.0, 16000.0);
+    switch (thread_index % 3)
+    {
+    case 0:
+    {
+        const unsigned int ch = channel(generator);
+        path.input_volumes[ch - 1]->set_gain("input", ch, gain_db(generator));
+        path.output_volumes[ch - 1]->set_gain("output", ch, gain_db(generator));
+        break;
+    }
+    case 1:
+    {
+        const unsigned int ch = channel(generator);
+        path.input_equalizers[ch - 1]->set_filter("input", ch, band(generator), true, FilterType::Peaking, frequency(generator), 1.0, gain_db(generator));
+        break;
+    }
+    default:
+        path.mixer->set_mixer_level(channel(generator), channel(generator), gain_db(generator));
+        break;
+    }
+}
+
+// Function to time periods periods of the path, after 16 unmeasured ones. Returns the mean and the worst period time in
+// microseconds and the number of periods over budget_us.
+void time_periods(ParameterStressPath &path, unsigned int periods, double budget_us, double &mean_us, double &worst_us, unsigned int &overruns)
+{
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+    double total_ns = 0.0, worst_ns = 0.0;
+    overruns = 0;
+    for (unsigned int period = 0; period < periods + 16; ++period)
+    {
+        for (auto &buffer : path.input_buffers)
+        {
+            std::generate(buffer.begin(), buffer.end(), [&]() { return noise(generator); });
+        }
+        auto start = std::chrono::steady_clock::now();
+        process_period(path);
+        double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        if (period >= 16)
+        {
+            total_ns += elapsed_ns;
+            worst_ns = std::max(worst_ns, elapsed_ns);
+            overruns += elapsed_ns / 1000.0 > budget_us ? 1 : 0;
+        }
+    }
+    mean_us = total_ns / periods / 1000.0;
+    worst_us = worst_ns / 1000.0;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int channels = 16, period_frames = 128, rate = 48000, periods = 20000, control_threads = 3, priority = 0;
+    std::string cpu_list;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        auto value = [&arg](const std::string &flag) { return arg.substr(flag.length()); };
+        if (arg.find("-channels:") == 0)
+            std::istringstream(value("-channels:")) >> channels;
+        else if (arg.find("-period:") == 0)
+            std::istringstream(value("-period:")) >> period_frames;
+        else if (arg.find("-rate:") == 0)
+            std::istringstream(value("-rate:")) >> rate;
+        else if (arg.find("-periods:") == 0)
+            std::istringstream(value("-periods:")) >> periods;
+        else if (arg.find("-threads:") == 0)
+            std::istringstream(value("-threads:")) >> control_threads;
+        else if (arg.find("-priority:") == 0)
+            std::istringstream(value("-priority:")) >> priority;
+        else if (arg.find("-cpus:") == 0)
+            cpu_list = value("-cpus:");
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [-channels:<channels>] [-period:<frames>] [-rate:<sample_rate>] [-periods:<measured_periods>]"
+                      << " [-threads:<control_threads>] [-priority:<rt_priority 0-99>] [-cpus:<cpu_list>]" << std::endl;
+            return 1;
+        }
+    }
+    if (channels == 0 || period_frames == 0 || rate == 0 || periods == 0)
+    {
+        std::cerr << "Channel count, period size, rate and period count must be positive" << std::endl;
+        return 1;
+    }
+
+    // The calling thread stands in for the audio thread; the control threads keep the default scheduling
+    RealtimeConfig realtime_config;
+    realtime_config.priority = static_cast<int>(std::min(priority, 99u));
+    realtime_config.prefault_stack_size = 0;
+    if (!cpu_list.empty() && !parse_cpu_list(cpu_list, realtime_config.cpus))
+    {
+        std::cerr << "Invalid CPU list: " << cpu_list << std::endl;
+        return 1;
+    }
+
+    ParameterStressPath path;
+    build_path(path, channels, period_frames, rate);
+    configure_realtime_thread(realtime_config, "Benchmark thread");
+
+    const double budget_us = period_frames * 1e6 / rate;
+    std::cout << "Using " << get_biquad_bank_kernels().name << " equalizer kernels, " << channels << " channels in and out" << std::endl;
+    std::cout << "Period " << period_frames << " frames at " << rate << " Hz, budget " << std::fixed << std::setprecision(1) << budget_us
+              << " us, " << periods << " periods per measurement" << std::endl;
+
+    double quiet_mean_us, quiet_worst_us, stress_mean_us, stress_worst_us;
+    unsigned int quiet_overruns, stress_overruns;
+    time_periods(path, periods, budget_us, quiet_mean_us, quiet_worst_us, quiet_overruns);
+
+    // Control threads hammer the parameters until the measurement is done
+    std::atomic<bool> stop_requested{false};
+    std::atomic<unsigned long> changes{0};
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < control_threads; ++t)
+    {
+        threads.emplace_back([&path, &stop_requested, &changes, t]()
+                             {
+            std::mt19937 generator(t + 2);
+            while (!stop_requested.load(std::memory_order_relaxed))
+            {
+                change_parameter(path, t, generator);
+                changes.fetch_add(1, std::memory_order_relaxed);
+            } });
+    }
+    time_periods(path, periods, budget_us, stress_mean_us, stress_worst_us, stress_overruns);
+    stop_requested = true;
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    std::cout << std::endl << std::setw(26) << "" << std::setw(12) << "mean us" << std::setw(12) << "worst us" << std::setw(16) << "over budget" << std::endl;
+    std::cout << std::setw(26) << "no parameter changes" << std::setw(12) << quiet_mean_us << std::setw(12) << quiet_worst_us << std::setw(16) << quiet_overruns << std::endl;
+    std::cout << std::setw(26) << (std::to_string(control_threads) + " control threads") << std::setw(12) << stress_mean_us << std::setw(12) << stress_worst_us
+              << std::setw(16) << stress_overruns << std::endl;
+    std::cout << std::endl << changes.load() << " parameter changes during " << periods + 16 << " periods" << std::endl;
+    return 0;
+}
@@ -0,0 +1,20 @@
+// cpu_dispatch.h
+// Runtime choice between the SIMD variants of a kernel. Every vectorized element lists the kernels the CPU can run, narrowest
+// first, in a get_supported_*_kernels() function; select_widest_kernels() takes the last entry of that list the first time it
+// is asked and returns the same kernels from then on, so the audio thread never probes the CPU.
+
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+#include <vector>
+
+// Function to return the widest kernels listed by ListSupported. The list is built once, on the first call, and the choice is
+// kept in a static of its own for every list function.
+template <typename Kernels, std::vector<Kernels> (*ListSupported)()>
+const Kernels &select_widest_kernels()
+{
+    static const Kernels kernels = ListSupported().back();
+    return kernels;
+}
+
+#endif // CPU_DISPATCH_H
@@ -10,6 +10,12 @@
 #include "json.hpp"
 #include "event_manager.h"
 #include "type_aliases.h"
+#include "device_stats.h"
+#include "../AudioEffects/biquad_filter.h"
+#include "../AudioEffects/crossover.h"
+#include "../AudioEffects/convolver.h"
+#include "../AudioEffects/equalizer.h"
+#include "../AudioEffects/mixer.h"
 
 using json = nlohmann::json;
 
@@ -29,11 +35,22 @@ private:
     // Response command functions
     void broadcastFailedResponse(const std::string &error_type, const std::string &error_message);
     void broadcastGainResponse(const std::string &command_type, const std::string &channel_type, unsigned int channel_number, double gain_db);
+    void broadcastDelayResponse(const std::string &command_type, const std::string &channel_type, unsigned int channel_number, double delay_ms);
     void broadcastMuteResponse(const std::string &command_type, const std::string &channel_type, unsigned int channel_number, bool mute);
     void broadcastMixerResponse(const std::string &command_type, unsigned int input_channel, unsigned int output_channel, bool route);
+    void broadcastMixerLevelResponse(const std::string &command_type, unsigned int input_channel, unsigned int output_channel, double level_db);
+    void broadcastMixerSnapshotResponse(const std::string &command_type, const std::vector<MixerCrosspoint> &crosspoints);
+    void broadcastBusRouteResponse(const std::string &command_type, const std::string &source_type, unsigned int source_number,
+                                   const std::string &destination_type, unsigned int destination_number, double level_db);
     void broadcastFilterResponse(const std::string &command_type, const std::string &channel_type, unsigned int channel_number, unsigned int filter_id,
                                  bool filter_enabled, std::string filter_type, double center_frequency, double q_factor, double gain_db);
+    void broadcastCrossoverResponse(const std::string &command_type, unsigned int crossover_id, const CrossoverSettings &settings);
+    void broadcastConvolutionResponse(const std::string &command_type, const std::string &channel_type, unsigned int channel_number, const ConvolutionSettings &settings);
+    void broadcastEqResponse(const std::string &command_type, const std::string &channel_type, unsigned int channel_number, const FrequencyResponse &response);
+    void broadcastEqualizerModeResponse(const std::string &command_type, const std::string &channel_type, unsigned int channel_number, EqualizerMode mode,
+                                        double latency_ms, double processing_us);
     void broadcastSignalAmplitudes(const std::string &command_type, const std::string &channel_type, const std::vector<double> &amplitudes_db);
+    void broadcastDeviceStats(const std::string &command_type, const DeviceStatsReport &report);
 };
 
 CustomWebSocketServer::CustomWebSocketServer(int port)
@@ -115,17 +132,62 @@ void CustomWebSocketServer::onMessageReceived(std::shared_ptr<ix::WebSocket> web
                     { this->broadcastMixerResponse(command_type, input_channel, output_channel, route); });
                 return;
             }
+            else if (command_type == "set_mixer_level")
+            {
+                EventManager::getInstance().emitEvent<unsigned int, unsigned int, double, SetMixerLevelCallbackType>(
+                    commandJson.at("command_type").get<std::string>(), commandJson.at("input_channel").get<unsigned int>(),
+                    commandJson.at("output_channel").get<unsigned int>(), commandJson.at("level_db").get<double>(),
+                    [this](const std::string &command_type, unsigned int input_channel, unsigned int output_channel, double level_db)
+                    { this->broadcastMixerLevelResponse(command_type, input_channel, output_channel, level_db); });
+                return;
+            }
+            else if (command_type == "set_mixer_snapshot")
+            {
+                std::vector<MixerCrosspoint> crosspoints;
+                for (const json &crosspoint : commandJson.at("crosspoints"))
+                {
+                    crosspoints.push_back({crosspoint.at("input_channel").get<unsigned int>(), crosspoint.at("output_channel").get<unsigned int>(),
+                                           crosspoint.at("level_db").get<double>()});
+                }
+                EventManager::getInstance().emitEvent<const std::vector<MixerCrosspoint> &, SetMixerSnapshotCallbackType>(
+                    commandJson.at("command_type").get<std::string>(), crosspoints,
+                    [this](const std::string &command_type, const std::vector<MixerCrosspoint> &crosspoints)
+                    { this->broadcastMixerSnapshotResponse(command_type, crosspoints); });
+                return;
+            }
+            else if (command_type == "set_bus_route")
+            {
+                EventManager::getInstance().emitEvent<const std::string &, unsigned int, const std::string &, unsigned int, double, SetBusRouteCallbackType>(
+                    commandJson.at("command_type").get<std::string>(), commandJson.at("source_type").get<std::string>(),
+                    commandJson.at("source_number").get<unsigned int>(), commandJson.at("destination_type").get<std::string>(),
+                    commandJson.at("destination_number").get<unsigned int>(), commandJson.at("level_db").get<double>(),
+                    [this](const std::string &command_type, const std::string &source_type, unsigned int source_number, const std::string &destination_type,
+                           unsigned int destination_number, double level_db)
+                    { this->broadcastBusRouteResponse(command_type, source_type, source_number, destination_type, destination_number, level_db); });
+                return;
+            }
             else if (command_type == "set_filter")
             {
-                EventManager::getInstance().emitEvent<const std::string &, unsigned int, unsigned int, bool, std::string, double, double, double, SetFilterCallbackType>(
+                // The filter type is parsed here, once; an unknown type never reaches the equalizers or the database
+                const std::string filter_type_str = commandJson.at("filter_type").get<std::string>();
+                FilterType filter_type;
+                if (!parse_filter_type(filter_type_str, filter_type))
+                {
+                    broadcastFilterResponse("set_filter_failed", commandJson.at("channel_type").get<std::string>(),
+                                            commandJson.at("channel_number").get<unsigned int>(), commandJson.at("filter_id").get<unsigned int>(),
+                                            commandJson.at("filter_enabled").get<bool>(), filter_type_str, commandJson.at("center_frequency").get<double>(),
+                                            commandJson.at("q_factor").get<double>(), commandJson.at("gain_db").get<double>());
+                    return;
+                }
+                EventManager::getInstance().emitEvent<const std::string &, unsigned int, unsigned int, bool, FilterType, double, double, double, SetFilterCallbackType>(
                     commandJson.at("command_type").get<std::string>(), commandJson.at("channel_type").get<std::string>(),
                     commandJson.at("channel_number").get<unsigned int>(), commandJson.at("filter_id").get<unsigned int>(),
-                    commandJson.at("filter_enabled").get<bool>(), commandJson.at("filter_type").get<std::string>(),
+                    commandJson.at("filter_enabled").get<bool>(), filter_type,
                     commandJson.at("center_frequency").get<double>(), commandJson.at("q_factor").get<double>(),
                     commandJson.at("gain_db").get<double>(),
                     [this](const std::string &command_type, const std::string &channel_type, unsigned int channel_number, unsigned int filter_id,
-                           bool filter_enabled, std::string filter_type, double center_frequency, double q_factor, double gain_db)
-                    { this->broadcastFilterResponse(command_type, channel_type, channel_number, filter_id, filter_enabled, filter_type, center_frequency, q_factor, gain_db); });
+                           bool filter_enabled, FilterType filter_type, double center_frequency, double q_factor, double gain_db)
+                    { this->broadcastFilterResponse(command_type, channel_type, channel_number, filter_id, filter_enabled, filter_type_name(filter_type), center_frequency, q_factor, gain_db); });
                 return;
             }
             else if (command_type == "get_gain")
@@ -137,6 +199,24 @@ void CustomWebSocketServer::onMessageReceived(std::shared_ptr<ix::WebSocket> web
                     { this->broadcastGainResponse(command_type, channel_type, channel_number, gain_db); });
                 return;
             }
+            else if (command_type == "set_delay")
+            {
+                EventManager::getInstance().emitEvent<const std::string &, unsigned int, double, SetDelayCallbackType>(
+                    commandJson.at("command_type").get<std::string>(), commandJson.at("channel_type").get<std::string>(),
+                    commandJson.at("channel_number").get<unsigned int>(), commandJson.at("delay_ms").get<double>(),
+                    [this](const std::string &command_type, const std::string &channel_type, unsigned int channel_number, double delay_ms)
+                    { this->broadcastDelayResponse(command_type, channel_type, channel_number, delay_ms); });
+                return;
+            }
+            else if (command_type == "get_delay")
+            {
+                EventManager::getInstance().emitEvent<const std::string &, unsigned int, SetDelayCallbackType>(
+                    commandJson.at("command_type").get<std::string>(), commandJson.at("channel_type").get<std::string>(),
+                    commandJson.at("channel_number").get<unsigned int>(),
+                    [this](const std::string &command_type, const std::string &channel_type, unsigned int channel_number, double delay_ms)
+                    { this->broadcastDelayResponse(command_type, channel_type, channel_number, delay_ms); });
+                return;
+            }
             else if (command_type == "get_mute")
             {
                 EventManager::getInstance().emitEvent<const std::string &, unsigned int, SetMuteCallbackType>(
@@ -155,14 +235,123 @@ void CustomWebSocketServer::onMessageReceived(std::shared_ptr<ix::WebSocket> web
                     { this->broadcastMixerResponse(command_type, input_channel, output_channel, mix); });
                 return;
             }
+            else if (command_type == "get_mixer_level")
+            {
+                EventManager::getInstance().emitEvent<unsigned int, unsigned int, SetMixerLevelCallbackType>(
+                    commandJson.at("command_type").get<std::string>(), commandJson.at("input_channel").get<unsigned int>(),
+                    commandJson.at("output_channel").get<unsigned int>(),
+                    [this](const std::string &command_type, unsigned int input_channel, unsigned int output_channel, double level_db)
+                    { this->broadcastMixerLevelResponse(command_type, input_channel, output_channel, level_db); });
+                return;
+            }
+            else if (command_type == "get_bus_route")
+            {
+                EventManager::getInstance().emitEvent<const std::string &, unsigned int, const std::string &, unsigned int, SetBusRouteCallbackType>(
+                    commandJson.at("command_type").get<std::string>(), commandJson.at("source_type").get<std::string>(),
+                    commandJson.at("source_number").get<unsigned int>(), commandJson.at("destination_type").get<std::string>(),
+                    commandJson.at("destination_number").get<unsigned int>(),
+                    [this](const std::string &command_type, const std::string &source_type, unsigned int source_number, const std::string &destination_type,
+                           unsigned int destination_number, double level_db)
+                    { this->broadcastBusRouteResponse(command_type, source_type, source_number, destination_type, destination_number, level_db); });
+                return;
+            }
             else if (command_type == "get_filter")
             {
                 EventManager::getInstance().emitEvent<const std::string &, unsigned int, unsigned int, SetFilterCallbackType>(
                     commandJson.at("command_type").get<std::string>(), commandJson.at("channel_type").get<std::string>(),
                     commandJson.at("channel_number").get<unsigned int>(), commandJson.at("filter_id").get<unsigned int>(),
                     [this](const std::string &command_type, const std::string &channel_type, unsigned int channel_number, unsigned int filter_id,
-                           bool filter_enabled, std::string filter_type, double center_frequency, double q_factor, double gain_db)
-                    { this->broadcastFilterResponse(command_type, channel_type, channel_number, filter_id, filter_enabled, filter_type, center_frequency, q_factor, gain_db); });
+                           bool filter_enabled, FilterType filter_type, double center_frequency, double q_factor, double gain_db)
+                    { this->broadcastFilterResponse(command_type, channel_type, channel_number, filter_id, filter_enabled, filter_type_name(filter_type), center_frequency, q_factor, gain_db); });
+                return;
+            }
+            else if (command_type == "set_crossover")
+            {
+                // The crossover type is parsed here, once. A command with an unknown type is echoed back as failed.
+                CrossoverSettings settings;
+                if (!parse_crossover_type(commandJson.at("crossover_type").get<std::string>(), settings.crossover_type))
+                {
+                    json responseJson = commandJson;
+                    responseJson["command_type"] = "set_crossover_failed";
+                    broadcastMessage(responseJson.dump());
+                    return;
+                }
+                settings.is_enabled = commandJson.at("crossover_enabled").get<bool>();
+                settings.source_output = commandJson.at("source_output").get<unsigned int>();
+                settings.frequencies = commandJson.at("frequencies").get<std::vector<double>>();
+                settings.outputs = commandJson.at("outputs").get<std::vector<unsigned int>>();
+                settings.delays_ms = commandJson.at("delays_ms").get<std::vector<double>>();
+                settings.gains_db = commandJson.at("gains_db").get<std::vector<double>>();
+                EventManager::getInstance().emitEvent<unsigned int, const CrossoverSettings &, SetCrossoverCallbackType>(
+                    commandJson.at("command_type").get<std::string>(), commandJson.at("crossover_id").get<unsigned int>(), settings,
+                    [this](const std::string &command_type, unsigned int crossover_id, const CrossoverSettings &settings)
+                    { this->broadcastCrossoverResponse(command_type, crossover_id, settings); });
+                return;
+            }
+            else if (command_type == "get_crossover")
+            {
+                EventManager::getInstance().emitEvent<unsigned int, SetCrossoverCallbackType>(
+                    commandJson.at("command_type").get<std::string>(), commandJson.at("crossover_id").get<unsigned int>(),
+                    [this](const std::string &command_type, unsigned int crossover_id, const CrossoverSettings &settings)
+                    { this->broadcastCrossoverResponse(command_type, crossover_id, settings); });
+                return;
+            }
+            else if (command_type == "set_convolution")
+            {
+                ConvolutionSettings settings;
+                settings.is_enabled = commandJson.at("convolution_enabled").get<bool>();
+                settings.file = commandJson.at("file").get<std::string>();
+                settings.file_channel = commandJson.at("file_channel").get<unsigned int>();
+                EventManager::getInstance().emitEvent<const std::string &, unsigned int, const ConvolutionSettings &, SetConvolutionCallbackType>(
+                    commandJson.at("command_type").get<std::string>(), commandJson.at("channel_type").get<std::string>(),
+                    commandJson.at("channel_number").get<unsigned int>(), settings,
+                    [this](const std::string &command_type, const std::string &channel_type, unsigned int channel_number, const ConvolutionSettings &settings)
+                    { this->broadcastConvolutionResponse(command_type, channel_type, channel_number, settings); });
+                return;
+            }
+            else if (command_type == "get_convolution")
+            {
+                EventManager::getInstance().emitEvent<const std::string &, unsigned int, SetConvolutionCallbackType>(
+                    commandJson.at("command_type").get<std::string>(), commandJson.at("channel_type").get<std::string>(),
+                    commandJson.at("channel_number").get<unsigned int>(),
+                    [this](const std::string &command_type, const std::string &channel_type, unsigned int channel_number, const ConvolutionSettings &settings)
+                    { this->broadcastConvolutionResponse(command_type, channel_type, channel_number, settings); });
+                return;
+            }
+            else if (command_type == "get_eq_response")
+            {
+                EventManager::getInstance().emitEvent<const std::string &, unsigned int, unsigned int, GetEqResponseCallbackType>(
+                    commandJson.at("command_type").get<std::string>(), commandJson.at("channel_type").get<std::string>(),
+                    commandJson.at("channel_number").get<unsigned int>(), commandJson.at("points").get<unsigned int>(),
+                    [this](const std::string &command_type, const std::string &channel_type, unsigned int channel_number, const FrequencyResponse &response)
+                    { this->broadcastEqResponse(command_type, channel_type, channel_number, response); });
+                return;
+            }
+            else if (command_type == "set_equalizer_mode")
+            {
+                // A command with an unknown mode is echoed back as failed
+                EqualizerMode mode;
+                if (!parse_equalizer_mode(commandJson.at("equalizer_mode").get<std::string>(), mode))
+                {
+                    json responseJson = commandJson;
+                    responseJson["command_type"] = "set_equalizer_mode_failed";
+                    broadcastMessage(responseJson.dump());
+                    return;
+                }
+                EventManager::getInstance().emitEvent<const std::string &, unsigned int, EqualizerMode, SetEqualizerModeCallbackType>(
+                    commandJson.at("command_type").get<std::string>(), commandJson.at("channel_type").get<std::string>(),
+                    commandJson.at("channel_number").get<unsigned int>(), mode,
+                    [this](const std::string &command_type, const std::string &channel_type, unsigned int channel_number, EqualizerMode mode, double latency_ms, double processing_us)
+                    { this->broadcastEqualizerModeResponse(command_type, channel_type, channel_number, mode, latency_ms, processing_us); });
+                return;
+            }
+            else if (command_type == "get_equalizer_mode")
+            {
+                EventManager::getInstance().emitEvent<const std::string &, unsigned int, SetEqualizerModeCallbackType>(
+                    commandJson.at("command_type").get<std::string>(), commandJson.at("channel_type").get<std::string>(),
+                    commandJson.at("channel_number").get<unsigned int>(),
+                    [this](const std::string &command_type, const std::string &channel_type, unsigned int channel_number, EqualizerMode mode, double latency_ms, double processing_us)
+                    { this->broadcastEqualizerModeResponse(command_type, channel_type, channel_number, mode, latency_ms, processing_us); });
                 return;
             }
             else if (command_type == "get_meter")
@@ -174,6 +363,14 @@ void CustomWebSocketServer::onMessageReceived(std::shared_ptr<ix::WebSocket> web
 
                 return;
             }
+            else if (command_type == "get_device_stats")
+            {
+                EventManager::getInstance().emitEvent<GetDeviceStatsCallbackType>(
+                    commandJson.at("command_type").get<std::string>(),
+                    [this](const std::string &command_type, const DeviceStatsReport &report)
+                    { this->broadcastDeviceStats(command_type, report); });
+                return;
+            }
             else
             {
                 broadcastFailedResponse(std::string("unknown_command"), std::string("fail"));
@@ -226,6 +423,16 @@ void CustomWebSocketServer::broadcastGainResponse(const std::string &command_typ
     broadcastMessage(responseJson.dump());
 }
 
+void CustomWebSocketServer::broadcastDelayResponse(const std::string &command_type, const std::string &channel_type, unsigned int channel_number, double delay_ms)
+{
+    json responseJson;
+    responseJson["command_type"] = command_type;
+    responseJson["channel_type"] = channel_type;
+    responseJson["channel_number"] = channel_number;
+    responseJson["delay_ms"] = delay_ms;
+    broadcastMessage(responseJson.dump());
+}
+
 void CustomWebSocketServer::broadcastMuteResponse(const std::string &command_type, const std::string &channel_type, unsigned int channel_number, bool mute)
 {
     json responseJson;
@@ -246,6 +453,41 @@ void CustomWebSocketServer::broadcastMixerResponse(const std::string &command_ty
     broadcastMessage(responseJson.dump());
 }
 
+void CustomWebSocketServer::broadcastMixerLevelResponse(const std::string &command_type, unsigned int input_channel, unsigned int output_channel, double level_db)
+{
+    json responseJson;
+    responseJson["command_type"] = command_type;
+    responseJson["input_channel"] = input_channel;
+    responseJson["output_channel"] = output_channel;
+    responseJson["level_db"] = level_db;
+    broadcastMessage(responseJson.dump());
+}
+
+void CustomWebSocketServer::broadcastMixerSnapshotResponse(const std::string &command_type, const std::vector<MixerCrosspoint> &crosspoints)
+{
+    json responseJson;
+    responseJson["command_type"] = command_type;
+    responseJson["crosspoints"] = json::array();
+    for (const MixerCrosspoint &crosspoint : crosspoints)
+    {
+        responseJson["crosspoints"].push_back({{"input_channel", crosspoint.input_channel}, {"output_channel", crosspoint.output_channel}, {"level_db", crosspoint.level_db}});
+    }
+    broadcastMessage(responseJson.dump());
+}
+
+void CustomWebSocketServer::broadcastBusRouteResponse(const std::string &command_type, const std::string &source_type, unsigned int source_number,
+                                                      const std::string &destination_type, unsigned int destination_number, double level_db)
+{
+    json responseJson;
+    responseJson["command_type"] = command_type;
+    responseJson["source_type"] = source_type;
+    responseJson["source_number"] = source_number;
+    responseJson["destination_type"] = destination_type;
+    responseJson["destination_number"] = destination_number;
+    responseJson["level_db"] = level_db;
+    broadcastMessage(responseJson.dump());
+}
+
 void CustomWebSocketServer::broadcastFilterResponse(const std::string &command_type, const std::string &channel_type, unsigned int channel_number, unsigned int filter_id,
                                                     bool filter_enabled, std::string filter_type, double center_frequency, double q_factor, double gain_db)
 {
@@ -262,6 +504,60 @@ void CustomWebSocketServer::broadcastFilterResponse(const std::string &command_t
     broadcastMessage(responseJson.dump());
 }
 
+void CustomWebSocketServer::broadcastCrossoverResponse(const std::string &command_type, unsigned int crossover_id, const CrossoverSettings &settings)
+{
+    json responseJson;
+    responseJson["command_type"] = command_type;
+    responseJson["crossover_id"] = crossover_id;
+    responseJson["crossover_enabled"] = settings.is_enabled;
+    responseJson["crossover_type"] = crossover_type_name(settings.crossover_type);
+    responseJson["source_output"] = settings.source_output;
+    responseJson["frequencies"] = settings.frequencies;
+    responseJson["outputs"] = settings.outputs;
+    responseJson["delays_ms"] = settings.delays_ms;
+    responseJson["gains_db"] = settings.gains_db;
+    broadcastMessage(responseJson.dump());
+}
+
+void CustomWebSocketServer::broadcastConvolutionResponse(const std::string &command_type, const std::string &channel_type, unsigned int channel_number,
+                                                         const ConvolutionSettings &settings)
+{
+    json responseJson;
+    responseJson["command_type"] = command_type;
+    responseJson["channel_type"] = channel_type;
+    responseJson["channel_number"] = channel_number;
+    responseJson["convolution_enabled"] = settings.is_enabled;
+    responseJson["file"] = settings.file;
+    responseJson["file_channel"] = settings.file_channel;
+    broadcastMessage(responseJson.dump());
+}
+
+void CustomWebSocketServer::broadcastEqResponse(const std::string &command_type, const std::string &channel_type, unsigned int channel_number,
+                                                const FrequencyResponse &response)
+{
+    json responseJson;
+    responseJson["command_type"] = command_type;
+    responseJson["channel_type"] = channel_type;
+    responseJson["channel_number"] = channel_number;
+    responseJson["frequencies"] = response.frequencies;
+    responseJson["magnitude_db"] = response.magnitude_db;
+    responseJson["phase_deg"] = response.phase_deg;
+    broadcastMessage(responseJson.dump());
+}
+
+void CustomWebSocketServer::broadcastEqualizerModeResponse(const std::string &command_type, const std::string &channel_type, unsigned int channel_number,
+                                                           EqualizerMode mode, double latency_ms, double processing_us)
+{
+    json responseJson;
+    responseJson["command_type"] = command_type;
+    responseJson["channel_type"] = channel_type;
+    responseJson["channel_number"] = channel_number;
+    responseJson["equalizer_mode"] = equalizer_mode_name(mode);
+    responseJson["latency_ms"] = latency_ms;
+    responseJson["processing_us"] = processing_us;
+    broadcastMessage(responseJson.dump());
+}
+
 void CustomWebSocketServer::broadcastSignalAmplitudes(const std::string &command_type, const std::string &channel_type, const std::vector<double> &amplitudes_db)
 {
     json responseJson;
@@ -271,4 +567,40 @@ void CustomWebSocketServer::broadcastSignalAmplitudes(const std::string &command
     broadcastMessage(responseJson.dump());
 }
 
+void CustomWebSocketServer::broadcastDeviceStats(const std::string &command_type, const DeviceStatsReport &report)
+{
+    auto stream_json = [](const StreamStats &stats)
+    {
+        json streamJson;
+        streamJson["xruns"] = stats.xruns;
+        streamJson["suspends"] = stats.suspends;
+        streamJson["errors"] = stats.errors;
+        return streamJson;
+    };
+
+    json responseJson;
+    responseJson["command_type"] = command_type;
+    responseJson["capture"] = stream_json(report.capture);
+    responseJson["playback"] = stream_json(report.playback);
+    responseJson["recoveries"] = report.recoveries;
+    responseJson["reopens"] = report.reopens;
+    responseJson["failed_recoveries"] = report.failed_recoveries;
+    responseJson["periods"] = report.periods;
+    responseJson["late_periods"] = report.late_periods;
+    responseJson["max_processing_us"] = report.max_processing_us;
+    responseJson["mean_processing_us"] = report.mean_processing_us;
+    responseJson["period_budget_us"] = report.period_budget_us;
+    responseJson["incidents"] = json::array();
+    for (const auto &incident : report.incidents)
+    {
+        json incidentJson;
+        incidentJson["time_ms"] = incident.time_ms;
+        incidentJson["source"] = incident_source_name(incident.source);
+        incidentJson["type"] = incident_type_name(incident.type);
+        incidentJson["error"] = incident.error_message;
+        responseJson["incidents"].push_back(incidentJson);
+    }
+    broadcastMessage(responseJson.dump());
+}
+
 #endif // CUSTOM_WEBSOCKET_SERVER_H
\ No newline at end of file
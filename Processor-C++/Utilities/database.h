@@ -5,18 +5,34 @@
 #include <string>
 #include <mysqlx/xdevapi.h>
 #include <vector>
+#include <algorithm>
+#include <cstdio>
 #include "event_manager.h"
 #include "type_aliases.h"
+#include "../AudioEffects/biquad_filter.h"
+#include "../AudioEffects/crossover.h"
+#include "../AudioEffects/convolver.h"
+#include "../AudioEffects/delay.h"
+#include "../AudioEffects/equalizer.h"
+#include "../AudioEffects/gain.h"
+#include "../AudioEffects/mixer.h"
 
 class Database
 {
 public:
-    Database(const std::string &host, int port, const std::string &user, const std::string &password, const std::string &schema);
+    // Constructor. input_channels, output_channels, sample_rate and ir_directory are those of the audio processor, for checking
+    // settings that depend on them.
+    Database(const std::string &host, int port, const std::string &user, const std::string &password, const std::string &schema,
+             unsigned int input_channels, unsigned int output_channels, double sample_rate, const std::string &ir_directory);
 
 private:
     mysqlx::Session session;
     mysqlx::Schema schema;
     std::string tableName = "audio_parameters";
+    unsigned int inputChannels;
+    unsigned int outputChannels;
+    double sampleRate;
+    std::string irDirectory;
     void setGain(
         const std::string &channel_type, unsigned int channel_number, double volume_db,
         SetGainCallbackType callback = [](const std::string &, const std::string &, unsigned int, double) {});
@@ -28,17 +44,36 @@ private:
         SetMixerCallbackType callback = [](const std::string &, unsigned int, unsigned int, bool) {});
     void setFilter(
         const std::string &channel_type, unsigned int channel_number, unsigned int filter_id, bool isEnabled,
-        std::string filter_type_str, double center_frequency, double q_factor, double gain_db,
-        SetFilterCallbackType callback = [](const std::string &, const std::string &, unsigned int, unsigned int, bool, std::string, double, double, double) {});
+        FilterType filter_type, double center_frequency, double q_factor, double gain_db,
+        SetFilterCallbackType callback = [](const std::string &, const std::string &, unsigned int, unsigned int, bool, FilterType, double, double, double) {});
     void getGain(const std::string &channel_type, unsigned int channel_number, SetGainCallbackType callback);
+    void setDelay(const std::string &channel_type, unsigned int channel_number, double delay_ms);
+    void getDelay(const std::string &channel_type, unsigned int channel_number, SetDelayCallbackType callback);
     void getMute(const std::string &channel_type, unsigned int channel_number, SetMuteCallbackType callback);
     void getMixer(unsigned int input_channel_number, unsigned int output_channel_number, SetMixerCallbackType callback);
+    void setMixerLevel(unsigned int input_channel_number, unsigned int output_channel_number, double level_db);
+    void getMixerLevel(unsigned int input_channel_number, unsigned int output_channel_number, SetMixerLevelCallbackType callback);
+    void setMixerSnapshot(const std::vector<MixerCrosspoint> &crosspoints);
+    void setBusRoute(const std::string &source_type, unsigned int source_number, const std::string &destination_type, unsigned int destination_number, double level_db);
+    void getBusRoute(const std::string &source_type, unsigned int source_number, const std::string &destination_type, unsigned int destination_number,
+                     SetBusRouteCallbackType callback);
     void getFilter(const std::string &channel_type, unsigned int channel_number, unsigned int filter_id, SetFilterCallbackType callback);
+    void setCrossover(unsigned int crossover_id, const CrossoverSettings &settings);
+    void getCrossover(unsigned int crossover_id, SetCrossoverCallbackType callback);
+    void setConvolution(const std::string &channel_type, unsigned int channel_number, const ConvolutionSettings &settings);
+    void getConvolution(const std::string &channel_type, unsigned int channel_number, SetConvolutionCallbackType callback);
+    void setEqualizerMode(const std::string &channel_type, unsigned int channel_number, EqualizerMode mode);
+    void getEqualizerMode(const std::string &channel_type, unsigned int channel_number, SetEqualizerModeCallbackType callback);
 };
 
-Database::Database(const std::string &host, int port, const std::string &user, const std::string &password, const std::string &schemaName)
+Database::Database(const std::string &host, int port, const std::string &user, const std::string &password, const std::string &schemaName,
+                   unsigned int input_channels, unsigned int output_channels, double sample_rate, const std::string &ir_directory)
     : session(host, port, user, password),
-      schema(session.getSchema(schemaName))
+      schema(session.getSchema(schemaName)),
+      inputChannels(input_channels),
+      outputChannels(output_channels),
+      sampleRate(sample_rate),
+      irDirectory(ir_directory)
 {
     // Create table if it doesn't exist
     session.sql("CREATE TABLE IF NOT EXISTS " + schemaName + "." + tableName + " ("
@@ -52,6 +87,10 @@ Database::Database(const std::string &host, int port, const std::string &user, c
         "get_database_gain", [this](const std::string &channel_type, unsigned int channel_number, SetGainCallbackType callback)
         { this->getGain(channel_type, channel_number, callback); });
 
+    EventManager::getInstance().on<std::string, unsigned int, SetDelayCallbackType>(
+        "get_database_delay", [this](const std::string &channel_type, unsigned int channel_number, SetDelayCallbackType callback)
+        { this->getDelay(channel_type, channel_number, callback); });
+
     EventManager::getInstance().on<std::string, unsigned int, SetMuteCallbackType>(
         "get_database_mute", [this](const std::string &channel_type, unsigned int channel_number, SetMuteCallbackType callback)
         { this->getMute(channel_type, channel_number, callback); });
@@ -59,14 +98,34 @@ Database::Database(const std::string &host, int port, const std::string &user, c
     EventManager::getInstance().on<unsigned int, unsigned int, SetMixerCallbackType>(
         "get_database_mixer", [this](unsigned int input_channel_number, unsigned int output_channel_number, SetMixerCallbackType callback)
         { this->getMixer(input_channel_number, output_channel_number, callback); });
+    EventManager::getInstance().on<unsigned int, unsigned int, SetMixerLevelCallbackType>(
+        "get_database_mixer_level", [this](unsigned int input_channel_number, unsigned int output_channel_number, SetMixerLevelCallbackType callback)
+        { this->getMixerLevel(input_channel_number, output_channel_number, callback); });
+    EventManager::getInstance().on<std::string, unsigned int, std::string, unsigned int, SetBusRouteCallbackType>(
+        "get_database_bus_route", [this](const std::string &source_type, unsigned int source_number, const std::string &destination_type, unsigned int destination_number,
+                                         SetBusRouteCallbackType callback)
+        { this->getBusRoute(source_type, source_number, destination_type, destination_number, callback); });
     EventManager::getInstance().on<std::string, unsigned int, unsigned int, SetFilterCallbackType>(
         "get_database_filter", [this](const std::string &channel_type, unsigned int channel_number, unsigned int filter_id, SetFilterCallbackType callback)
         { this->getFilter(channel_type, channel_number, filter_id, callback); });
+    EventManager::getInstance().on<unsigned int, SetCrossoverCallbackType>(
+        "get_database_crossover", [this](unsigned int crossover_id, SetCrossoverCallbackType callback)
+        { this->getCrossover(crossover_id, callback); });
+    EventManager::getInstance().on<std::string, unsigned int, SetConvolutionCallbackType>(
+        "get_database_convolution", [this](const std::string &channel_type, unsigned int channel_number, SetConvolutionCallbackType callback)
+        { this->getConvolution(channel_type, channel_number, callback); });
+    EventManager::getInstance().on<std::string, unsigned int, SetEqualizerModeCallbackType>(
+        "get_database_equalizer_mode", [this](const std::string &channel_type, unsigned int channel_number, SetEqualizerModeCallbackType callback)
+        { this->getEqualizerMode(channel_type, channel_number, callback); });
 
     EventManager::getInstance().on<const std::string &, unsigned int, double, SetGainCallbackType>(
         "set_gain", [this](const std::string &channel_type, unsigned int channel_number, double volume_db, SetGainCallbackType callback)
         { this->setGain(channel_type, channel_number, volume_db); });
 
+    EventManager::getInstance().on<const std::string &, unsigned int, double, SetDelayCallbackType>(
+        "set_delay", [this](const std::string &channel_type, unsigned int channel_number, double delay_ms, SetDelayCallbackType callback)
+        { this->setDelay(channel_type, channel_number, delay_ms); });
+
     EventManager::getInstance().on<const std::string &, unsigned int, bool, SetMuteCallbackType>(
         "set_mute", [this](const std::string &channel_type, unsigned int channel_number, bool mute, SetMuteCallbackType callback)
         { this->setMute(channel_type, channel_number, mute); });
@@ -75,21 +134,51 @@ Database::Database(const std::string &host, int port, const std::string &user, c
         "set_mixer", [this](unsigned int input_channel_number, unsigned int output_channel_number, bool route, SetMixerCallbackType callback)
         { this->setMixer(input_channel_number, output_channel_number, route); });
 
-    EventManager::getInstance().on<const std::string &, unsigned int, unsigned int, bool, std::string, double, double, double, SetFilterCallbackType>(
+    EventManager::getInstance().on<unsigned int, unsigned int, double, SetMixerLevelCallbackType>(
+        "set_mixer_level", [this](unsigned int input_channel_number, unsigned int output_channel_number, double level_db, SetMixerLevelCallbackType callback)
+        { this->setMixerLevel(input_channel_number, output_channel_number, level_db); });
+
+    EventManager::getInstance().on<const std::vector<MixerCrosspoint> &, SetMixerSnapshotCallbackType>(
+        "set_mixer_snapshot", [this](const std::vector<MixerCrosspoint> &crosspoints, SetMixerSnapshotCallbackType callback)
+        { this->setMixerSnapshot(crosspoints); });
+
+    EventManager::getInstance().on<const std::string &, unsigned int, const std::string &, unsigned int, double, SetBusRouteCallbackType>(
+        "set_bus_route", [this](const std::string &source_type, unsigned int source_number, const std::string &destination_type, unsigned int destination_number,
+                                double level_db, SetBusRouteCallbackType callback)
+        { this->setBusRoute(source_type, source_number, destination_type, destination_number, level_db); });
+
+    EventManager::getInstance().on<const std::string &, unsigned int, unsigned int, bool, FilterType, double, double, double, SetFilterCallbackType>(
         "set_filter", [this](const std::string &channel_type, unsigned int channel_number, unsigned int filter_id, bool isEnabled,
-                             std::string filter_type_str, double center_frequency, double q_factor, double gain_db, SetFilterCallbackType callback)
-        { this->setFilter(channel_type, channel_number, filter_id, isEnabled, filter_type_str, center_frequency, q_factor, gain_db); });
+                             FilterType filter_type, double center_frequency, double q_factor, double gain_db, SetFilterCallbackType callback)
+        { this->setFilter(channel_type, channel_number, filter_id, isEnabled, filter_type, center_frequency, q_factor, gain_db); });
+
+    EventManager::getInstance().on<unsigned int, const CrossoverSettings &, SetCrossoverCallbackType>(
+        "set_crossover", [this](unsigned int crossover_id, const CrossoverSettings &settings, SetCrossoverCallbackType callback)
+        { this->setCrossover(crossover_id, settings); });
+
+    EventManager::getInstance().on<const std::string &, unsigned int, const ConvolutionSettings &, SetConvolutionCallbackType>(
+        "set_convolution", [this](const std::string &channel_type, unsigned int channel_number, const ConvolutionSettings &settings, SetConvolutionCallbackType callback)
+        { this->setConvolution(channel_type, channel_number, settings); });
+
+    EventManager::getInstance().on<const std::string &, unsigned int, EqualizerMode, SetEqualizerModeCallbackType>(
+        "set_equalizer_mode", [this](const std::string &channel_type, unsigned int channel_number, EqualizerMode mode, SetEqualizerModeCallbackType callback)
+        { this->setEqualizerMode(channel_type, channel_number, mode); });
 }
 
 void Database::setGain(
     const std::string &channel_type, unsigned int channel_number, double volume_db,
     SetGainCallbackType callback)
 {
+    // Gains the channel refuses are not stored
+    if (std::isnan(volume_db) || volume_db > Gain::MAX_GAIN_DB)
+    {
+        return;
+    }
     std::string parameter_name = channel_type + "_volume_" + std::to_string(channel_number);
     mysqlx::Table table = schema.getTable(tableName);
     table.remove().where("parameter_name = :name").bind("name", parameter_name).execute();
 
-    table.insert("parameter_name", "parameter_double_value").values(parameter_name, volume_db).execute();
+    table.insert("parameter_name", "parameter_double_value").values(parameter_name, std::max(volume_db, Gain::MIN_GAIN_DB)).execute();
 }
 
 void Database::getGain(const std::string &channel_type, unsigned int channel_number, SetGainCallbackType callback)
@@ -111,6 +200,39 @@ void Database::getGain(const std::string &channel_type, unsigned int channel_num
     callback(command_type, channel_type, channel_number, volume_db);
 }
 
+void Database::setDelay(const std::string &channel_type, unsigned int channel_number, double delay_ms)
+{
+    // Delays the channel refuses are not stored
+    if (!(delay_ms >= 0.0 && delay_ms <= Delay::MAX_DELAY_MS))
+    {
+        return;
+    }
+    std::string parameter_name = channel_type + "_delay_ms_" + std::to_string(channel_number);
+    mysqlx::Table table = schema.getTable(tableName);
+    table.remove().where("parameter_name = :name").bind("name", parameter_name).execute();
+
+    table.insert("parameter_name", "parameter_double_value").values(parameter_name, delay_ms).execute();
+}
+
+void Database::getDelay(const std::string &channel_type, unsigned int channel_number, SetDelayCallbackType callback)
+{
+    std::string parameter_name = channel_type + "_delay_ms_" + std::to_string(channel_number);
+    mysqlx::Table table = schema.getTable(tableName);
+    mysqlx::RowResult result = table.select("parameter_double_value").where("parameter_name = :name").bind("name", parameter_name).execute();
+
+    double delay_ms = 0.0;
+
+    std::string command_type = "get_delay_failed";
+
+    if (mysqlx::Row row = result.fetchOne())
+    {
+        command_type = "notify_delay";
+        delay_ms = static_cast<double>(row[0]);
+    }
+
+    callback(command_type, channel_type, channel_number, delay_ms);
+}
+
 void Database::setMute(
     const std::string &channel_type, unsigned int channel_number, bool mute,
     SetMuteCallbackType callback)
@@ -149,6 +271,9 @@ void Database::setMixer(
     mysqlx::Table table = schema.getTable(tableName);
     table.remove().where("parameter_name = :name").bind("name", parameter_name).execute();
     table.insert("parameter_name", "parameter_int_value").values(parameter_name, route ? 1.0f : 0.0f).execute();
+    // An on/off change replaces any level set before it
+    std::string level_parameter_name = "routing_level_" + std::to_string(input_channel_number) + "_" + std::to_string(output_channel_number);
+    table.remove().where("parameter_name = :name").bind("name", level_parameter_name).execute();
 }
 
 void Database::getMixer(unsigned int input_channel_number, unsigned int output_channel_number, SetMixerCallbackType callback)
@@ -171,9 +296,135 @@ void Database::getMixer(unsigned int input_channel_number, unsigned int output_c
     callback(command_type, input_channel_number, output_channel_number, route);
 }
 
+void Database::setMixerLevel(unsigned int input_channel_number, unsigned int output_channel_number, double level_db)
+{
+    // Crosspoints and levels the mixer refuses are not stored
+    if (input_channel_number < 1 || input_channel_number > inputChannels || output_channel_number < 1 || output_channel_number > outputChannels ||
+        std::isnan(level_db) || level_db > Mixer::MAX_LEVEL_DB)
+    {
+        return;
+    }
+    level_db = std::max(level_db, Mixer::MIN_LEVEL_DB);
+    std::string suffix = std::to_string(input_channel_number) + "_" + std::to_string(output_channel_number);
+    mysqlx::Table table = schema.getTable(tableName);
+    // Keep the on/off row in step, so a client reading only get_mixer sees the crosspoint state
+    table.remove().where("parameter_name = :name").bind("name", "routing_" + suffix).execute();
+    table.insert("parameter_name", "parameter_int_value").values("routing_" + suffix, level_db > Mixer::MIN_LEVEL_DB ? 1 : 0).execute();
+    table.remove().where("parameter_name = :name").bind("name", "routing_level_" + suffix).execute();
+    table.insert("parameter_name", "parameter_double_value").values("routing_level_" + suffix, level_db).execute();
+}
+
+void Database::setMixerSnapshot(const std::vector<MixerCrosspoint> &crosspoints)
+{
+    // A recall with an invalid crosspoint is refused by the mixer as a whole, so it is not stored either
+    for (const MixerCrosspoint &crosspoint : crosspoints)
+    {
+        if (crosspoint.input_channel < 1 || crosspoint.input_channel > inputChannels || crosspoint.output_channel < 1 ||
+            crosspoint.output_channel > outputChannels || std::isnan(crosspoint.level_db) || crosspoint.level_db > Mixer::MAX_LEVEL_DB)
+        {
+            return;
+        }
+    }
+    for (const MixerCrosspoint &crosspoint : crosspoints)
+    {
+        setMixerLevel(crosspoint.input_channel, crosspoint.output_channel, crosspoint.level_db);
+    }
+}
+
+void Database::getMixerLevel(unsigned int input_channel_number, unsigned int output_channel_number, SetMixerLevelCallbackType callback)
+{
+    std::string parameter_name = "routing_level_" + std::to_string(input_channel_number) + "_" + std::to_string(output_channel_number);
+    mysqlx::Table table = schema.getTable(tableName);
+    mysqlx::RowResult result = table.select("parameter_double_value").where("parameter_name = :name").bind("name", parameter_name).execute();
+
+    // Default value
+    double level_db = Mixer::MIN_LEVEL_DB;
+
+    std::string command_type = "get_mixer_level_failed";
+
+    if (mysqlx::Row row = result.fetchOne())
+    {
+        command_type = "notify_mixer_level";
+        level_db = static_cast<double>(row[0]);
+    }
+
+    callback(command_type, input_channel_number, output_channel_number, level_db);
+}
+
+void Database::setBusRoute(const std::string &source_type, unsigned int source_number, const std::string &destination_type, unsigned int destination_number,
+                           double level_db)
+{
+    // Routes the mixer refuses are not stored: invalid levels, input to output crosspoints, which are stored by setMixerLevel,
+    // and bus to bus routes closing a loop
+    if (std::isnan(level_db) || level_db > Mixer::MAX_LEVEL_DB || (source_type == "input" && destination_type == "output"))
+    {
+        return;
+    }
+    level_db = std::max(level_db, Mixer::MIN_LEVEL_DB);
+    std::string parameter_name = "route_" + source_type + "_" + std::to_string(source_number) + "_" + destination_type + "_" + std::to_string(destination_number);
+    mysqlx::Table table = schema.getTable(tableName);
+
+    if (source_type == "bus" && destination_type == "bus" && level_db > Mixer::MIN_LEVEL_DB)
+    {
+        // Follow the stored bus to bus routes from the destination; reaching the source means the new route closes a loop
+        std::vector<std::pair<unsigned int, unsigned int>> feeds;
+        mysqlx::RowResult result = table.select("parameter_name", "parameter_double_value")
+                                       .where("parameter_name LIKE 'route_bus_%_bus_%' AND parameter_double_value > :off")
+                                       .bind("off", Mixer::MIN_LEVEL_DB)
+                                       .execute();
+        for (mysqlx::Row row : result)
+        {
+            unsigned int from, to;
+            if (std::sscanf(static_cast<std::string>(row[0]).c_str(), "route_bus_%u_bus_%u", &from, &to) == 2)
+            {
+                feeds.emplace_back(from, to);
+            }
+        }
+        std::vector<unsigned int> reached = {destination_number};
+        for (size_t i = 0; i < reached.size(); ++i)
+        {
+            if (reached[i] == source_number)
+            {
+                return;
+            }
+            for (const auto &[from, to] : feeds)
+            {
+                if (from == reached[i] && std::find(reached.begin(), reached.end(), to) == reached.end())
+                {
+                    reached.push_back(to);
+                }
+            }
+        }
+    }
+
+    table.remove().where("parameter_name = :name").bind("name", parameter_name).execute();
+    table.insert("parameter_name", "parameter_double_value").values(parameter_name, level_db).execute();
+}
+
+void Database::getBusRoute(const std::string &source_type, unsigned int source_number, const std::string &destination_type, unsigned int destination_number,
+                           SetBusRouteCallbackType callback)
+{
+    std::string parameter_name = "route_" + source_type + "_" + std::to_string(source_number) + "_" + destination_type + "_" + std::to_string(destination_number);
+    mysqlx::Table table = schema.getTable(tableName);
+    mysqlx::RowResult result = table.select("parameter_double_value").where("parameter_name = :name").bind("name", parameter_name).execute();
+
+    // Default value
+    double level_db = Mixer::MIN_LEVEL_DB;
+
+    std::string command_type = "get_bus_route_failed";
+
+    if (mysqlx::Row row = result.fetchOne())
+    {
+        command_type = "notify_bus_route";
+        level_db = static_cast<double>(row[0]);
+    }
+
+    callback(command_type, source_type, source_number, destination_type, destination_number, level_db);
+}
+
 void Database::setFilter(
     const std::string &channel_type, unsigned int channel_number, unsigned int filter_id, bool isEnabled,
-    std::string filter_type_str, double center_frequency, double q_factor, double gain_db,
+    FilterType filter_type, double center_frequency, double q_factor, double gain_db,
     SetFilterCallbackType callback)
 {
     std::string parameter_prefix = channel_type + "_filter_" + std::to_string(channel_number) + "_" + std::to_string(filter_id) + "_";
@@ -207,7 +458,7 @@ void Database::setFilter(
     updateFilterParameterDouble("center_frequency", center_frequency);
     updateFilterParameterDouble("q_factor", q_factor);
     updateFilterParameterDouble("gain_db", gain_db);
-    updateFilterParameterStr("filter_type", filter_type_str);
+    updateFilterParameterStr("filter_type", filter_type_name(filter_type));
 }
 
 void Database::getFilter(const std::string &channel_type, unsigned int channel_number, unsigned int filter_id, SetFilterCallbackType callback)
@@ -278,10 +529,12 @@ void Database::getFilter(const std::string &channel_type, unsigned int channel_n
 
     double gain_db = fetchFilterParameterDouble("gain_db", anyParameterNotFound);
 
+    // A missing filter type defaults to peaking, a stored name this version does not know counts as not found
+    FilterType filter_type = FilterType::Peaking;
     std::string filter_type_str = fetchFilterParameterStr("filter_type", anyParameterNotFound);
-    if (filter_type_str.empty())
+    if (!filter_type_str.empty() && !parse_filter_type(filter_type_str, filter_type))
     {
-        filter_type_str = "peaking";
+        anyParameterNotFound = true;
     }
 
     std::string command_type = "notify_filter";
@@ -292,7 +545,225 @@ void Database::getFilter(const std::string &channel_type, unsigned int channel_n
         // return;
     }
 
-    callback(command_type, channel_type, channel_number, filter_id, isEnabled, filter_type_str, center_frequency, q_factor, gain_db);
+    callback(command_type, channel_type, channel_number, filter_id, isEnabled, filter_type, center_frequency, q_factor, gain_db);
+}
+
+// Stores one row per crossover parameter and one per band parameter, e.g. crossover_1_frequency_2 for the second split
+void Database::setCrossover(unsigned int crossover_id, const CrossoverSettings &settings)
+{
+    // Settings no crossover applies are not stored
+    if (crossover_id < 1 || crossover_id > Crossover::get_crossover_count(outputChannels) || !Crossover::validate(settings, outputChannels, sampleRate))
+    {
+        return;
+    }
+    std::string parameter_prefix = "crossover_" + std::to_string(crossover_id) + "_";
+    mysqlx::Table table = schema.getTable(tableName);
+
+    // Helper function to update a single crossover parameter
+    auto updateCrossoverParameterInt = [&](const std::string &name, int value)
+    {
+        std::string parameter_name = parameter_prefix + name;
+        table.remove().where("parameter_name = :name").bind("name", parameter_name).execute();
+        table.insert("parameter_name", "parameter_int_value").values(parameter_name, value).execute();
+    };
+
+    // Helper function to update a single crossover parameter
+    auto updateCrossoverParameterDouble = [&](const std::string &name, double value)
+    {
+        std::string parameter_name = parameter_prefix + name;
+        table.remove().where("parameter_name = :name").bind("name", parameter_name).execute();
+        table.insert("parameter_name", "parameter_double_value").values(parameter_name, value).execute();
+    };
+
+    // Helper function to update a single crossover parameter (string)
+    auto updateCrossoverParameterStr = [&](const std::string &name, const std::string &value)
+    {
+        std::string parameter_name = parameter_prefix + name;
+        table.remove().where("parameter_name = :name").bind("name", parameter_name).execute();
+        table.insert("parameter_name", "parameter_str_value").values(parameter_name, value).execute();
+    };
+
+    updateCrossoverParameterInt("enabled", settings.is_enabled ? 1 : 0);
+    updateCrossoverParameterStr("type", crossover_type_name(settings.crossover_type));
+    updateCrossoverParameterInt("source", settings.source_output);
+    updateCrossoverParameterInt("bands", static_cast<int>(settings.outputs.size()));
+    for (size_t i = 0; i < settings.frequencies.size(); ++i)
+    {
+        updateCrossoverParameterDouble("frequency_" + std::to_string(i + 1), settings.frequencies[i]);
+    }
+    for (size_t i = 0; i < settings.outputs.size() && i < settings.delays_ms.size() && i < settings.gains_db.size(); ++i)
+    {
+        updateCrossoverParameterInt("output_" + std::to_string(i + 1), settings.outputs[i]);
+        updateCrossoverParameterDouble("delay_ms_" + std::to_string(i + 1), settings.delays_ms[i]);
+        updateCrossoverParameterDouble("gain_db_" + std::to_string(i + 1), settings.gains_db[i]);
+    }
+}
+
+void Database::getCrossover(unsigned int crossover_id, SetCrossoverCallbackType callback)
+{
+    auto fetchCrossoverParameter = [&](const std::string &column, const std::string &parameter_suffix, bool &parameterNotFound) -> mysqlx::Value
+    {
+        std::string parameter_name = "crossover_" + std::to_string(crossover_id) + "_" + parameter_suffix;
+        mysqlx::Table table = schema.getTable(tableName);
+        mysqlx::RowResult result = table.select(column).where("parameter_name = :name").bind("name", parameter_name).execute();
+
+        if (mysqlx::Row row = result.fetchOne())
+        {
+            return row[0];
+        }
+        parameterNotFound = true;
+        return mysqlx::Value();
+    };
+
+    bool anyParameterNotFound = false;
+    CrossoverSettings settings;
+
+    mysqlx::Value enabled = fetchCrossoverParameter("parameter_int_value", "enabled", anyParameterNotFound);
+    mysqlx::Value type = fetchCrossoverParameter("parameter_str_value", "type", anyParameterNotFound);
+    mysqlx::Value source = fetchCrossoverParameter("parameter_int_value", "source", anyParameterNotFound);
+    mysqlx::Value bands = fetchCrossoverParameter("parameter_int_value", "bands", anyParameterNotFound);
+
+    if (!anyParameterNotFound)
+    {
+        settings.is_enabled = static_cast<int>(enabled) != 0;
+        if (!parse_crossover_type(static_cast<std::string>(type), settings.crossover_type))
+        {
+            anyParameterNotFound = true;
+        }
+        settings.source_output = static_cast<unsigned int>(static_cast<int>(source));
+        const int band_count = std::clamp(static_cast<int>(bands), 0, static_cast<int>(Crossover::MAX_BANDS));
+        for (int i = 1; i <= band_count && !anyParameterNotFound; ++i)
+        {
+            if (i < band_count)
+            {
+                mysqlx::Value frequency = fetchCrossoverParameter("parameter_double_value", "frequency_" + std::to_string(i), anyParameterNotFound);
+                settings.frequencies.push_back(anyParameterNotFound ? 0.0 : static_cast<double>(frequency));
+            }
+            mysqlx::Value output = fetchCrossoverParameter("parameter_int_value", "output_" + std::to_string(i), anyParameterNotFound);
+            mysqlx::Value delay_ms = fetchCrossoverParameter("parameter_double_value", "delay_ms_" + std::to_string(i), anyParameterNotFound);
+            mysqlx::Value gain_db = fetchCrossoverParameter("parameter_double_value", "gain_db_" + std::to_string(i), anyParameterNotFound);
+            if (!anyParameterNotFound)
+            {
+                settings.outputs.push_back(static_cast<unsigned int>(static_cast<int>(output)));
+                settings.delays_ms.push_back(static_cast<double>(delay_ms));
+                settings.gains_db.push_back(static_cast<double>(gain_db));
+            }
+        }
+    }
+
+    // An incomplete record reports a disabled crossover without bands
+    std::string command_type = "notify_crossover";
+    if (anyParameterNotFound)
+    {
+        command_type = "get_crossover_failed";
+        settings = CrossoverSettings();
+    }
+
+    callback(command_type, crossover_id, settings);
+}
+
+// Stores one row per convolution parameter, e.g. output_convolution_1_file
+void Database::setConvolution(const std::string &channel_type, unsigned int channel_number, const ConvolutionSettings &settings)
+{
+    // Settings no convolver applies are not stored. Only the output channels have a convolver.
+    std::vector<float> impulse_response;
+    std::string error;
+    if (channel_type != "output" || channel_number < 1 || channel_number > outputChannels ||
+        !Convolver::read_impulse_response(settings, irDirectory, sampleRate, impulse_response, error))
+    {
+        return;
+    }
+    std::string parameter_prefix = channel_type + "_convolution_" + std::to_string(channel_number) + "_";
+    mysqlx::Table table = schema.getTable(tableName);
+
+    // Helper function to update a single convolution parameter
+    auto updateConvolutionParameterInt = [&](const std::string &name, int value)
+    {
+        std::string parameter_name = parameter_prefix + name;
+        table.remove().where("parameter_name = :name").bind("name", parameter_name).execute();
+        table.insert("parameter_name", "parameter_int_value").values(parameter_name, value).execute();
+    };
+
+    // Helper function to update a single convolution parameter (string)
+    auto updateConvolutionParameterStr = [&](const std::string &name, const std::string &value)
+    {
+        std::string parameter_name = parameter_prefix + name;
+        table.remove().where("parameter_name = :name").bind("name", parameter_name).execute();
+        table.insert("parameter_name", "parameter_str_value").values(parameter_name, value).execute();
+    };
+
+    updateConvolutionParameterInt("enabled", settings.is_enabled ? 1 : 0);
+    updateConvolutionParameterStr("file", settings.file);
+    updateConvolutionParameterInt("file_channel", static_cast<int>(settings.file_channel));
+}
+
+void Database::getConvolution(const std::string &channel_type, unsigned int channel_number, SetConvolutionCallbackType callback)
+{
+    auto fetchConvolutionParameter = [&](const std::string &column, const std::string &parameter_suffix, bool &parameterNotFound) -> mysqlx::Value
+    {
+        std::string parameter_name = channel_type + "_convolution_" + std::to_string(channel_number) + "_" + parameter_suffix;
+        mysqlx::Table table = schema.getTable(tableName);
+        mysqlx::RowResult result = table.select(column).where("parameter_name = :name").bind("name", parameter_name).execute();
+
+        if (mysqlx::Row row = result.fetchOne())
+        {
+            return row[0];
+        }
+        parameterNotFound = true;
+        return mysqlx::Value();
+    };
+
+    bool anyParameterNotFound = false;
+    ConvolutionSettings settings;
+
+    mysqlx::Value enabled = fetchConvolutionParameter("parameter_int_value", "enabled", anyParameterNotFound);
+    mysqlx::Value file = fetchConvolutionParameter("parameter_str_value", "file", anyParameterNotFound);
+    mysqlx::Value file_channel = fetchConvolutionParameter("parameter_int_value", "file_channel", anyParameterNotFound);
+
+    std::string command_type = "notify_convolution";
+    if (anyParameterNotFound)
+    {
+        command_type = "get_convolution_failed";
+    }
+    else
+    {
+        settings.is_enabled = static_cast<int>(enabled) != 0;
+        settings.file = static_cast<std::string>(file);
+        settings.file_channel = static_cast<unsigned int>(static_cast<int>(file_channel));
+    }
+
+    callback(command_type, channel_type, channel_number, settings);
+}
+
+// Stores the mode by name, e.g. output_equalizer_mode_1 = linear_phase
+void Database::setEqualizerMode(const std::string &channel_type, unsigned int channel_number, EqualizerMode mode)
+{
+    std::string parameter_name = channel_type + "_equalizer_mode_" + std::to_string(channel_number);
+    mysqlx::Table table = schema.getTable(tableName);
+    table.remove().where("parameter_name = :name").bind("name", parameter_name).execute();
+    table.insert("parameter_name", "parameter_str_value").values(parameter_name, equalizer_mode_name(mode)).execute();
+}
+
+void Database::getEqualizerMode(const std::string &channel_type, unsigned int channel_number, SetEqualizerModeCallbackType callback)
+{
+    std::string parameter_name = channel_type + "_equalizer_mode_" + std::to_string(channel_number);
+    mysqlx::Table table = schema.getTable(tableName);
+    mysqlx::RowResult result = table.select("parameter_str_value").where("parameter_name = :name").bind("name", parameter_name).execute();
+
+    // Channels without a stored mode, or with a name this version does not know, stay in the IIR mode
+    EqualizerMode mode = EqualizerMode::IIR;
+
+    std::string command_type = "get_equalizer_mode_failed";
+
+    if (mysqlx::Row row = result.fetchOne())
+    {
+        if (parse_equalizer_mode(static_cast<std::string>(row[0]), mode))
+        {
+            command_type = "notify_equalizer_mode";
+        }
+    }
+
+    callback(command_type, channel_type, channel_number, mode, 0.0, 0.0);
 }
 
 #endif // DATABASE_H
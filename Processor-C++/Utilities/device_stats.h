@@ -0,0 +1,300 @@
+// device_stats.h
+// Telemetry of the audio device: xruns, suspends and other errors per stream, the recoveries they caused, the processing
+// time of each period compared to the period budget, and the last incidents with the time they happened.
+// The audio thread records into atomics only; the control side reads a snapshot through the "get_device_stats" event.
+
+#ifndef DEVICE_STATS_H
+#define DEVICE_STATS_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <alsa/asoundlib.h>
+#include "event_manager.h"
+#include "type_aliases.h"
+
+// Where an incident happened
+enum class IncidentSource
+{
+    Capture = 0,
+    Playback = 1,
+    Device = 2
+};
+
+// What happened
+enum class IncidentType
+{
+    // A stream ran out of data or out of room
+    Xrun = 0,
+    // The device was suspended, e.g. by power management
+    Suspend = 1,
+    // Any other error returned by a stream
+    Error = 2,
+    // Restarting the streams failed and the device was reopened
+    Reopen = 3,
+    // Reopening the device failed
+    RecoveryFailed = 4
+};
+
+// Function to get the name of an incident source, as used in the get_device_stats response
+const char *incident_source_name(IncidentSource source)
+{
+    switch (source)
+    {
+    case IncidentSource::Capture:
+        return "capture";
+    case IncidentSource::Playback:
+        return "playback";
+    default:
+        return "device";
+    }
+}
+
+// Function to get the name of an incident type, as used in the get_device_stats response
+const char *incident_type_name(IncidentType type)
+{
+    switch (type)
+    {
+    case IncidentType::Xrun:
+        return "xrun";
+    case IncidentType::Suspend:
+        return "suspend";
+    case IncidentType::Error:
+        return "error";
+    case IncidentType::Reopen:
+        return "reopen";
+    default:
+        return "recovery_failed";
+    }
+}
+
+// One recorded incident
+struct DeviceIncident
+{
+    // Wall clock time in milliseconds since the epoch
+    int64_t time_ms;
+    IncidentSource source;
+    IncidentType type;
+    // ALSA error code and its description
+    int error;
+    std::string error_message;
+};
+
+// Counters of one stream
+struct StreamStats
+{
+    uint64_t xruns = 0;
+    uint64_t suspends = 0;
+    uint64_t errors = 0;
+};
+
+// Snapshot of all device statistics
+struct DeviceStatsReport
+{
+    StreamStats capture;
+    StreamStats playback;
+    // Incidents recovered by restarting the streams, by reopening the device, and recovery attempts that failed
+    uint64_t recoveries = 0;
+    uint64_t reopens = 0;
+    uint64_t failed_recoveries = 0;
+    // Processed periods, and how many of them took longer than the period budget
+    uint64_t periods = 0;
+    uint64_t late_periods = 0;
+    // Processing time per period and the time one period lasts, in microseconds
+    double max_processing_us = 0.0;
+    double mean_processing_us = 0.0;
+    double period_budget_us = 0.0;
+    // Last incidents, oldest first
+    std::vector<DeviceIncident> incidents;
+};
+
+class DeviceStats
+{
+public:
+    // Number of incidents kept for the get_device_stats response
+    static constexpr size_t MAX_INCIDENTS = 16;
+
+    // Constructor
+    DeviceStats();
+    // Destructor
+    ~DeviceStats();
+
+    // Function to answer a get_device_stats request
+    void get_device_stats(GetDeviceStatsCallbackType callback);
+    // Function to take a snapshot of all counters and the incident history
+    DeviceStatsReport get_report() const;
+
+    // Functions called from the audio thread only
+    // Function to set the time one period lasts
+    void set_period_budget(size_t period_frames, unsigned int rate);
+    // Function to record the processing time of one period
+    void record_processing_time(uint64_t processing_ns);
+    // Function to record an incident and count it
+    void record_incident(IncidentSource source, IncidentType type, int error);
+    // Function to count a successful restart of the streams
+    void record_recovery();
+
+private:
+    // Counters of one stream
+    struct StreamCounters
+    {
+        std::atomic<uint64_t> xruns{0};
+        std::atomic<uint64_t> suspends{0};
+        std::atomic<uint64_t> errors{0};
+    };
+    // Incident history slot. The sequence is odd while the audio thread writes the slot, so the reader can detect torn reads.
+    struct IncidentSlot
+    {
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<int64_t> time_ms{0};
+        std::atomic<int> source{0};
+        std::atomic<int> type{0};
+        std::atomic<int> error{0};
+    };
+
+    std::array<StreamCounters, 2> stream_counters_;
+    std::atomic<uint64_t> recoveries_{0};
+    std::atomic<uint64_t> reopens_{0};
+    std::atomic<uint64_t> failed_recoveries_{0};
+    std::atomic<uint64_t> periods_{0};
+    std::atomic<uint64_t> late_periods_{0};
+    std::atomic<uint64_t> total_processing_ns_{0};
+    std::atomic<uint64_t> max_processing_ns_{0};
+    std::atomic<uint64_t> period_budget_ns_{0};
+    // Ring of the last incidents and the number of incidents recorded so far
+    std::array<IncidentSlot, MAX_INCIDENTS> incidents_;
+    std::atomic<uint64_t> incident_count_{0};
+    // EventManager function ID
+    size_t event_manager_function_id_;
+};
+
+// Constructor
+DeviceStats::DeviceStats()
+{
+    // Register the get_device_stats event
+    event_manager_function_id_ = EventManager::getInstance().on<GetDeviceStatsCallbackType>(
+        "get_device_stats", [this](GetDeviceStatsCallbackType callback)
+        { this->get_device_stats(callback); });
+}
+
+// Destructor
+DeviceStats::~DeviceStats()
+{
+    EventManager::getInstance().off("get_device_stats", event_manager_function_id_);
+}
+
+// Function to answer a get_device_stats request
+void DeviceStats::get_device_stats(GetDeviceStatsCallbackType callback)
+{
+    callback("notify_device_stats", get_report());
+}
+
+// Function to take a snapshot of all counters and the incident history
+DeviceStatsReport DeviceStats::get_report() const
+{
+    DeviceStatsReport report;
+    auto load_stream = [](const StreamCounters &counters)
+    {
+        StreamStats stats;
+        stats.xruns = counters.xruns.load(std::memory_order_relaxed);
+        stats.suspends = counters.suspends.load(std::memory_order_relaxed);
+        stats.errors = counters.errors.load(std::memory_order_relaxed);
+        return stats;
+    };
+    report.capture = load_stream(stream_counters_[static_cast<int>(IncidentSource::Capture)]);
+    report.playback = load_stream(stream_counters_[static_cast<int>(IncidentSource::Playback)]);
+    report.recoveries = recoveries_.load(std::memory_order_relaxed);
+    report.reopens = reopens_.load(std::memory_order_relaxed);
+    report.failed_recoveries = failed_recoveries_.load(std::memory_order_relaxed);
+    report.periods = periods_.load(std::memory_order_relaxed);
+    report.late_periods = late_periods_.load(std::memory_order_relaxed);
+    report.max_processing_us = max_processing_ns_.load(std::memory_order_relaxed) / 1000.0;
+    report.mean_processing_us = report.periods > 0 ? total_processing_ns_.load(std::memory_order_relaxed) / 1000.0 / report.periods : 0.0;
+    report.period_budget_us = period_budget_ns_.load(std::memory_order_relaxed) / 1000.0;
+
+    // Copy the incidents still in the ring, skipping any slot the audio thread is overwriting at the same time
+    uint64_t count = incident_count_.load(std::memory_order_acquire);
+    for (uint64_t index = count > MAX_INCIDENTS ? count - MAX_INCIDENTS : 0; index < count; ++index)
+    {
+        const IncidentSlot &slot = incidents_[index % MAX_INCIDENTS];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        DeviceIncident incident;
+        incident.time_ms = slot.time_ms.load(std::memory_order_relaxed);
+        incident.source = static_cast<IncidentSource>(slot.source.load(std::memory_order_relaxed));
+        incident.type = static_cast<IncidentType>(slot.type.load(std::memory_order_relaxed));
+        incident.error = slot.error.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence != 2 * index + 2 || slot.sequence.load(std::memory_order_relaxed) != sequence)
+        {
+            continue;
+        }
+        incident.error_message = incident.error < 0 ? snd_strerror(incident.error) : "";
+        report.incidents.push_back(incident);
+    }
+    return report;
+}
+
+// Function to set the time one period lasts
+void DeviceStats::set_period_budget(size_t period_frames, unsigned int rate)
+{
+    period_budget_ns_.store(static_cast<uint64_t>(period_frames) * 1000000000ull / rate, std::memory_order_relaxed);
+}
+
+// Function to record the processing time of one period
+void DeviceStats::record_processing_time(uint64_t processing_ns)
+{
+    // Only the audio thread writes, so plain load/store pairs are enough
+    periods_.store(periods_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    total_processing_ns_.store(total_processing_ns_.load(std::memory_order_relaxed) + processing_ns, std::memory_order_relaxed);
+    if (processing_ns > max_processing_ns_.load(std::memory_order_relaxed))
+    {
+        max_processing_ns_.store(processing_ns, std::memory_order_relaxed);
+    }
+    if (processing_ns > period_budget_ns_.load(std::memory_order_relaxed))
+    {
+        late_periods_.store(late_periods_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+// Function to record an incident and count it
+void DeviceStats::record_incident(IncidentSource source, IncidentType type, int error)
+{
+    // Count the incident
+    auto increment = [](std::atomic<uint64_t> &counter)
+    { counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); };
+    if (source != IncidentSource::Device)
+    {
+        StreamCounters &counters = stream_counters_[static_cast<int>(source)];
+        increment(type == IncidentType::Xrun ? counters.xruns : type == IncidentType::Suspend ? counters.suspends : counters.errors);
+    }
+    else
+    {
+        increment(type == IncidentType::Reopen ? reopens_ : failed_recoveries_);
+    }
+
+    // Store it in the next history slot
+    uint64_t index = incident_count_.load(std::memory_order_relaxed);
+    IncidentSlot &slot = incidents_[index % MAX_INCIDENTS];
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time_ms.store(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count(),
+                       std::memory_order_relaxed);
+    slot.source.store(static_cast<int>(source), std::memory_order_relaxed);
+    slot.type.store(static_cast<int>(type), std::memory_order_relaxed);
+    slot.error.store(error, std::memory_order_relaxed);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+    incident_count_.store(index + 1, std::memory_order_release);
+}
+
+// Function to count a successful restart of the streams
+void DeviceStats::record_recovery()
+{
+    recoveries_.store(recoveries_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+#endif // DEVICE_STATS_H
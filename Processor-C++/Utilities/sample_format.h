@@ -0,0 +1,438 @@
+// sample_format.h
+// Conversion kernels between the interleaved samples exchanged with the ALSA device and the planar
+// 32-bit float buffers used by the audio effects. Float samples are normalized to the range [-1.0, 1.0).
+// Every supported device format has its own pack/unpack kernels, specialized at compile time through SampleFormatTraits.
+// The 16 and 32 bit integer formats, the ones USB and HDA hardware use, also have SSE2/AVX2 kernels on x86 and NEON kernels
+// on ARM that convert a vector of samples per instruction; S24_3LE and FLOAT_LE stay scalar. Samples are little endian, as on
+// every supported host.
+
+#ifndef SAMPLE_FORMAT_H
+#define SAMPLE_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <array>
+#include <algorithm>
+#include <vector>
+#include "cpu_dispatch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SAMPLE_FORMAT_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SAMPLE_FORMAT_NEON 1
+#endif
+
+// Device sample formats supported by the processing engine
+enum class SampleFormat
+{
+    S16_LE = 0,
+    S24_3LE = 1,
+    S32_LE = 2,
+    FLOAT_LE = 3
+};
+
+constexpr size_t SAMPLE_FORMAT_COUNT = 4;
+
+// Scale factors between 16 bit integer samples and normalized float samples
+constexpr float S16_TO_FLOAT_SCALE = 1.0f / 32768.0f;
+constexpr float FLOAT_TO_S16_SCALE = 32768.0f;
+// Scale factors between 24 bit integer samples and normalized float samples
+constexpr float S24_TO_FLOAT_SCALE = 1.0f / 8388608.0f;
+constexpr float FLOAT_TO_S24_SCALE = 8388608.0f;
+// Scale factors between 32 bit integer samples and normalized float samples
+constexpr float S32_TO_FLOAT_SCALE = 1.0f / 2147483648.0f;
+constexpr float FLOAT_TO_S32_SCALE = 2147483648.0f;
+// Largest float below 2^31. Clamping to 2^31 - 1 would round up to 2^31 and overflow the conversion to int32.
+constexpr float S32_MAX_FLOAT = 2147483520.0f;
+
+// Per format properties and the conversion of a single sample
+template <SampleFormat Format>
+struct SampleFormatTraits;
+
+template <>
+struct SampleFormatTraits<SampleFormat::S16_LE>
+{
+    static constexpr size_t bytes = 2;
+    static constexpr const char *name = "S16_LE";
+    static float unpack(const unsigned char *in)
+    {
+        int16_t sample;
+        std::memcpy(&sample, in, sizeof(sample));
+        return static_cast<float>(sample) * S16_TO_FLOAT_SCALE;
+    }
+    static void pack(float in, unsigned char *out)
+    {
+        int16_t sample = static_cast<int16_t>(std::lrintf(std::clamp(in * FLOAT_TO_S16_SCALE, -32768.0f, 32767.0f)));
+        std::memcpy(out, &sample, sizeof(sample));
+    }
+};
+
+template <>
+struct SampleFormatTraits<SampleFormat::S24_3LE>
+{
+    static constexpr size_t bytes = 3;
+    static constexpr const char *name = "S24_3LE";
+    static float unpack(const unsigned char *in)
+    {
+        // Place the three bytes in the upper part of a 32 bit word and shift back down to sign extend them
+        int32_t sample = static_cast<int32_t>((static_cast<uint32_t>(in[0]) << 8) | (static_cast<uint32_t>(in[1]) << 16) | (static_cast<uint32_t>(in[2]) << 24)) >> 8;
+        return static_cast<float>(sample) * S24_TO_FLOAT_SCALE;
+    }
+    static void pack(float in, unsigned char *out)
+    {
+        int32_t sample = static_cast<int32_t>(std::lrintf(std::clamp(in * FLOAT_TO_S24_SCALE, -8388608.0f, 8388607.0f)));
+        out[0] = static_cast<unsigned char>(sample);
+        out[1] = static_cast<unsigned char>(sample >> 8);
+        out[2] = static_cast<unsigned char>(sample >> 16);
+    }
+};
+
+template <>
+struct SampleFormatTraits<SampleFormat::S32_LE>
+{
+    static constexpr size_t bytes = 4;
+    static constexpr const char *name = "S32_LE";
+    static float unpack(const unsigned char *in)
+    {
+        int32_t sample;
+        std::memcpy(&sample, in, sizeof(sample));
+        return static_cast<float>(sample) * S32_TO_FLOAT_SCALE;
+    }
+    static void pack(float in, unsigned char *out)
+    {
+        int32_t sample = static_cast<int32_t>(std::lrintf(std::clamp(in * FLOAT_TO_S32_SCALE, -FLOAT_TO_S32_SCALE, S32_MAX_FLOAT)));
+        std::memcpy(out, &sample, sizeof(sample));
+    }
+};
+
+template <>
+struct SampleFormatTraits<SampleFormat::FLOAT_LE>
+{
+    static constexpr size_t bytes = 4;
+    static constexpr const char *name = "FLOAT_LE";
+    static float unpack(const unsigned char *in)
+    {
+        float sample;
+        std::memcpy(&sample, in, sizeof(sample));
+        return sample;
+    }
+    static void pack(float in, unsigned char *out)
+    {
+        // Clip at full scale like the integer formats do
+        float sample = std::clamp(in, -1.0f, 1.0f);
+        std::memcpy(out, &sample, sizeof(sample));
+    }
+};
+
+// Set of conversion kernels for one device format and instruction set
+struct SampleFormatKernels
+{
+    // Converts count samples of the device format to normalized floats
+    void (*unpack)(const void *in, float *out, size_t count);
+    // Converts count normalized floats to the device format, saturating instead of wrapping around
+    void (*pack)(const float *in, void *out, size_t count);
+    // Size of one sample in bytes
+    size_t bytes_per_sample;
+    // Name of the format and of the instruction set, for logging
+    const char *format_name;
+    const char *name;
+};
+
+// Scalar kernels, used for the tail of every vectorized loop, for the formats without SIMD kernels and on CPUs without SIMD support
+template <SampleFormat Format>
+void unpack_scalar(const void *in, float *out, size_t count)
+{
+    const unsigned char *samples = static_cast<const unsigned char *>(in);
+    for (size_t i = 0; i < count; ++i)
+    {
+        out[i] = SampleFormatTraits<Format>::unpack(samples + i * SampleFormatTraits<Format>::bytes);
+    }
+}
+
+template <SampleFormat Format>
+void pack_scalar(const float *in, void *out, size_t count)
+{
+    unsigned char *samples = static_cast<unsigned char *>(out);
+    for (size_t i = 0; i < count; ++i)
+    {
+        SampleFormatTraits<Format>::pack(in[i], samples + i * SampleFormatTraits<Format>::bytes);
+    }
+}
+
+// Function to build the scalar kernels of one format
+template <SampleFormat Format>
+constexpr SampleFormatKernels make_scalar_kernels()
+{
+    return {unpack_scalar<Format>, pack_scalar<Format>, SampleFormatTraits<Format>::bytes, SampleFormatTraits<Format>::name, "scalar"};
+}
+
+#if defined(SAMPLE_FORMAT_X86)
+// SSE2 kernels, 8 samples per iteration for 16 bit and 4 for 32 bit samples
+__attribute__((target("sse2"))) void unpack_s16_sse2(const void *in_samples, float *out, size_t count)
+{
+    const int16_t *in = static_cast<const int16_t *>(in_samples);
+    const __m128 scale = _mm_set1_ps(S16_TO_FLOAT_SCALE);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        // Sign extend the 16 bit samples to 32 bit by placing them in the upper half and shifting back down
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+    }
+    unpack_scalar<SampleFormat::S16_LE>(in + i, out + i, count - i);
+}
+
+__attribute__((target("sse2"))) void pack_s16_sse2(const float *in, void *out_samples, size_t count)
+{
+    int16_t *out = static_cast<int16_t *>(out_samples);
+    const __m128 scale = _mm_set1_ps(FLOAT_TO_S16_SCALE);
+    const __m128 max = _mm_set1_ps(32767.0f);
+    const __m128 min = _mm_set1_ps(-32768.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128 low = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), max), min);
+        __m128 high = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), max), min);
+        // Round to nearest and pack to 16 bit with signed saturation
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(low), _mm_cvtps_epi32(high));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), packed);
+    }
+    pack_scalar<SampleFormat::S16_LE>(in + i, out + i, count - i);
+}
+
+__attribute__((target("sse2"))) void unpack_s32_sse2(const void *in_samples, float *out, size_t count)
+{
+    const int32_t *in = static_cast<const int32_t *>(in_samples);
+    const __m128 scale = _mm_set1_ps(S32_TO_FLOAT_SCALE);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(samples), scale));
+    }
+    unpack_scalar<SampleFormat::S32_LE>(in + i, out + i, count - i);
+}
+
+__attribute__((target("sse2"))) void pack_s32_sse2(const float *in, void *out_samples, size_t count)
+{
+    int32_t *out = static_cast<int32_t *>(out_samples);
+    const __m128 scale = _mm_set1_ps(FLOAT_TO_S32_SCALE);
+    const __m128 max = _mm_set1_ps(S32_MAX_FLOAT);
+    const __m128 min = _mm_set1_ps(-FLOAT_TO_S32_SCALE);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 scaled = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), max), min);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_cvtps_epi32(scaled));
+    }
+    pack_scalar<SampleFormat::S32_LE>(in + i, out + i, count - i);
+}
+
+// AVX2 kernels, 8 samples per iteration, and 16 when packing 16 bit samples
+__attribute__((target("avx2"))) void unpack_s16_avx2(const void *in_samples, float *out, size_t count)
+{
+    const int16_t *in = static_cast<const int16_t *>(in_samples);
+    const __m256 scale = _mm256_set1_ps(S16_TO_FLOAT_SCALE);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i samples = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+    }
+    unpack_scalar<SampleFormat::S16_LE>(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx2"))) void pack_s16_avx2(const float *in, void *out_samples, size_t count)
+{
+    int16_t *out = static_cast<int16_t *>(out_samples);
+    const __m256 scale = _mm256_set1_ps(FLOAT_TO_S16_SCALE);
+    const __m256 max = _mm256_set1_ps(32767.0f);
+    const __m256 min = _mm256_set1_ps(-32768.0f);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256 low = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale), max), min);
+        __m256 high = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), scale), max), min);
+        // packs works per 128 bit lane, so the 64 bit quarters have to be put back in order afterwards
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(low), _mm256_cvtps_epi32(high));
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), packed);
+    }
+    pack_s16_sse2(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx2"))) void unpack_s32_avx2(const void *in_samples, float *out, size_t count)
+{
+    const int32_t *in = static_cast<const int32_t *>(in_samples);
+    const __m256 scale = _mm256_set1_ps(S32_TO_FLOAT_SCALE);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i samples = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+    }
+    unpack_s32_sse2(in + i, out + i, count - i);
+}
+
+__attribute__((target("avx2"))) void pack_s32_avx2(const float *in, void *out_samples, size_t count)
+{
+    int32_t *out = static_cast<int32_t *>(out_samples);
+    const __m256 scale = _mm256_set1_ps(FLOAT_TO_S32_SCALE);
+    const __m256 max = _mm256_set1_ps(S32_MAX_FLOAT);
+    const __m256 min = _mm256_set1_ps(-FLOAT_TO_S32_SCALE);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 scaled = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), scale), max), min);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_cvtps_epi32(scaled));
+    }
+    pack_s32_sse2(in + i, out + i, count - i);
+}
+#endif // SAMPLE_FORMAT_X86
+
+#if defined(SAMPLE_FORMAT_NEON)
+// Converts 4 scaled floats to int32 with saturation, rounding to nearest where the instruction set allows it
+inline int32x4_t neon_float_to_int(float32x4_t scaled)
+{
+#if defined(__aarch64__)
+    return vcvtnq_s32_f32(scaled);
+#else
+    return vcvtq_s32_f32(scaled);
+#endif
+}
+
+// NEON kernels, 8 samples per iteration for 16 bit and 4 for 32 bit samples
+void unpack_s16_neon(const void *in_samples, float *out, size_t count)
+{
+    const int16_t *in = static_cast<const int16_t *>(in_samples);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        int16x8_t samples = vld1q_s16(in + i);
+        float32x4_t low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples)));
+        float32x4_t high = vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples)));
+        vst1q_f32(out + i, vmulq_n_f32(low, S16_TO_FLOAT_SCALE));
+        vst1q_f32(out + i + 4, vmulq_n_f32(high, S16_TO_FLOAT_SCALE));
+    }
+    unpack_scalar<SampleFormat::S16_LE>(in + i, out + i, count - i);
+}
+
+void pack_s16_neon(const float *in, void *out_samples, size_t count)
+{
+    int16_t *out = static_cast<int16_t *>(out_samples);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        int32x4_t low = neon_float_to_int(vmulq_n_f32(vld1q_f32(in + i), FLOAT_TO_S16_SCALE));
+        int32x4_t high = neon_float_to_int(vmulq_n_f32(vld1q_f32(in + i + 4), FLOAT_TO_S16_SCALE));
+        // Narrow to 16 bit with signed saturation
+        vst1q_s16(out + i, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+    }
+    pack_scalar<SampleFormat::S16_LE>(in + i, out + i, count - i);
+}
+
+void unpack_s32_neon(const void *in_samples, float *out, size_t count)
+{
+    const int32_t *in = static_cast<const int32_t *>(in_samples);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(in + i)), S32_TO_FLOAT_SCALE));
+    }
+    unpack_scalar<SampleFormat::S32_LE>(in + i, out + i, count - i);
+}
+
+void pack_s32_neon(const float *in, void *out_samples, size_t count)
+{
+    int32_t *out = static_cast<int32_t *>(out_samples);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        // The float to int conversion saturates on ARM, so no clamping is needed
+        vst1q_s32(out + i, neon_float_to_int(vmulq_n_f32(vld1q_f32(in + i), FLOAT_TO_S32_SCALE)));
+    }
+    pack_scalar<SampleFormat::S32_LE>(in + i, out + i, count - i);
+}
+#endif // SAMPLE_FORMAT_NEON
+
+// Kernels of every device format for one instruction set, indexed by SampleFormat
+using SampleFormatKernelTable = std::array<SampleFormatKernels, SAMPLE_FORMAT_COUNT>;
+
+// Function to build the table of an instruction set from the scalar kernels, with the S16_LE and S32_LE kernels replaced
+SampleFormatKernelTable make_kernel_table(SampleFormatKernels s16, SampleFormatKernels s32)
+{
+    SampleFormatKernelTable table = {
+        make_scalar_kernels<SampleFormat::S16_LE>(),
+        make_scalar_kernels<SampleFormat::S24_3LE>(),
+        make_scalar_kernels<SampleFormat::S32_LE>(),
+        make_scalar_kernels<SampleFormat::FLOAT_LE>()};
+    table[static_cast<size_t>(SampleFormat::S16_LE)] = s16;
+    table[static_cast<size_t>(SampleFormat::S32_LE)] = s32;
+    return table;
+}
+
+// Returns the kernel tables this CPU can run, narrowest first
+std::vector<SampleFormatKernelTable> get_supported_sample_format_kernels()
+{
+    const SampleFormatKernels s16 = make_scalar_kernels<SampleFormat::S16_LE>(), s32 = make_scalar_kernels<SampleFormat::S32_LE>();
+    std::vector<SampleFormatKernelTable> supported = {make_kernel_table(s16, s32)};
+#if defined(SAMPLE_FORMAT_X86)
+    if (__builtin_cpu_supports("sse2"))
+    {
+        supported.push_back(make_kernel_table({unpack_s16_sse2, pack_s16_sse2, s16.bytes_per_sample, s16.format_name, "SSE2"},
+                                              {unpack_s32_sse2, pack_s32_sse2, s32.bytes_per_sample, s32.format_name, "SSE2"}));
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        supported.push_back(make_kernel_table({unpack_s16_avx2, pack_s16_avx2, s16.bytes_per_sample, s16.format_name, "AVX2"},
+                                              {unpack_s32_avx2, pack_s32_avx2, s32.bytes_per_sample, s32.format_name, "AVX2"}));
+    }
+#elif defined(SAMPLE_FORMAT_NEON)
+    supported.push_back(make_kernel_table({unpack_s16_neon, pack_s16_neon, s16.bytes_per_sample, s16.format_name, "NEON"},
+                                          {unpack_s32_neon, pack_s32_neon, s32.bytes_per_sample, s32.format_name, "NEON"}));
+#endif
+    return supported;
+}
+
+// Returns the kernels the device conversion of a format runs with
+const SampleFormatKernels &get_sample_format_kernels(SampleFormat format)
+{
+    return select_widest_kernels<SampleFormatKernelTable, get_supported_sample_format_kernels>()[static_cast<size_t>(format)];
+}
+
+// Splits an interleaved float buffer into one buffer per channel, starting at frame position of the channel buffers
+void deinterleave(const float *in, float *const *out, unsigned int channels, size_t nframes, size_t position = 0)
+{
+    for (unsigned int ch = 0; ch < channels; ++ch)
+    {
+        const float *source = in + ch;
+        float *destination = out[ch] + position;
+        for (size_t frame = 0; frame < nframes; ++frame)
+        {
+            destination[frame] = source[frame * channels];
+        }
+    }
+}
+
+// Merges one buffer per channel, starting at frame position, into an interleaved float buffer
+void interleave(const float *const *in, float *out, unsigned int channels, size_t nframes, size_t position = 0)
+{
+    for (unsigned int ch = 0; ch < channels; ++ch)
+    {
+        const float *source = in[ch] + position;
+        float *destination = out + ch;
+        for (size_t frame = 0; frame < nframes; ++frame)
+        {
+            destination[frame * channels] = source[frame];
+        }
+    }
+}
+
+#endif // SAMPLE_FORMAT_H
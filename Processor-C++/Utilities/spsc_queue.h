@@ -0,0 +1,66 @@
+// spsc_queue.h
+// Bounded single-producer/single-consumer lock-free ring buffer. It is used to hand parameter changes from the
+// control side (WebSocket/EventManager/Database threads) to the audio thread without the audio thread ever
+// taking a lock. Only one thread may push and only one thread may pop at a time; callers with several producer
+// threads serialize the producer side themselves.
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+#include <type_traits>
+
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "SpscQueue elements must be trivially copyable so that popping never allocates");
+
+public:
+    // Producer side. Returns false without blocking if the queue is full.
+    bool push(const T &item)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ == Capacity)
+        {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ == Capacity)
+            {
+                return false;
+            }
+        }
+        slots_[tail & (Capacity - 1)] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false without blocking if the queue is empty.
+    bool pop(T &item)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_)
+        {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_)
+            {
+                return false;
+            }
+        }
+        item = slots_[head & (Capacity - 1)];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // Producer and consumer indices live on separate cache lines to avoid false sharing.
+    // Each side also keeps a cached copy of the other side's index to touch the shared line as rarely as possible.
+    alignas(64) std::atomic<size_t> head_{0};
+    size_t tail_cache_ = 0;
+    alignas(64) std::atomic<size_t> tail_{0};
+    size_t head_cache_ = 0;
+    alignas(64) std::array<T, Capacity> slots_{};
+};
+
+#endif // SPSC_QUEUE_H
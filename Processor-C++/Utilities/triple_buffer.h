@@ -0,0 +1,55 @@
+// triple_buffer.h
+// Lock-free triple buffer for handing a complete, rebuilt state from the control side to the audio thread. The producer fills
+// the back slot and publishes it by swapping its index with the pending one; the consumer takes the newest pending slot by
+// swapping its front index in. Neither side ever waits, allocates or sees a half-written slot, and a consumer that falls behind
+// simply skips to the newest state. Only one thread may publish and only one thread may consume at a time; callers with
+// several producer threads serialize the producer side themselves.
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <array>
+#include <cstdint>
+
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Producer side. Returns the slot to fill; it belongs to the producer until publish().
+    T &back() { return slots_[back_]; }
+
+    // Producer side. Makes the back slot the newest state and takes over the slot it replaces. Returns true if that slot
+    // holds a state the consumer skipped, which it never saw.
+    bool publish()
+    {
+        const uint8_t replaced = pending_.exchange(back_ | FRESH, std::memory_order_acq_rel);
+        back_ = replaced & INDEX_MASK;
+        return (replaced & FRESH) != 0;
+    }
+
+    // Consumer side. Returns the newest published state, or nullptr if nothing was published since the last call.
+    // The returned slot stays valid until the next call.
+    const T *consume()
+    {
+        if (!(pending_.load(std::memory_order_relaxed) & FRESH))
+        {
+            return nullptr;
+        }
+        front_ = pending_.exchange(front_, std::memory_order_acq_rel) & INDEX_MASK;
+        return &slots_[front_];
+    }
+
+private:
+    // The pending index carries a flag telling whether it holds a state the consumer has not taken yet
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH = 0x4;
+
+    std::array<T, 3> slots_{};
+    // Each side's own slot index lives on its own cache line, next to the shared pending index
+    alignas(64) uint8_t back_ = 0;
+    alignas(64) std::atomic<uint8_t> pending_{1};
+    alignas(64) uint8_t front_ = 2;
+};
+
+#endif // TRIPLE_BUFFER_H
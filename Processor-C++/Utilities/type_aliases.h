@@ -6,9 +6,25 @@
 #include <vector>
 
 using SetGainCallbackType = std::function<void(const std::string &, const std::string &, unsigned int, double)>;
+using SetDelayCallbackType = std::function<void(const std::string &, const std::string &, unsigned int, double)>;
 using SetMuteCallbackType = std::function<void(const std::string &, const std::string &, unsigned int, bool)>;
 using SetMixerCallbackType = std::function<void(const std::string &, unsigned int, unsigned int, bool)>;
-using SetFilterCallbackType = std::function<void(const std::string &, const std::string &, unsigned int, unsigned int, bool, std::string, double, double, double)>;
+using SetMixerLevelCallbackType = std::function<void(const std::string &, unsigned int, unsigned int, double)>;
+struct MixerCrosspoint;
+using SetMixerSnapshotCallbackType = std::function<void(const std::string &, const std::vector<MixerCrosspoint> &)>;
+using SetBusRouteCallbackType = std::function<void(const std::string &, const std::string &, unsigned int, const std::string &, unsigned int, double)>;
+enum class FilterType;
+using SetFilterCallbackType = std::function<void(const std::string &, const std::string &, unsigned int, unsigned int, bool, FilterType, double, double, double)>;
+enum class EqualizerMode;
+struct FrequencyResponse;
+using GetEqResponseCallbackType = std::function<void(const std::string &, const std::string &, unsigned int, const FrequencyResponse &)>;
+using SetEqualizerModeCallbackType = std::function<void(const std::string &, const std::string &, unsigned int, EqualizerMode, double, double)>;
 using GetMeterCallbackType = std::function<void(const std::string &, const std::string &, const std::vector<double> &)>;
+struct CrossoverSettings;
+using SetCrossoverCallbackType = std::function<void(const std::string &, unsigned int, const CrossoverSettings &)>;
+struct ConvolutionSettings;
+using SetConvolutionCallbackType = std::function<void(const std::string &, const std::string &, unsigned int, const ConvolutionSettings &)>;
+struct DeviceStatsReport;
+using GetDeviceStatsCallbackType = std::function<void(const std::string &, const DeviceStatsReport &)>;
 
 #endif // TYPE_ALIASES_H
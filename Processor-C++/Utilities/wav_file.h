@@ -0,0 +1,143 @@
+// wav_file.h
+// Reader for RIFF WAVE files, used to load the impulse responses of the convolution. Supports 16, 24 and 32-bit integer PCM
+// and 32 and 64-bit float samples, plain or in WAVE_FORMAT_EXTENSIBLE files. Samples are converted to float and normalized
+// to [-1.0, 1.0), like the device samples, and returned one vector per channel.
+
+#ifndef WAV_FILE_H
+#define WAV_FILE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+
+// Samples and sample rate of a WAV file
+struct WavFile
+{
+    unsigned int sample_rate = 0;
+    std::vector<std::vector<float>> channels;
+};
+
+// Function to read a little-endian unsigned integer of size bytes
+inline uint32_t wav_read_le(const unsigned char *bytes, unsigned int size)
+{
+    uint32_t value = 0;
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        value |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+// Function to read the WAV file at path. Returns false and describes the problem in error if the file cannot be read or
+// its sample format is not supported. At most max_frames frames are read; 0 reads the whole file.
+bool read_wav_file(const std::string &path, WavFile &wav, std::string &error, size_t max_frames = 0)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    unsigned char header[12];
+    if (!file.read(reinterpret_cast<char *>(header), sizeof(header)) || std::memcmp(header, "RIFF", 4) != 0 || std::memcmp(header + 8, "WAVE", 4) != 0)
+    {
+        error = path + " is not a WAV file";
+        return false;
+    }
+
+    // Walk the chunks up to the data chunk. The format chunk comes first in every valid file.
+    uint16_t format_tag = 0, channels = 0, bits_per_sample = 0, block_align = 0;
+    uint32_t sample_rate = 0;
+    bool have_format = false;
+    unsigned char chunk_header[8];
+    while (file.read(reinterpret_cast<char *>(chunk_header), sizeof(chunk_header)))
+    {
+        const uint32_t chunk_size = wav_read_le(chunk_header + 4, 4);
+        if (std::memcmp(chunk_header, "fmt ", 4) == 0)
+        {
+            std::vector<unsigned char> format(chunk_size);
+            if (chunk_size < 16 || !file.read(reinterpret_cast<char *>(format.data()), chunk_size))
+            {
+                break;
+            }
+            format_tag = static_cast<uint16_t>(wav_read_le(format.data(), 2));
+            channels = static_cast<uint16_t>(wav_read_le(format.data() + 2, 2));
+            sample_rate = wav_read_le(format.data() + 4, 4);
+            block_align = static_cast<uint16_t>(wav_read_le(format.data() + 12, 2));
+            bits_per_sample = static_cast<uint16_t>(wav_read_le(format.data() + 14, 2));
+            // WAVE_FORMAT_EXTENSIBLE: the actual format tag is the start of the sub-format GUID
+            if (format_tag == 0xFFFE && chunk_size >= 26)
+            {
+                format_tag = static_cast<uint16_t>(wav_read_le(format.data() + 24, 2));
+            }
+            have_format = true;
+        }
+        else if (std::memcmp(chunk_header, "data", 4) == 0)
+        {
+            if (!have_format)
+            {
+                break;
+            }
+            const bool is_pcm = format_tag == 1 && (bits_per_sample == 16 || bits_per_sample == 24 || bits_per_sample == 32);
+            const bool is_float = format_tag == 3 && (bits_per_sample == 32 || bits_per_sample == 64);
+            const unsigned int sample_bytes = bits_per_sample / 8;
+            if ((!is_pcm && !is_float) || channels == 0 || sample_rate == 0 || block_align != channels * sample_bytes)
+            {
+                error = path + " has an unsupported sample format";
+                return false;
+            }
+
+            size_t frames = chunk_size / block_align;
+            if (max_frames != 0 && frames > max_frames)
+            {
+                frames = max_frames;
+            }
+            std::vector<unsigned char> data(frames * block_align);
+            // A data chunk cut short by an interrupted copy still yields the frames that are there
+            file.read(reinterpret_cast<char *>(data.data()), data.size());
+            frames = static_cast<size_t>(file.gcount()) / block_align;
+
+            wav.sample_rate = sample_rate;
+            wav.channels.assign(channels, std::vector<float>(frames));
+            for (size_t frame = 0; frame < frames; ++frame)
+            {
+                for (unsigned int ch = 0; ch < channels; ++ch)
+                {
+                    const unsigned char *bytes = data.data() + frame * block_align + ch * sample_bytes;
+                    float sample;
+                    if (is_float && bits_per_sample == 32)
+                    {
+                        const uint32_t bits = wav_read_le(bytes, 4);
+                        std::memcpy(&sample, &bits, sizeof(sample));
+                    }
+                    else if (is_float)
+                    {
+                        const uint64_t bits = wav_read_le(bytes, 4) | static_cast<uint64_t>(wav_read_le(bytes + 4, 4)) << 32;
+                        double value;
+                        std::memcpy(&value, &bits, sizeof(value));
+                        sample = static_cast<float>(value);
+                    }
+                    else
+                    {
+                        // Sign-extend the integer from the top of a 32-bit word
+                        const int32_t value = static_cast<int32_t>(wav_read_le(bytes, sample_bytes) << (32 - bits_per_sample));
+                        sample = static_cast<float>(value / 2147483648.0);
+                    }
+                    wav.channels[ch][frame] = sample;
+                }
+            }
+            return true;
+        }
+        else
+        {
+            // Chunks are padded to an even size
+            file.seekg(chunk_size + (chunk_size & 1u), std::ios::cur);
+        }
+    }
+    error = path + " has no " + (have_format ? "data" : "format") + " chunk";
+    return false;
+}
+
+#endif // WAV_FILE_H
@@ -0,0 +1,199 @@
+// worker_pool.h
+// Fixed pool of real-time worker threads that help the audio thread with independent per-channel work.
+// The audio thread publishes a job once per stage of a period, takes part in it itself, and waits on the barrier
+// until every task is done. Idle workers spin for a short while, so the next stage of the same period starts without
+// a wake-up, and then sleep on a futex until the next period. The audio thread likewise spins on the barrier before it
+// sleeps, so workers sharing its CPU still get to run. For the shortest periods give every worker a CPU of its own.
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "realtime.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Function to tell the CPU the calling thread is busy waiting
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#endif
+}
+
+class WorkerPool
+{
+public:
+    // Task function, called with the job context and the task index
+    using Task = void (*)(void *context, size_t index);
+
+    // Constructor. Starts worker_count threads configured with config. 0 workers runs every job on the calling thread.
+    WorkerPool(unsigned int worker_count, const RealtimeConfig &config);
+    // Destructor. Stops and joins the workers.
+    ~WorkerPool();
+
+    // Function to run task(context, index) for every index in [0, task_count) on the workers and the calling thread.
+    // Returns once every task has finished. Must only be called from one thread, the audio thread.
+    void run(size_t task_count, Task task, void *context);
+
+    unsigned int get_worker_count() const { return static_cast<unsigned int>(workers.size()); }
+
+private:
+    // Number of busy-wait iterations before an idle worker goes to sleep
+    static constexpr int SPIN_ITERATIONS = 4096;
+
+    // Worker thread entry point
+    void worker_main(unsigned int index);
+    // Function to take tasks of the current job until none are left
+    void execute_tasks();
+
+    RealtimeConfig config;
+    std::vector<std::thread> workers;
+    // Current job, published by incrementing generation
+    Task job_task = nullptr;
+    void *job_context = nullptr;
+    size_t job_task_count = 0;
+    // Job counter the workers wait on, and the number of workers sleeping on it
+    alignas(64) std::atomic<uint32_t> generation{0};
+    std::atomic<unsigned int> sleeping_workers{0};
+    // Index of the next task to take
+    alignas(64) std::atomic<size_t> next_task{0};
+    // Number of workers still working on the current job, and whether the audio thread sleeps on it
+    alignas(64) std::atomic<uint32_t> busy_workers{0};
+    std::atomic<bool> barrier_sleeping{false};
+    std::atomic<bool> running{true};
+};
+
+// Constructor
+WorkerPool::WorkerPool(unsigned int worker_count, const RealtimeConfig &config)
+    : config(config)
+{
+    for (unsigned int i = 0; i < worker_count; ++i)
+    {
+        workers.emplace_back(&WorkerPool::worker_main, this, i);
+    }
+}
+
+// Destructor
+WorkerPool::~WorkerPool()
+{
+    running = false;
+    generation.fetch_add(1);
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&generation), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+// Function to run one job
+void WorkerPool::run(size_t task_count, Task task, void *context)
+{
+    // Nothing to share
+    if (workers.empty() || task_count <= 1)
+    {
+        for (size_t i = 0; i < task_count; ++i)
+        {
+            task(context, i);
+        }
+        return;
+    }
+
+    // Publish the job. The release in the generation increment makes the job visible to every worker that sees it.
+    job_task = task;
+    job_context = context;
+    job_task_count = task_count;
+    next_task.store(0, std::memory_order_relaxed);
+    busy_workers.store(static_cast<uint32_t>(workers.size()), std::memory_order_relaxed);
+    generation.fetch_add(1);
+    // Wake the workers that went to sleep. A worker about to sleep sees the new generation instead, so none is missed.
+    if (sleeping_workers.load() > 0)
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&generation), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    // Take part in the job, then wait on the barrier for the workers, spinning first and sleeping on the futex after that
+    execute_tasks();
+    uint32_t busy;
+    int spins = 0;
+    while ((busy = busy_workers.load(std::memory_order_acquire)) != 0)
+    {
+        if (++spins < SPIN_ITERATIONS)
+        {
+            cpu_relax();
+            continue;
+        }
+        barrier_sleeping.store(true);
+        if (busy_workers.load() != 0)
+        {
+            syscall(SYS_futex, reinterpret_cast<uint32_t *>(&busy_workers), FUTEX_WAIT_PRIVATE, busy, nullptr, nullptr, 0);
+        }
+        barrier_sleeping.store(false);
+    }
+}
+
+// Function to take tasks of the current job until none are left
+void WorkerPool::execute_tasks()
+{
+    size_t index;
+    while ((index = next_task.fetch_add(1, std::memory_order_relaxed)) < job_task_count)
+    {
+        job_task(job_context, index);
+    }
+}
+
+// Worker thread entry point
+void WorkerPool::worker_main(unsigned int index)
+{
+    configure_realtime_thread(config, "Audio worker " + std::to_string(index + 1));
+
+    // Count jobs from the pool's initial generation, not the current one, so a job published while this thread was still
+    // being configured is not missed
+    uint32_t seen = 0;
+    while (true)
+    {
+        // Wait for the next job, spinning first and sleeping on the futex after that
+        uint32_t current;
+        int spins = 0;
+        while ((current = generation.load(std::memory_order_acquire)) == seen)
+        {
+            if (++spins < SPIN_ITERATIONS)
+            {
+                cpu_relax();
+                continue;
+            }
+            sleeping_workers.fetch_add(1);
+            syscall(SYS_futex, reinterpret_cast<uint32_t *>(&generation), FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+            sleeping_workers.fetch_sub(1);
+        }
+        seen = current;
+
+        if (!running)
+        {
+            return;
+        }
+
+        // Work on the job and check in at the barrier. The release hands the results over to the audio thread,
+        // and the last worker wakes it if it went to sleep.
+        execute_tasks();
+        if (busy_workers.fetch_sub(1) == 1 && barrier_sleeping.load())
+        {
+            syscall(SYS_futex, reinterpret_cast<uint32_t *>(&busy_workers), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+        }
+    }
+}
+
+#endif // WORKER_POOL_H
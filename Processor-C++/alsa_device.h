@@ -2,43 +2,220 @@
 // The AlsaDevice class is used to handle audio input and output using the ALSA library.
 // It provides methods for starting and stopping the audio device,
 // as well as reading and writing audio data to and from the device.
+// Audio data is exchanged through ALSA channel areas. In mmap mode the areas point straight into the driver's DMA buffer,
+// so the processing engine converts from and to it without intermediate copies. In read/write mode they point into a
+// bounce buffer that is transferred with snd_pcm_readi/snd_pcm_writei.
+// The sample format of each stream is negotiated with the device, preferring a format the hardware supports natively
+// so that the plug layer does not have to convert every period.
+// Capture and playback are linked so they start and stop together, and the playback buffer is pre-filled with silence
+// before every start, so the distance between the two streams, and with it the round-trip latency, is always the same.
 
 #ifndef ALSA_DEVICE_H
 #define ALSA_DEVICE_H
 
 #include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
 #include <alsa/asoundlib.h>
+#include "Utilities/sample_format.h"
+
+// Device formats the processing engine has conversion kernels for, in order of preference
+constexpr std::array<snd_pcm_format_t, 4> SUPPORTED_FORMATS = {SND_PCM_FORMAT_S32_LE, SND_PCM_FORMAT_S24_3LE, SND_PCM_FORMAT_FLOAT_LE, SND_PCM_FORMAT_S16_LE};
+
+// Function to get the conversion kernel format for an ALSA format. Returns false for formats without kernels.
+bool sample_format_from_alsa(snd_pcm_format_t alsa_format, SampleFormat &format)
+{
+    switch (alsa_format)
+    {
+    case SND_PCM_FORMAT_S16_LE:
+        format = SampleFormat::S16_LE;
+        return true;
+    case SND_PCM_FORMAT_S24_3LE:
+        format = SampleFormat::S24_3LE;
+        return true;
+    case SND_PCM_FORMAT_S32_LE:
+        format = SampleFormat::S32_LE;
+        return true;
+    case SND_PCM_FORMAT_FLOAT_LE:
+        format = SampleFormat::FLOAT_LE;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Function to parse a format name ("auto", "s16", "s24_3", "s32" or "float"). "auto" gives SND_PCM_FORMAT_UNKNOWN.
+bool parse_format_name(const std::string &name, snd_pcm_format_t &format)
+{
+    if (name == "auto")
+        format = SND_PCM_FORMAT_UNKNOWN;
+    else if (name == "s16")
+        format = SND_PCM_FORMAT_S16_LE;
+    else if (name == "s24_3")
+        format = SND_PCM_FORMAT_S24_3LE;
+    else if (name == "s32")
+        format = SND_PCM_FORMAT_S32_LE;
+    else if (name == "float")
+        format = SND_PCM_FORMAT_FLOAT_LE;
+    else
+        return false;
+    return true;
+}
+
+// How audio data is exchanged with the driver
+enum class AlsaAccessMode
+{
+    ReadWrite,
+    Mmap
+};
+
+// Function to parse an access mode name ("rw" or "mmap")
+bool parse_access_mode(const std::string &name, AlsaAccessMode &mode)
+{
+    if (name == "rw")
+    {
+        mode = AlsaAccessMode::ReadWrite;
+        return true;
+    }
+    if (name == "mmap")
+    {
+        mode = AlsaAccessMode::Mmap;
+        return true;
+    }
+    return false;
+}
+
+// Function to get the address of the sample at frame offset in a channel area
+char *area_sample_address(const snd_pcm_channel_area_t &area, snd_pcm_uframes_t offset)
+{
+    return static_cast<char *>(area.addr) + (area.first + offset * area.step) / 8;
+}
+
+// Function to check if the channel areas describe one interleaved buffer holding all channels, with sample_bits per sample
+bool areas_interleaved(const snd_pcm_channel_area_t *areas, unsigned int channels, unsigned int sample_bits)
+{
+    for (unsigned int ch = 0; ch < channels; ++ch)
+    {
+        if (areas[ch].addr != areas[0].addr || areas[ch].first != areas[0].first + ch * sample_bits || areas[ch].step != channels * sample_bits)
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
 class AlsaDevice
 {
 public:
-    AlsaDevice(const char *audio_interface, unsigned int input_channels, unsigned int output_channels, unsigned int rate, snd_pcm_format_t format);
+    // format selects the sample format of both streams. SND_PCM_FORMAT_UNKNOWN negotiates it with the device.
+    AlsaDevice(const char *audio_interface, unsigned int input_channels, unsigned int output_channels, unsigned int rate, snd_pcm_format_t format,
+               snd_pcm_uframes_t period_size, unsigned int periods, AlsaAccessMode access_mode = AlsaAccessMode::ReadWrite);
     ~AlsaDevice();
 
-    void start();
+    // Opens, configures and links both streams, pre-fills playback with silence and starts them.
+    // Returns false if the device could not be configured.
+    bool start();
     void stop();
 
-    snd_pcm_sframes_t read(void *buffer, snd_pcm_uframes_t size);
-    snd_pcm_sframes_t write(void *buffer, snd_pcm_uframes_t size);
+    // Function to sleep until a full period has been captured and the playback buffer has room for it.
+    // Also wakes up when stop_fd becomes readable. Returns 1 when a period is ready, 0 when woken through stop_fd,
+    // or a negative error code, e.g. -EPIPE after an xrun, which is handed to recover().
+    int wait_for_period(int stop_fd);
+    // Function to bring both streams back after an error: drops them, pre-fills playback with silence and restarts them together.
+    // A suspended device is waited for up to RESUME_TIMEOUT_MS, or until stop_fd becomes readable, which returns -EINTR.
+    // Returns 0 on success or a negative error code if the device cannot be recovered.
+    int recover(int err, int stop_fd);
+
+    // Read functions. capture_begin returns how many of up to size captured frames can be accessed contiguously through areas
+    // starting at frame offset. capture_commit releases them after they were consumed. Neither blocks after wait_for_period().
+    snd_pcm_sframes_t capture_begin(const snd_pcm_channel_area_t *&areas, snd_pcm_uframes_t &offset, snd_pcm_uframes_t size);
+    snd_pcm_sframes_t capture_commit(snd_pcm_uframes_t offset, snd_pcm_uframes_t frames);
+    // Write functions. playback_begin returns how many of up to size frames can be written contiguously through areas
+    // starting at frame offset. playback_commit queues them for playback.
+    snd_pcm_sframes_t playback_begin(const snd_pcm_channel_area_t *&areas, snd_pcm_uframes_t &offset, snd_pcm_uframes_t size);
+    snd_pcm_sframes_t playback_commit(snd_pcm_uframes_t offset, snd_pcm_uframes_t frames);
+
+    // Function to get the current state of both streams, e.g. to tell which one ran into an xrun
+    void get_stream_states(snd_pcm_state_t &capture_state, snd_pcm_state_t &playback_state) const;
+
+    // Negotiated configuration, valid after start()
+    snd_pcm_uframes_t get_period_size() const { return period_size; }
+    snd_pcm_uframes_t get_buffer_size() const { return buffer_size; }
+    snd_pcm_format_t get_capture_format() const { return capture_format; }
+    snd_pcm_format_t get_playback_format() const { return playback_format; }
+    unsigned int get_rate() const { return rate; }
+    // Prints the negotiated period and buffer sizes of both streams and the resulting round-trip latency
+    void print_configuration() const;
 
 private:
+    // Longest wait for a suspended device to resume, and the interval between resume attempts
+    static constexpr int RESUME_TIMEOUT_MS = 3000;
+    static constexpr int RESUME_RETRY_MS = 10;
+
+    // Opens one stream, without the plug layer's format conversion where possible
+    int open_stream(snd_pcm_t *&handle, snd_pcm_stream_t stream);
+    // Configures the hardware and software parameters of one stream, in that order
+    bool configure_stream(snd_pcm_t *handle, unsigned int channels, snd_pcm_access_t &negotiated_access, snd_pcm_format_t &negotiated_format,
+                          snd_pcm_uframes_t &negotiated_period, snd_pcm_uframes_t &negotiated_buffer);
+    // Sets up the bounce buffer and the channel areas describing it for a stream using read/write access
+    void setup_bounce_buffer(std::vector<char> &buffer, std::vector<snd_pcm_channel_area_t> &areas, unsigned int channels, snd_pcm_format_t format,
+                             snd_pcm_uframes_t frames);
+    // Fills the free part of the playback buffer with silence and starts both streams
+    int start_streams();
+    // Mmap begin and commit functions shared by both streams
+    snd_pcm_sframes_t mmap_begin(snd_pcm_t *handle, const snd_pcm_channel_area_t *&areas, snd_pcm_uframes_t &offset, snd_pcm_uframes_t size);
+    snd_pcm_sframes_t mmap_commit(snd_pcm_t *handle, snd_pcm_uframes_t offset, snd_pcm_uframes_t frames);
+
     const char *audio_interface;
     snd_pcm_t *capture_handle;
     snd_pcm_t *playback_handle;
-    snd_pcm_hw_params_t *hw_params;
-    snd_pcm_format_t format;
+    // Requested sample format, SND_PCM_FORMAT_UNKNOWN to negotiate it, and the format negotiated for each stream
+    snd_pcm_format_t requested_format;
+    snd_pcm_format_t capture_format = SND_PCM_FORMAT_UNKNOWN;
+    snd_pcm_format_t playback_format = SND_PCM_FORMAT_UNKNOWN;
     unsigned int rate;
     unsigned int input_channels;
     unsigned int output_channels;
-    snd_pcm_uframes_t frames;
+    // Requested period size in frames and number of periods per buffer
+    snd_pcm_uframes_t requested_period_size;
+    unsigned int requested_periods;
+    // Negotiated period and buffer sizes in frames. The capture period is the processing block size.
+    snd_pcm_uframes_t period_size = 0;
+    snd_pcm_uframes_t buffer_size = 0;
+    snd_pcm_uframes_t playback_period_size = 0;
+    snd_pcm_uframes_t playback_buffer_size = 0;
+    // Requested access mode and the access negotiated for each stream
+    AlsaAccessMode access_mode;
+    snd_pcm_access_t capture_access = SND_PCM_ACCESS_RW_INTERLEAVED;
+    snd_pcm_access_t playback_access = SND_PCM_ACCESS_RW_INTERLEAVED;
+    // Bounce buffers and their channel areas, used by streams in read/write access
+    std::vector<char> capture_bounce_buffer;
+    std::vector<char> playback_bounce_buffer;
+    std::vector<snd_pcm_channel_area_t> capture_bounce_areas;
+    std::vector<snd_pcm_channel_area_t> playback_bounce_areas;
+    // True if the two streams are linked and start and stop together
+    bool linked = false;
+    // Poll descriptors: the stop descriptor first, then those of the capture and of the playback stream
+    std::vector<pollfd> poll_descriptors;
+    unsigned int capture_poll_count = 0;
+    unsigned int playback_poll_count = 0;
 };
 
-AlsaDevice::AlsaDevice(const char *audio_interface, unsigned int input_channels, unsigned int output_channels, unsigned int rate, snd_pcm_format_t format)
+AlsaDevice::AlsaDevice(const char *audio_interface, unsigned int input_channels, unsigned int output_channels, unsigned int rate, snd_pcm_format_t format,
+                       snd_pcm_uframes_t period_size, unsigned int periods, AlsaAccessMode access_mode)
     : audio_interface(audio_interface),
+      access_mode(access_mode),
       input_channels(input_channels),
       output_channels(output_channels),
       rate(rate),
-      format(format),
+      requested_format(format),
+      requested_period_size(period_size),
+      requested_periods(periods),
       capture_handle(nullptr),
       playback_handle(nullptr)
 {
@@ -50,66 +227,408 @@ AlsaDevice::~AlsaDevice()
 }
 
 // Open capture_handle and playback_handle, configure ALSA
-void AlsaDevice::start()
+bool AlsaDevice::start()
 {
     int err;
 
-    // Allocate memory for hardware parameters structure.
-    snd_pcm_hw_params_alloca(&hw_params);
-
     // Open the audio capture device using ALSA's snd_pcm_open function.
     // If it fails, print an error message and stop processing.
-    if ((err = snd_pcm_open(&capture_handle, audio_interface, SND_PCM_STREAM_CAPTURE, 0)) < 0)
+    if ((err = open_stream(capture_handle, SND_PCM_STREAM_CAPTURE)) < 0)
     {
         std::cerr << "Cannot open audio interface for capture: " << snd_strerror(err) << std::endl;
         stop();
+        return false;
     }
 
     // Open the audio playback device using ALSA's snd_pcm_open function.
     // If it fails, print an error message and stop processing.
-    if ((err = snd_pcm_open(&playback_handle, audio_interface, SND_PCM_STREAM_PLAYBACK, 0)) < 0)
+    if ((err = open_stream(playback_handle, SND_PCM_STREAM_PLAYBACK)) < 0)
     {
         std::cerr << "Cannot open audio interface for playback: " << snd_strerror(err) << std::endl;
         stop();
+        return false;
+    }
+
+    // Configure both streams
+    if (!configure_stream(capture_handle, input_channels, capture_access, capture_format, period_size, buffer_size) ||
+        !configure_stream(playback_handle, output_channels, playback_access, playback_format, playback_period_size, playback_buffer_size))
+    {
+        stop();
+        return false;
+    }
+
+    // Streams without mmap access go through bounce buffers of one period
+    if (capture_access == SND_PCM_ACCESS_RW_INTERLEAVED)
+    {
+        setup_bounce_buffer(capture_bounce_buffer, capture_bounce_areas, input_channels, capture_format, period_size);
+    }
+    if (playback_access == SND_PCM_ACCESS_RW_INTERLEAVED)
+    {
+        setup_bounce_buffer(playback_bounce_buffer, playback_bounce_areas, output_channels, playback_format, period_size);
+    }
+
+    if (playback_period_size != period_size)
+    {
+        std::cerr << "Warning: capture and playback periods differ (" << period_size << " / " << playback_period_size << " frames)" << std::endl;
+    }
+
+    // Link the streams so they are started, stopped and prepared together. Not every device supports this;
+    // unlinked streams are started one after the other.
+    if ((err = snd_pcm_link(capture_handle, playback_handle)) < 0)
+    {
+        std::cerr << "Warning: cannot link capture and playback streams: " << snd_strerror(err) << std::endl;
+    }
+    linked = err == 0;
+
+    // Reserve the poll descriptors of both streams, plus one for the stop descriptor
+    int capture_count = snd_pcm_poll_descriptors_count(capture_handle);
+    int playback_count = snd_pcm_poll_descriptors_count(playback_handle);
+    if (capture_count <= 0 || playback_count <= 0)
+    {
+        std::cerr << "Cannot get the poll descriptors of the audio interface" << std::endl;
+        stop();
+        return false;
+    }
+    capture_poll_count = capture_count;
+    playback_poll_count = playback_count;
+    poll_descriptors.assign(1 + capture_poll_count + playback_poll_count, pollfd{});
+
+    if ((err = start_streams()) < 0)
+    {
+        std::cerr << "Cannot start the audio interface: " << snd_strerror(err) << std::endl;
+        stop();
+        return false;
+    }
+
+    return true;
+}
+
+// Fill the free part of the playback buffer with silence, then start both streams.
+// Playback then always runs one buffer ahead of capture, which keeps the round-trip latency fixed.
+int AlsaDevice::start_streams()
+{
+    int err;
+    snd_pcm_sframes_t avail = snd_pcm_avail_update(playback_handle);
+    if (avail < 0)
+    {
+        return avail;
+    }
+    snd_pcm_uframes_t remaining = avail;
+    while (remaining > 0)
+    {
+        const snd_pcm_channel_area_t *areas;
+        snd_pcm_uframes_t offset;
+        snd_pcm_sframes_t frames = playback_begin(areas, offset, remaining);
+        if (frames <= 0)
+        {
+            return frames < 0 ? frames : -EIO;
+        }
+        snd_pcm_areas_silence(areas, offset, output_channels, frames, playback_format);
+        if ((frames = playback_commit(offset, frames)) < 0)
+        {
+            return frames;
+        }
+        remaining -= frames;
+    }
+
+    // Starting the capture stream also starts playback if the streams are linked
+    if ((err = snd_pcm_start(capture_handle)) < 0)
+    {
+        return err;
+    }
+    if (!linked && (err = snd_pcm_start(playback_handle)) < 0)
+    {
+        return err;
+    }
+    return 0;
+}
+
+// Wait for the next period on both streams, or for the stop descriptor
+int AlsaDevice::wait_for_period(int stop_fd)
+{
+    // The streams may change their descriptors' events between calls, so they are fetched again every time
+    pollfd *capture_descriptors = poll_descriptors.data() + 1;
+    pollfd *playback_descriptors = capture_descriptors + capture_poll_count;
+    poll_descriptors[0] = pollfd{stop_fd, POLLIN, 0};
+    snd_pcm_poll_descriptors(capture_handle, capture_descriptors, capture_poll_count);
+    snd_pcm_poll_descriptors(playback_handle, playback_descriptors, playback_poll_count);
+
+    while (true)
+    {
+        // Time out after a second, as a running stream delivers a period much more often than that
+        int ready = poll(poll_descriptors.data(), poll_descriptors.size(), 1000);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -errno;
+        }
+        if (ready == 0)
+        {
+            return -EIO;
+        }
+        if (poll_descriptors[0].revents & POLLIN)
+        {
+            return 0;
+        }
+
+        // Translate the descriptors' events back to stream events. POLLERR means the stream left the running state.
+        unsigned short capture_events = 0, playback_events = 0;
+        snd_pcm_poll_descriptors_revents(capture_handle, capture_descriptors, capture_poll_count, &capture_events);
+        snd_pcm_poll_descriptors_revents(playback_handle, playback_descriptors, playback_poll_count, &playback_events);
+
+        snd_pcm_sframes_t capture_avail = snd_pcm_avail_update(capture_handle);
+        snd_pcm_sframes_t playback_avail = snd_pcm_avail_update(playback_handle);
+        if (capture_avail < 0)
+        {
+            return capture_avail;
+        }
+        if (playback_avail < 0)
+        {
+            return playback_avail;
+        }
+        if ((capture_events | playback_events) & POLLERR)
+        {
+            return -EPIPE;
+        }
+        const bool capture_ready = capture_avail >= static_cast<snd_pcm_sframes_t>(period_size);
+        const bool playback_ready = playback_avail >= static_cast<snd_pcm_sframes_t>(period_size);
+        if (capture_ready && playback_ready)
+        {
+            return 1;
+        }
+
+        // A ready stream's descriptors stay readable, so poll() would return at once until the other stream catches up.
+        // Only the stream that is behind is waited for from here on; poll() still reports errors on every descriptor.
+        for (unsigned int i = 0; capture_ready && i < capture_poll_count; ++i)
+        {
+            capture_descriptors[i].events = 0;
+        }
+        for (unsigned int i = 0; playback_ready && i < playback_poll_count; ++i)
+        {
+            playback_descriptors[i].events = 0;
+        }
+    }
+}
+
+// Get the current state of both streams
+void AlsaDevice::get_stream_states(snd_pcm_state_t &capture_state, snd_pcm_state_t &playback_state) const
+{
+    capture_state = capture_handle ? snd_pcm_state(capture_handle) : SND_PCM_STATE_DISCONNECTED;
+    playback_state = playback_handle ? snd_pcm_state(playback_handle) : SND_PCM_STATE_DISCONNECTED;
+}
+
+// Restart both streams after an xrun, a suspend or a stalled device
+int AlsaDevice::recover(int err, int stop_fd)
+{
+    // Wait for a suspended device to wake up again. Resuming capture also resumes playback if the streams are linked.
+    // A stream that cannot resume, or does not in time, is prepared again below.
+    if (err == -ESTRPIPE)
+    {
+        bool capture_suspended = true, playback_suspended = !linked;
+        pollfd stop_descriptor{stop_fd, POLLIN, 0};
+        for (int waited_ms = 0; waited_ms < RESUME_TIMEOUT_MS; waited_ms += RESUME_RETRY_MS)
+        {
+            capture_suspended = capture_suspended && snd_pcm_resume(capture_handle) == -EAGAIN;
+            playback_suspended = playback_suspended && snd_pcm_resume(playback_handle) == -EAGAIN;
+            if (!capture_suspended && !playback_suspended)
+            {
+                break;
+            }
+            if (poll(&stop_descriptor, 1, RESUME_RETRY_MS) > 0)
+            {
+                return -EINTR;
+            }
+        }
     }
 
-    // Create handles vector to iterate over both handles
-    std::initializer_list<snd_pcm_t *> handles = {capture_handle, playback_handle};
-    // Set capture and playback parameters
-    for (snd_pcm_t *handle : handles)
+    // Stop both streams, discarding what is left in their buffers, and prepare them for a new start.
+    // Linked streams are dropped and prepared together, but the calls are harmless for a stream that is already prepared.
+    snd_pcm_drop(capture_handle);
+    snd_pcm_drop(playback_handle);
+    if ((err = snd_pcm_prepare(capture_handle)) < 0 || (err = snd_pcm_prepare(playback_handle)) < 0)
+    {
+        return err;
+    }
+    return start_streams();
+}
+
+// Open one stream. With a negotiated format the stream is first opened without the plug layer's format conversion,
+// so only the formats the hardware supports natively are offered. If the engine supports none of them,
+// the stream is reopened with conversion.
+int AlsaDevice::open_stream(snd_pcm_t *&handle, snd_pcm_stream_t stream)
+{
+    int err;
+    if (requested_format == SND_PCM_FORMAT_UNKNOWN)
     {
-        // Get the default hardware parameters.
+        if ((err = snd_pcm_open(&handle, audio_interface, stream, SND_PCM_NO_AUTO_FORMAT)) < 0)
+        {
+            return err;
+        }
+
+        snd_pcm_hw_params_t *hw_params;
+        snd_pcm_hw_params_alloca(&hw_params);
         snd_pcm_hw_params_any(handle, hw_params);
-        // Set access type to interleaved.
-        snd_pcm_hw_params_set_access(handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED);
-        // Set audio format (e.g. SND_PCM_FORMAT_S16_LE for 16-bit signed little-endian).
-        snd_pcm_hw_params_set_format(handle, hw_params, format);
-        // Set the sample rate near the requested rate.
-        snd_pcm_hw_params_set_rate_near(handle, hw_params, &rate, 0);
+        for (snd_pcm_format_t format : SUPPORTED_FORMATS)
+        {
+            if (snd_pcm_hw_params_test_format(handle, hw_params, format) == 0)
+            {
+                return 0;
+            }
+        }
 
-        // Set the correct number of channels for each handle
-        if (handle == capture_handle)
+        std::cerr << "Warning: no native " << (stream == SND_PCM_STREAM_CAPTURE ? "capture" : "playback")
+                  << " format is supported, the plug layer will convert samples" << std::endl;
+        snd_pcm_close(handle);
+        handle = nullptr;
+    }
+    return snd_pcm_open(&handle, audio_interface, stream, 0);
+}
+
+// Configure one stream. Every hardware parameter, including the period and buffer sizes, has to be chosen before
+// snd_pcm_hw_params() installs the configuration; the software parameters are set afterwards.
+bool AlsaDevice::configure_stream(snd_pcm_t *handle, unsigned int channels, snd_pcm_access_t &negotiated_access, snd_pcm_format_t &negotiated_format,
+                                  snd_pcm_uframes_t &negotiated_period, snd_pcm_uframes_t &negotiated_buffer)
+{
+    int err;
+    const char *stream_name = handle == capture_handle ? "capture" : "playback";
+
+    // Allocate memory for hardware parameters structure.
+    snd_pcm_hw_params_t *hw_params;
+    snd_pcm_hw_params_alloca(&hw_params);
+
+    // Get the default hardware parameters.
+    snd_pcm_hw_params_any(handle, hw_params);
+    // Choose the access type. In mmap mode prefer interleaved, then non-interleaved mmap access,
+    // and fall back to interleaved read/write access for devices that support neither.
+    negotiated_access = SND_PCM_ACCESS_RW_INTERLEAVED;
+    if (access_mode == AlsaAccessMode::Mmap)
+    {
+        if (snd_pcm_hw_params_test_access(handle, hw_params, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0)
         {
-            snd_pcm_hw_params_set_channels(handle, hw_params, input_channels);
+            negotiated_access = SND_PCM_ACCESS_MMAP_INTERLEAVED;
+        }
+        else if (snd_pcm_hw_params_test_access(handle, hw_params, SND_PCM_ACCESS_MMAP_NONINTERLEAVED) == 0)
+        {
+            negotiated_access = SND_PCM_ACCESS_MMAP_NONINTERLEAVED;
         }
         else
         {
-            snd_pcm_hw_params_set_channels(handle, hw_params, output_channels);
+            std::cerr << "Warning: " << stream_name << " does not support mmap access, falling back to read/write access" << std::endl;
         }
+    }
+    if ((err = snd_pcm_hw_params_set_access(handle, hw_params, negotiated_access)) < 0)
+    {
+        std::cerr << "Cannot set " << stream_name << " access type: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    // Set audio format (e.g. SND_PCM_FORMAT_S32_LE for 32-bit signed little-endian).
+    // Without a requested format, take the first supported format in order of preference.
+    negotiated_format = requested_format;
+    if (negotiated_format == SND_PCM_FORMAT_UNKNOWN)
+    {
+        for (snd_pcm_format_t format : SUPPORTED_FORMATS)
+        {
+            if (snd_pcm_hw_params_test_format(handle, hw_params, format) == 0)
+            {
+                negotiated_format = format;
+                break;
+            }
+        }
+    }
+    if ((err = snd_pcm_hw_params_set_format(handle, hw_params, negotiated_format)) < 0)
+    {
+        std::cerr << "Cannot set " << stream_name << " sample format: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    // Set the correct number of channels for the stream
+    if ((err = snd_pcm_hw_params_set_channels(handle, hw_params, channels)) < 0)
+    {
+        std::cerr << "Cannot set " << stream_name << " channel count to " << channels << ": " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    // Set the sample rate. The filters, delays and impulse responses are all designed for the requested rate, so a stream
+    // that cannot run at exactly that rate is not used.
+    if ((err = snd_pcm_hw_params_set_rate(handle, hw_params, rate, 0)) < 0)
+    {
+        std::cerr << "Cannot set " << stream_name << " rate to " << rate << " Hz: " << snd_strerror(err) << std::endl;
+        return false;
+    }
 
-        // Apply the hardware parameters to the device.
-        snd_pcm_hw_params(handle, hw_params);
-        // Prepare the device for operation.
-        snd_pcm_prepare(handle);
+    // Set the period size and the number of periods near the requested values.
+    snd_pcm_uframes_t period = requested_period_size;
+    unsigned int periods = requested_periods;
+    if ((err = snd_pcm_hw_params_set_period_size_near(handle, hw_params, &period, nullptr)) < 0)
+    {
+        std::cerr << "Cannot set " << stream_name << " period size: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+    if ((err = snd_pcm_hw_params_set_periods_near(handle, hw_params, &periods, nullptr)) < 0)
+    {
+        std::cerr << "Cannot set " << stream_name << " period count: " << snd_strerror(err) << std::endl;
+        return false;
+    }
 
-        // Set buffer and period sizes for the device.
-        snd_pcm_hw_params_set_buffer_size_near(handle, hw_params, &frames);
-        snd_pcm_hw_params_set_period_size_near(handle, hw_params, &frames, nullptr);
+    // Apply the hardware parameters to the device.
+    if ((err = snd_pcm_hw_params(handle, hw_params)) < 0)
+    {
+        std::cerr << "Cannot apply " << stream_name << " hardware parameters: " << snd_strerror(err) << std::endl;
+        return false;
     }
+
+    // Read back what the driver actually chose
+    snd_pcm_hw_params_get_period_size(hw_params, &negotiated_period, nullptr);
+    snd_pcm_hw_params_get_buffer_size(hw_params, &negotiated_buffer);
+    snd_pcm_hw_params_get_rate(hw_params, &rate, nullptr);
+
+    // Set the software parameters: wake up once a full period is available, and never start on a read or write.
+    // Both streams are started explicitly by start_streams() once playback has been pre-filled.
+    snd_pcm_sw_params_t *sw_params;
+    snd_pcm_sw_params_alloca(&sw_params);
+    snd_pcm_sw_params_current(handle, sw_params);
+    snd_pcm_uframes_t boundary;
+    snd_pcm_sw_params_get_boundary(sw_params, &boundary);
+    snd_pcm_sw_params_set_avail_min(handle, sw_params, negotiated_period);
+    snd_pcm_sw_params_set_start_threshold(handle, sw_params, boundary);
+    if ((err = snd_pcm_sw_params(handle, sw_params)) < 0)
+    {
+        std::cerr << "Cannot apply " << stream_name << " software parameters: " << snd_strerror(err) << std::endl;
+        return false;
+    }
+
+    // Prepare the device for operation.
+    snd_pcm_prepare(handle);
+
+    return true;
+}
+
+// Print the negotiated configuration and the resulting latency.
+// A captured frame waits up to one capture period before it is read, and then the whole pre-filled playback buffer before it is played.
+void AlsaDevice::print_configuration() const
+{
+    auto to_ms = [this](snd_pcm_uframes_t frames)
+    { return 1000.0 * static_cast<double>(frames) / static_cast<double>(rate); };
+
+    auto access_name = [](snd_pcm_access_t access)
+    { return access == SND_PCM_ACCESS_MMAP_INTERLEAVED ? "mmap interleaved" : access == SND_PCM_ACCESS_MMAP_NONINTERLEAVED ? "mmap non-interleaved" : "read/write interleaved"; };
+
+    std::cout << "ALSA configuration at " << rate << " Hz:" << std::endl;
+    std::cout << "  capture:  " << snd_pcm_format_name(capture_format) << ", " << access_name(capture_access) << ", period " << period_size << " frames (" << to_ms(period_size) << " ms), buffer " << buffer_size
+              << " frames (" << to_ms(buffer_size) << " ms)" << std::endl;
+    std::cout << "  playback: " << snd_pcm_format_name(playback_format) << ", " << access_name(playback_access) << ", period " << playback_period_size << " frames (" << to_ms(playback_period_size) << " ms), buffer " << playback_buffer_size
+              << " frames (" << to_ms(playback_buffer_size) << " ms)" << std::endl;
+    std::cout << "  round-trip latency: " << to_ms(period_size + playback_buffer_size) << " ms, streams " << (linked ? "linked" : "not linked") << std::endl;
 }
 
 void AlsaDevice::stop()
 {
+    if (linked)
+    {
+        snd_pcm_unlink(capture_handle);
+        linked = false;
+    }
     if (capture_handle)
     {
         snd_pcm_close(capture_handle);
@@ -123,31 +642,106 @@ void AlsaDevice::stop()
     }
 }
 
-// Read and write functions
-snd_pcm_sframes_t AlsaDevice::read(void *buffer, snd_pcm_uframes_t size)
+// Set up a bounce buffer of frames interleaved frames and the channel areas describing it
+void AlsaDevice::setup_bounce_buffer(std::vector<char> &buffer, std::vector<snd_pcm_channel_area_t> &areas, unsigned int channels, snd_pcm_format_t format,
+                                     snd_pcm_uframes_t frames)
 {
-    // Read audio data from the capture device to the buffer
-    snd_pcm_sframes_t read_frames = snd_pcm_readi(capture_handle, buffer, size);
-    // If reading fails, try to recover the capture device.
-    if (read_frames < 0)
+    unsigned int sample_bits = snd_pcm_format_physical_width(format);
+    buffer.assign(frames * channels * sample_bits / 8, 0);
+    areas.resize(channels);
+    for (unsigned int ch = 0; ch < channels; ++ch)
     {
-        read_frames = snd_pcm_recover(capture_handle, read_frames, 0);
+        areas[ch].addr = buffer.data();
+        areas[ch].first = ch * sample_bits;
+        areas[ch].step = channels * sample_bits;
     }
+}
+
+// Read functions
+snd_pcm_sframes_t AlsaDevice::capture_begin(const snd_pcm_channel_area_t *&areas, snd_pcm_uframes_t &offset, snd_pcm_uframes_t size)
+{
+    if (capture_access != SND_PCM_ACCESS_RW_INTERLEAVED)
+    {
+        return mmap_begin(capture_handle, areas, offset, size);
+    }
+
+    // Read audio data from the capture device to the bounce buffer
+    size = std::min(size, period_size);
+    snd_pcm_sframes_t read_frames = snd_pcm_readi(capture_handle, capture_bounce_buffer.data(), size);
+    areas = capture_bounce_areas.data();
+    offset = 0;
     // Return the number of frames read.
     return read_frames;
 }
 
-snd_pcm_sframes_t AlsaDevice::write(void *buffer, snd_pcm_uframes_t size)
+snd_pcm_sframes_t AlsaDevice::capture_commit(snd_pcm_uframes_t offset, snd_pcm_uframes_t frames)
 {
-    // Write audio data from the buffer to the playback device
-    snd_pcm_sframes_t write_frames = snd_pcm_writei(playback_handle, buffer, size);
-    // If writing fails, try to recover the playback device.
-    if (write_frames < 0)
+    // The bounce buffer was already consumed from the device by snd_pcm_readi
+    if (capture_access == SND_PCM_ACCESS_RW_INTERLEAVED)
     {
-        write_frames = snd_pcm_recover(playback_handle, write_frames, 0);
+        return frames;
     }
+    return mmap_commit(capture_handle, offset, frames);
+}
+
+// Write functions
+snd_pcm_sframes_t AlsaDevice::playback_begin(const snd_pcm_channel_area_t *&areas, snd_pcm_uframes_t &offset, snd_pcm_uframes_t size)
+{
+    if (playback_access != SND_PCM_ACCESS_RW_INTERLEAVED)
+    {
+        return mmap_begin(playback_handle, areas, offset, size);
+    }
+
+    // The data is written into the bounce buffer and transferred by playback_commit
+    areas = playback_bounce_areas.data();
+    offset = 0;
+    return std::min(size, period_size);
+}
+
+snd_pcm_sframes_t AlsaDevice::playback_commit(snd_pcm_uframes_t offset, snd_pcm_uframes_t frames)
+{
+    if (playback_access != SND_PCM_ACCESS_RW_INTERLEAVED)
+    {
+        return mmap_commit(playback_handle, offset, frames);
+    }
+
+    // Write audio data from the bounce buffer to the playback device
+    snd_pcm_sframes_t write_frames = snd_pcm_writei(playback_handle, playback_bounce_buffer.data(), frames);
     // Return the number of frames written.
     return write_frames;
 }
 
+// Map up to size frames of the DMA buffer. Returns the number of contiguous frames mapped, which is less than size
+// where the ring buffer wraps around or fewer frames are available, or a negative error code.
+snd_pcm_sframes_t AlsaDevice::mmap_begin(snd_pcm_t *handle, const snd_pcm_channel_area_t *&areas, snd_pcm_uframes_t &offset, snd_pcm_uframes_t size)
+{
+    snd_pcm_sframes_t avail = snd_pcm_avail_update(handle);
+    if (avail < 0)
+    {
+        return avail;
+    }
+    snd_pcm_uframes_t frames = std::min(size, static_cast<snd_pcm_uframes_t>(avail));
+    if (frames == 0)
+    {
+        return 0;
+    }
+    int err;
+    if ((err = snd_pcm_mmap_begin(handle, &areas, &offset, &frames)) < 0)
+    {
+        return err;
+    }
+    return frames;
+}
+
+// Hand mapped frames back to the driver. A short commit means the stream ran into an xrun.
+snd_pcm_sframes_t AlsaDevice::mmap_commit(snd_pcm_t *handle, snd_pcm_uframes_t offset, snd_pcm_uframes_t frames)
+{
+    snd_pcm_sframes_t committed = snd_pcm_mmap_commit(handle, offset, frames);
+    if (committed >= 0 && static_cast<snd_pcm_uframes_t>(committed) != frames)
+    {
+        return -EPIPE;
+    }
+    return committed;
+}
+
 #endif // ALSA_DEVICE_H
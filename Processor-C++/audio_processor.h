@@ -1,7 +1,7 @@
 // audio_processor.h
 // Main audio processor class. This class is responsible for reading audio data from the ALSA device, processing it, and writing it back to the ALSA device.
 // It also provides functions to set the volume and mute of each channel,
-// as well as to set the routing of the input channels to the output channels and to set the filters of each channel.
+// as well as to set the routing of the input channels to the output channels, directly or through buses, and to set the filters of each channel.
 
 #ifndef AUDIO_PROCESSOR_H
 #define AUDIO_PROCESSOR_H
@@ -10,96 +10,235 @@
 #include <vector>
 #include <array>
 #include <thread>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
 #include <algorithm> // for std::clamp
+#include <chrono>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include "alsa_device.h"
 #include "AudioEffects/biquad_filter.h"
 #include "AudioEffects/gain.h"
 #include "AudioEffects/mute.h"
 #include "AudioEffects/mixer.h"
+#include "AudioEffects/bus.h"
 #include "AudioEffects/meter.h"
 #include "AudioEffects/equalizer.h"
+#include "AudioEffects/biquad_bank.h"
+#include "AudioEffects/crossover.h"
+#include "AudioEffects/convolver.h"
+#include "AudioEffects/delay.h"
 #include "Utilities/event_manager.h"
 #include "Utilities/type_aliases.h"
+#include "Utilities/sample_format.h"
+#include "Utilities/realtime.h"
+#include "Utilities/device_stats.h"
+#include "Utilities/worker_pool.h"
 
 class AudioProcessor
 {
 public:
     // Constructor
-    AudioProcessor(const char *audio_interface, unsigned int input_channels, unsigned int output_channels, unsigned int rate);
+    AudioProcessor(const char *audio_interface, unsigned int input_channels, unsigned int output_channels, unsigned int rate,
+                   snd_pcm_uframes_t period_frames = 128, unsigned int periods = 2, const RealtimeConfig &realtime_config = RealtimeConfig(),
+                   AlsaAccessMode access_mode = AlsaAccessMode::ReadWrite, snd_pcm_format_t format = SND_PCM_FORMAT_UNKNOWN,
+                   unsigned int eq_smoothing_ms = 20, unsigned int mix_smoothing_ms = 10, unsigned int gain_smoothing_ms = 10,
+                   GainRamp gain_ramp = GainRamp::Exponential, unsigned int bus_count = 0, const std::string &ir_directory = "impulse_responses");
     // Destructor
     ~AudioProcessor();
-    // Start and stop audio processing functions
+    // Start and stop audio processing functions. start() launches the real-time audio thread and returns.
+    // stop() wakes the audio thread and waits for it to finish.
     void start();
     void stop();
+    // Function to ask the audio thread to finish without waiting for it. Safe to call from any thread.
+    void request_stop();
+    // Function to block until the audio thread has finished
+    void wait();
 
 private:
     // Audio parameters
     const char *audio_interface;
-    snd_pcm_format_t format = SND_PCM_FORMAT_S16_LE;
+    // Requested device sample format. SND_PCM_FORMAT_UNKNOWN negotiates the device's native format.
+    snd_pcm_format_t format;
     unsigned int rate;
     unsigned int input_channels;
     unsigned int output_channels;
-    const int buffer_size = 4096;
-    // Siganl buffers
-    std::vector<char> input_buffer;
-    std::vector<short> output_buffer;
-    std::vector<short> current_input_frame;
-    std::vector<short> current_output_frame;
+    // Number of frames read and processed per block. Holds the requested ALSA period until the device is started,
+    // and the negotiated period afterwards.
+    snd_pcm_uframes_t period_frames;
+    // Number of periods per ALSA buffer
+    unsigned int periods;
+    // How audio data is exchanged with the ALSA device
+    AlsaAccessMode access_mode;
+    // Interleaved float buffer used between the sample format conversion and the (de)interleaving
+    std::vector<float> interleaved_float_buffer;
+    // Sample format conversion kernels for the negotiated capture and playback formats, selected for this CPU
+    const SampleFormatKernels *input_kernels = nullptr;
+    const SampleFormatKernels *output_kernels = nullptr;
+    // Planar 32-bit float processing buffers, normalized to [-1.0, 1.0), one per channel, and the channel pointer arrays handed to the effects
+    std::vector<std::vector<float>> input_channel_buffers;
+    std::vector<std::vector<float>> output_channel_buffers;
+    std::vector<float *> input_channel_ptrs;
+    std::vector<float *> output_channel_ptrs;
+    // Planar buffers of the mixer buses, and the mixer's source (inputs, then buses) and destination (outputs, then buses) pointer arrays
+    std::vector<std::vector<float>> bus_channel_buffers;
+    std::vector<const float *> mixer_source_ptrs;
+    std::vector<float *> mixer_destination_ptrs;
     // Level metering
     std::unique_ptr<Meter> input_meter;
     std::unique_ptr<Meter> output_meter;
+    // Xrun, recovery and processing time telemetry
+    std::unique_ptr<DeviceStats> device_stats;
     // Audio Effects
     std::vector<std::unique_ptr<Mute>> input_mutes;
     std::vector<std::unique_ptr<Gain>> input_volumes;
     std::vector<std::unique_ptr<Equalizer>> input_equalizers;
+    std::vector<std::unique_ptr<Delay>> input_delays;
     std::unique_ptr<Mixer> mixer;
+    // Channel strips of the mixer buses, run by the mixer as it mixes each bus
+    std::vector<std::unique_ptr<Bus>> buses;
     std::vector<std::unique_ptr<Mute>> output_mutes;
     std::vector<std::unique_ptr<Gain>> output_volumes;
     std::vector<std::unique_ptr<Equalizer>> output_equalizers;
+    // FIR convolution of each output channel, run after its equalizer
+    std::vector<std::unique_ptr<Convolver>> output_convolvers;
+    // Alignment delay of each output channel, run after its convolution
+    std::vector<std::unique_ptr<Delay>> output_delays;
+    // Crossovers splitting mixer outputs into bands on other outputs, run between the mixer and the output channel strips
+    std::vector<std::unique_ptr<Crossover>> crossovers;
+    // Equalizer filters of all input and all output channels, processed BIQUAD_BANK_LANES channels at a time
+    std::unique_ptr<BiquadBank> input_equalizer_bank;
+    std::unique_ptr<BiquadBank> output_equalizer_bank;
+    // Real-time audio thread
+    RealtimeConfig realtime_config;
+    std::thread processing_thread;
+    // Worker threads sharing the per-channel processing, created by the audio thread
+    std::unique_ptr<WorkerPool> worker_pool;
+    // Number of frames of the block being processed, read by the channel tasks
+    size_t block_frames = 0;
+    // Audio thread entry point. Configures the thread for real-time operation and runs process().
+    void processing_thread_main();
+    // Function to size and pre-fault all processing buffers for the negotiated period
+    void allocate_buffers();
+    // Function to select the conversion kernels for the formats negotiated by the device. Returns false if a format has no kernels.
+    bool select_sample_format_kernels(const AlsaDevice &alsa_device);
+    // Functions to convert nframes frames between the device's channel areas, starting at frame offset,
+    // and the planar float buffers, starting at frame position
+    void convert_input(const snd_pcm_channel_area_t *areas, snd_pcm_uframes_t offset, size_t position, size_t nframes);
+    void convert_output(const snd_pcm_channel_area_t *areas, snd_pcm_uframes_t offset, size_t position, size_t nframes);
     // Audio processing function
     void process();
-    bool processing_active = false;
+    // Functions to transfer one period between the device and the planar float buffers, and to process it.
+    // The transfer functions return 0 or a negative ALSA error code.
+    int read_block(AlsaDevice &alsa_device);
+    void process_block(size_t nframes);
+    // Tasks of process_block, run on the worker pool. A group task runs the equalizer bank over the BIQUAD_BANK_LANES
+    // channels it processes in lockstep; a channel task then runs the rest of one channel strip, so the expensive
+    // convolutions spread over the workers even when there are fewer groups than workers.
+    static void process_input_group(void *context, size_t group);
+    static void process_input_channel(void *context, size_t channel);
+    static void process_output_group(void *context, size_t group);
+    static void process_output_channel(void *context, size_t channel);
+    int write_block(AlsaDevice &alsa_device);
+    // Function to record which stream caused a device error. origin is the stream that was being accessed when the error occurred.
+    void record_device_error(const AlsaDevice &alsa_device, int err, IncidentSource origin);
+    // Function to bring the device back after an error without leaving the processing loop.
+    // Returns false if the device could not be recovered before a stop was requested.
+    bool recover_device(AlsaDevice &alsa_device, int err);
+    std::atomic<bool> processing_active{false};
+    // Event descriptor polled by the audio thread together with the ALSA streams, so stop() can wake it up immediately
+    int stop_event_fd = -1;
 };
 
 // Constructor and destructor
 AudioProcessor::AudioProcessor(const char *audio_interface, unsigned int input_channels, unsigned int output_channels,
-                               unsigned int rate)
+                               unsigned int rate, snd_pcm_uframes_t period_frames, unsigned int periods, const RealtimeConfig &realtime_config,
+                               AlsaAccessMode access_mode, snd_pcm_format_t format, unsigned int eq_smoothing_ms, unsigned int mix_smoothing_ms,
+                               unsigned int gain_smoothing_ms, GainRamp gain_ramp, unsigned int bus_count, const std::string &ir_directory)
     : audio_interface(audio_interface),
+      format(format),
+      access_mode(access_mode),
+      realtime_config(realtime_config),
       input_channels(input_channels),
       output_channels(output_channels),
-      mixer(std::make_unique<Mixer>(input_channels, output_channels)),
+      mixer(std::make_unique<Mixer>(input_channels, output_channels, bus_count, static_cast<size_t>(mix_smoothing_ms) * rate / 1000)),
       rate(rate),
       processing_active(false),
-      input_buffer(buffer_size * input_channels * sizeof(short)),
-      output_buffer(buffer_size / (input_channels * sizeof(short)) * output_channels),
-      current_input_frame(input_channels * sizeof(short), 0.0),
-      current_output_frame(output_channels * sizeof(short), 0.0)
+      period_frames(period_frames),
+      periods(periods)
 {
+    // Create the stop event
+    stop_event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (stop_event_fd < 0)
+    {
+        std::cerr << "Cannot create the stop event: " << std::strerror(errno) << std::endl;
+    }
+
     // Initialize the level meters
     input_meter = std::make_unique<Meter>(rate, "input", input_channels);
     output_meter = std::make_unique<Meter>(rate, "output", output_channels);
 
-    // Initialize the audio effects for each input channel
+    // Initialize the device telemetry
+    device_stats = std::make_unique<DeviceStats>();
+
+    // Volume changes ramp over gain_smoothing_ms
+    const size_t gain_ramp_frames = static_cast<size_t>(gain_smoothing_ms) * rate / 1000;
+
+    // Initialize the audio effects for each input channel. The linear-phase equalizer convolution is partitioned like the
+    // output convolution, for the requested period until the device has negotiated one.
     for (int i = 0; i < input_channels; ++i)
     {
-        input_volumes.emplace_back(std::make_unique<Gain>("input", i + 1));
+        input_volumes.emplace_back(std::make_unique<Gain>("input", i + 1, gain_ramp_frames, gain_ramp));
         input_mutes.emplace_back(std::make_unique<Mute>("input", i + 1));
-        input_equalizers.emplace_back(std::make_unique<Equalizer>(rate, "input", i + 1));
+        input_equalizers.emplace_back(std::make_unique<Equalizer>(rate, "input", i + 1, convolution_partition_frames(period_frames)));
+        input_delays.emplace_back(std::make_unique<Delay>(rate, "input", i + 1));
     }
 
     // Initialize the audio effects for each output channel
     for (int i = 0; i < output_channels; ++i)
     {
-        output_volumes.emplace_back(std::make_unique<Gain>("output", i + 1));
+        output_volumes.emplace_back(std::make_unique<Gain>("output", i + 1, gain_ramp_frames, gain_ramp));
         output_mutes.emplace_back(std::make_unique<Mute>("output", i + 1));
-        output_equalizers.emplace_back(std::make_unique<Equalizer>(rate, "output", i + 1));
+        output_equalizers.emplace_back(std::make_unique<Equalizer>(rate, "output", i + 1, convolution_partition_frames(period_frames)));
+        output_delays.emplace_back(std::make_unique<Delay>(rate, "output", i + 1));
+    }
+
+    // Initialize the output convolutions. The partition size follows the requested period, and allocate_buffers() fits it to
+    // the period the device negotiates, so the convolution adds no latency.
+    for (unsigned int i = 0; i < output_channels; ++i)
+    {
+        output_convolvers.emplace_back(std::make_unique<Convolver>(rate, "output", i + 1, convolution_partition_frames(period_frames), ir_directory));
+    }
+
+    // Initialize the equalizer banks with one band per equalizer filter. Filter changes glide over eq_smoothing_ms.
+    const size_t eq_ramp_frames = static_cast<size_t>(eq_smoothing_ms) * rate / 1000;
+    input_equalizer_bank = std::make_unique<BiquadBank>(input_channels, Equalizer::MAX_FILTERS, eq_ramp_frames);
+    output_equalizer_bank = std::make_unique<BiquadBank>(output_channels, Equalizer::MAX_FILTERS, eq_ramp_frames);
+
+    // Initialize the channel strips of the mixer buses
+    for (unsigned int i = 0; i < bus_count; ++i)
+    {
+        buses.emplace_back(std::make_unique<Bus>(rate, i + 1, eq_ramp_frames, gain_ramp_frames, gain_ramp, convolution_partition_frames(period_frames)));
+    }
+
+    // Initialize the crossovers
+    for (unsigned int i = 0; i < Crossover::get_crossover_count(output_channels); ++i)
+    {
+        crossovers.emplace_back(std::make_unique<Crossover>(rate, i + 1, output_channels, eq_ramp_frames));
     }
 }
 
 AudioProcessor::~AudioProcessor()
 {
     stop();
+    if (stop_event_fd >= 0)
+    {
+        close(stop_event_fd);
+    }
 }
 
 // Start and stop audio processing functions
@@ -107,17 +246,203 @@ void AudioProcessor::start()
 {
     if (!processing_active)
     {
+        // Lock memory before the audio thread is created, so its stack and every later allocation are locked as well
+        if (realtime_config.lock_memory)
+        {
+            std::string error;
+            if (lock_process_memory(error))
+            {
+                std::cout << "Process memory locked" << std::endl;
+            }
+            else
+            {
+                std::cerr << "Cannot lock process memory: " << error << std::endl;
+            }
+        }
+
+        // Clear a stop request left over from a previous run
+        uint64_t count;
+        while (read(stop_event_fd, &count, sizeof(count)) > 0)
+        {
+        }
+
         processing_active = true;
-        process();
-        // processing_thread = std::thread(&AudioProcessor::process, this);
+        processing_thread = std::thread(&AudioProcessor::processing_thread_main, this);
     }
 }
 void AudioProcessor::stop()
 {
-    if (processing_active)
+    request_stop();
+    wait();
+}
+void AudioProcessor::request_stop()
+{
+    processing_active = false;
+    // Wake the audio thread if it is waiting for the next period
+    uint64_t count = 1;
+    if (write(stop_event_fd, &count, sizeof(count)) < 0 && stop_event_fd >= 0)
+    {
+        std::cerr << "Cannot signal the stop event: " << std::strerror(errno) << std::endl;
+    }
+}
+void AudioProcessor::wait()
+{
+    if (processing_thread.joinable())
+    {
+        processing_thread.join();
+    }
+}
+
+// Audio thread entry point
+void AudioProcessor::processing_thread_main()
+{
+    // Apply SCHED_FIFO, CPU affinity and the stack pre-fault, and report what was granted
+    configure_realtime_thread(realtime_config);
+
+    // Start the workers from the audio thread, after the memory has been locked
+    worker_pool = std::make_unique<WorkerPool>(realtime_config.worker_threads, realtime_config);
+
+    process();
+
+    worker_pool.reset();
+
+    // The loop also ends on unrecoverable device errors, so mark the processor as stopped for wait() callers
+    processing_active = false;
+}
+
+// Size every processing buffer for period_frames and touch it, so no allocation or page fault happens inside the processing loop
+void AudioProcessor::allocate_buffers()
+{
+    interleaved_float_buffer.assign(period_frames * std::max(input_channels, output_channels), 0.0f);
+    input_channel_buffers.assign(input_channels, std::vector<float>(period_frames, 0.0f));
+    output_channel_buffers.assign(output_channels, std::vector<float>(period_frames, 0.0f));
+
+    // Initialize the channel pointer arrays used by the block processing functions
+    input_channel_ptrs.clear();
+    output_channel_ptrs.clear();
+    for (auto &buffer : input_channel_buffers)
+    {
+        input_channel_ptrs.push_back(buffer.data());
+    }
+    for (auto &buffer : output_channel_buffers)
+    {
+        output_channel_ptrs.push_back(buffer.data());
+    }
+    // Every bus buffer is both a mixer source and a mixer destination
+    bus_channel_buffers.assign(buses.size(), std::vector<float>(period_frames, 0.0f));
+    mixer_source_ptrs.assign(input_channel_ptrs.begin(), input_channel_ptrs.end());
+    mixer_destination_ptrs.assign(output_channel_ptrs.begin(), output_channel_ptrs.end());
+    for (auto &buffer : bus_channel_buffers)
+    {
+        mixer_source_ptrs.push_back(buffer.data());
+        mixer_destination_ptrs.push_back(buffer.data());
+    }
+    for (auto &bus : buses)
+    {
+        bus->allocate(period_frames);
+    }
+    for (auto &crossover : crossovers)
+    {
+        crossover->allocate(period_frames);
+    }
+    for (auto &convolver : output_convolvers)
+    {
+        convolver->allocate(period_frames);
+    }
+    for (auto &equalizer : input_equalizers)
+    {
+        equalizer->allocate(period_frames);
+    }
+    for (auto &equalizer : output_equalizers)
+    {
+        equalizer->allocate(period_frames);
+    }
+    for (auto &delay : input_delays)
+    {
+        delay->allocate(period_frames);
+    }
+    for (auto &delay : output_delays)
+    {
+        delay->allocate(period_frames);
+    }
+
+    // The convolutions only run without latency on whole partitions
+    const size_t partition_frames = convolution_partition_frames(period_frames);
+    if (period_frames % partition_frames != 0)
+    {
+        std::cout << "Warning: the period of " << period_frames << " frames is not a multiple of " << partition_frames
+                  << " frames, the convolutions add " << partition_frames * 1000.0 / rate << " ms of latency" << std::endl;
+    }
+}
+
+// Select the conversion kernels for the negotiated formats
+bool AudioProcessor::select_sample_format_kernels(const AlsaDevice &alsa_device)
+{
+    SampleFormat input_format, output_format;
+    if (!sample_format_from_alsa(alsa_device.get_capture_format(), input_format) ||
+        !sample_format_from_alsa(alsa_device.get_playback_format(), output_format))
     {
-        processing_active = false;
-        // processing_thread.join();
+        std::cerr << "Unsupported sample format" << std::endl;
+        return false;
+    }
+    input_kernels = &get_sample_format_kernels(input_format);
+    output_kernels = &get_sample_format_kernels(output_format);
+    std::cout << "Using " << input_kernels->format_name << " (" << input_kernels->name << ") capture and "
+              << output_kernels->format_name << " (" << output_kernels->name << ") playback sample conversion kernels" << std::endl;
+    return true;
+}
+
+// Convert captured samples to the planar float input buffers.
+// Interleaved areas are converted with one kernel call and then deinterleaved, non-interleaved areas with one kernel call per channel.
+void AudioProcessor::convert_input(const snd_pcm_channel_area_t *areas, snd_pcm_uframes_t offset, size_t position, size_t nframes)
+{
+    const unsigned int sample_bits = input_kernels->bytes_per_sample * 8;
+    if (areas_interleaved(areas, input_channels, sample_bits))
+    {
+        input_kernels->unpack(area_sample_address(areas[0], offset), interleaved_float_buffer.data(), nframes * input_channels);
+        deinterleave(interleaved_float_buffer.data(), input_channel_ptrs.data(), input_channels, nframes, position);
+        return;
+    }
+    for (unsigned int ch = 0; ch < input_channels; ++ch)
+    {
+        float *destination = input_channel_ptrs[ch] + position;
+        if (areas[ch].step == sample_bits)
+        {
+            input_kernels->unpack(area_sample_address(areas[ch], offset), destination, nframes);
+            continue;
+        }
+        // Any other layout is walked sample by sample
+        for (size_t frame = 0; frame < nframes; ++frame)
+        {
+            input_kernels->unpack(area_sample_address(areas[ch], offset + frame), destination + frame, 1);
+        }
+    }
+}
+
+// Convert the planar float output buffers to samples in the playback areas.
+// The conversion saturates, so overs clip at full scale instead of wrapping around.
+void AudioProcessor::convert_output(const snd_pcm_channel_area_t *areas, snd_pcm_uframes_t offset, size_t position, size_t nframes)
+{
+    const unsigned int sample_bits = output_kernels->bytes_per_sample * 8;
+    if (areas_interleaved(areas, output_channels, sample_bits))
+    {
+        interleave(output_channel_ptrs.data(), interleaved_float_buffer.data(), output_channels, nframes, position);
+        output_kernels->pack(interleaved_float_buffer.data(), area_sample_address(areas[0], offset), nframes * output_channels);
+        return;
+    }
+    for (unsigned int ch = 0; ch < output_channels; ++ch)
+    {
+        const float *source = output_channel_ptrs[ch] + position;
+        if (areas[ch].step == sample_bits)
+        {
+            output_kernels->pack(source, area_sample_address(areas[ch], offset), nframes);
+            continue;
+        }
+        // Any other layout is walked sample by sample
+        for (size_t frame = 0; frame < nframes; ++frame)
+        {
+            output_kernels->pack(source + frame, area_sample_address(areas[ch], offset + frame), 1);
+        }
     }
 }
 
@@ -125,93 +450,273 @@ void AudioProcessor::stop()
 void AudioProcessor::process()
 {
     // Declare the alsa device that accesses the audio interface.
-    AlsaDevice alsa_device(audio_interface, input_channels, output_channels, rate, format);
+    AlsaDevice alsa_device(audio_interface, input_channels, output_channels, rate, format, period_frames, periods, access_mode);
+
+    // Start the alsa device. If it cannot be configured there is nothing to process.
+    if (!alsa_device.start())
+    {
+        std::cerr << "Failed to start the audio device" << std::endl;
+        return;
+    }
+    alsa_device.print_configuration();
+    if (!select_sample_format_kernels(alsa_device))
+    {
+        alsa_device.stop();
+        return;
+    }
+    std::cout << "Using " << input_equalizer_bank->get_kernels().name << " equalizer kernels, " << BIQUAD_BANK_LANES << " channels per group" << std::endl;
 
-    // Start the alsa device.
-    alsa_device.start();
+    // Process in blocks of the negotiated capture period
+    period_frames = alsa_device.get_period_size();
+    allocate_buffers();
+    device_stats->set_period_budget(period_frames, rate);
 
-    // Main audio processing loop.
+    // Main audio processing loop. The thread sleeps in poll() on both streams and the stop event until a full period has been
+    // captured and the playback buffer has room for it, then processes the period. Every stage runs over the whole block
+    // before the next stage starts. Device errors are recorded and recovered without leaving the loop.
     while (processing_active)
     {
-
-        // Read audio data from the capture device into the buffer. If the read fails, print an error message and exit the loop.
-        snd_pcm_sframes_t read_frames = alsa_device.read(input_buffer.data(), buffer_size / (input_channels * sizeof(short)));
-        if (read_frames < 0)
+        int err = alsa_device.wait_for_period(stop_event_fd);
+        if (err == 0)
         {
-            std::cerr << "Failed to read from capture device: " << snd_strerror(read_frames) << std::endl;
             break;
         }
+        IncidentSource origin = IncidentSource::Capture;
+        if (err > 0)
+        {
+            // Measure the time from the wake-up to the hand-over to playback against the period budget
+            auto processing_start = std::chrono::steady_clock::now();
+            if ((err = read_block(alsa_device)) == 0)
+            {
+                process_block(period_frames);
+                origin = IncidentSource::Playback;
+                err = write_block(alsa_device);
+            }
+            if (err == 0)
+            {
+                device_stats->record_processing_time(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - processing_start).count());
+            }
+        }
+        if (err < 0)
+        {
+            record_device_error(alsa_device, err, origin);
+            if (!recover_device(alsa_device, err))
+            {
+                break;
+            }
+        }
+    }
+
+    // Stop the alsa device at the end of the main loop
+    alsa_device.stop();
+}
 
-        // Loop to process each frame of audio data, where a frame is a set of one sample for each channel
-        // The size of a frame can be calculated using the number of channels and the size of each sample,
-        // which is 2 bytes in the case of 16 bit samples. So the frame size would be 2 * number of channels
-        for (int frame = 0; frame < read_frames; ++frame)
+// Collect one period of captured audio. Where the device's ring buffer wraps around a period arrives in two parts,
+// each converted straight from the device's areas into the planar float buffers.
+int AudioProcessor::read_block(AlsaDevice &alsa_device)
+{
+    size_t nframes = 0;
+    while (nframes < period_frames)
+    {
+        const snd_pcm_channel_area_t *areas;
+        snd_pcm_uframes_t offset;
+        snd_pcm_sframes_t frames = alsa_device.capture_begin(areas, offset, period_frames - nframes);
+        // wait_for_period() guaranteed a full period, so running short means the stream broke down in between
+        if (frames <= 0)
+        {
+            return frames < 0 ? frames : -EPIPE;
+        }
+        convert_input(areas, offset, nframes, frames);
+        if ((frames = alsa_device.capture_commit(offset, frames)) < 0)
         {
+            return frames;
+        }
+        nframes += frames;
+    }
+    return 0;
+}
 
-            // Process each input channel.
-            for (int in_ch = 0; in_ch < input_channels; ++in_ch)
-            {
-                // Get the sample from the input buffer.
-                short sample = ((short *)input_buffer.data())[frame * input_channels + in_ch];
+// Run one block through the input channel strips, the mixer, the crossovers and the output channel strips.
+// The channel strips are independent, so each stage is spread over the worker pool; the mixer is the join point between them.
+void AudioProcessor::process_block(size_t nframes)
+{
+    block_frames = nframes;
 
-                // Store the raw input sample in the input frame.
-                current_input_frame[in_ch] = sample;
-            }
+    // Store the input block in input_meter before processing any effects
+    input_meter->store(input_channel_ptrs.data(), nframes);
 
-            // Store input frame in input_meter before processing any effects
-            input_meter->store(current_input_frame);
+    // Process each input channel block through the input equalizer (IIR bank, then linear-phase FIR), delay, volume and mute, in place.
+    worker_pool->run(input_equalizer_bank->get_group_count(), &AudioProcessor::process_input_group, this);
+    worker_pool->run(input_channels, &AudioProcessor::process_input_channel, this);
 
-            // Process each input channel after storing the input frame.
-            for (int in_ch = 0; in_ch < input_channels; ++in_ch)
-            {
-                // Get the sample from the current input frame.
-                short sample = current_input_frame[in_ch];
-
-                // Process the sample through the input equalizer.
-                sample = input_equalizers[in_ch]->process(sample);
-                // Process the sample through the input volume.
-                sample = input_volumes[in_ch]->process(sample);
-                // Process the sample through the input mute.
-                sample = input_mutes[in_ch]->process(sample);
-
-                // Store the processed input sample in the input frame.
-                current_input_frame[in_ch] = sample;
-            }
+    // Mix input channels to output channels using the mixer object. Each bus is mixed and run through its channel strip before
+    // anything it feeds.
+    mixer->process(mixer_source_ptrs.data(), mixer_destination_ptrs.data(), nframes,
+                   [this, nframes](unsigned int bus)
+                   { buses[bus]->process(mixer_destination_ptrs[output_channels + bus], nframes); });
 
-            // Mix input channels to output channels using the mixer object.
-            current_output_frame = mixer->process(current_input_frame);
+    // Split mixer outputs into the bands of active speakers, replacing the mix of the band outputs.
+    for (auto &crossover : crossovers)
+    {
+        crossover->process(output_channel_ptrs.data(), nframes);
+    }
+
+    // Process each output channel block through the output equalizer, convolution, delay, volume and mute, in place.
+    worker_pool->run(output_equalizer_bank->get_group_count(), &AudioProcessor::process_output_group, this);
+    worker_pool->run(output_channels, &AudioProcessor::process_output_channel, this);
 
-            // Process each output channel.
-            for (int out_ch = 0; out_ch < output_channels; ++out_ch)
+    // Store the output block in output_meter after processing all effects
+    output_meter->store(output_channel_ptrs.data(), nframes);
+}
+
+// Input channel group task. A channel's effects may run on a different thread every period; the pool's barrier orders
+// the periods and the stages, so each effect still drains its parameter queue from one thread at a time.
+void AudioProcessor::process_input_group(void *context, size_t group)
+{
+    AudioProcessor *processor = static_cast<AudioProcessor *>(context);
+    const unsigned int first = static_cast<unsigned int>(group) * BIQUAD_BANK_LANES;
+    const unsigned int last = std::min(first + BIQUAD_BANK_LANES, processor->input_channels);
+    for (unsigned int in_ch = first; in_ch < last; ++in_ch)
+    {
+        processor->input_equalizers[in_ch]->update(*processor->input_equalizer_bank, in_ch);
+    }
+    processor->input_equalizer_bank->process_group(group, processor->input_channel_ptrs.data(), processor->block_frames);
+}
+
+// Input channel task, run after every group has been through the bank
+void AudioProcessor::process_input_channel(void *context, size_t channel)
+{
+    AudioProcessor *processor = static_cast<AudioProcessor *>(context);
+    float **buffer = &processor->input_channel_ptrs[channel];
+    processor->input_equalizers[channel]->process(buffer, buffer, processor->block_frames);
+    processor->input_delays[channel]->process(buffer, buffer, processor->block_frames);
+    processor->input_volumes[channel]->process(buffer, buffer, processor->block_frames);
+    processor->input_mutes[channel]->process(buffer, buffer, processor->block_frames);
+}
+
+// Output channel group task
+void AudioProcessor::process_output_group(void *context, size_t group)
+{
+    AudioProcessor *processor = static_cast<AudioProcessor *>(context);
+    const unsigned int first = static_cast<unsigned int>(group) * BIQUAD_BANK_LANES;
+    const unsigned int last = std::min(first + BIQUAD_BANK_LANES, processor->output_channels);
+    for (unsigned int out_ch = first; out_ch < last; ++out_ch)
+    {
+        processor->output_equalizers[out_ch]->update(*processor->output_equalizer_bank, out_ch);
+    }
+    processor->output_equalizer_bank->process_group(group, processor->output_channel_ptrs.data(), processor->block_frames);
+}
+
+// Output channel task, run after every group has been through the bank
+void AudioProcessor::process_output_channel(void *context, size_t channel)
+{
+    AudioProcessor *processor = static_cast<AudioProcessor *>(context);
+    float **buffer = &processor->output_channel_ptrs[channel];
+    processor->output_equalizers[channel]->process(buffer, buffer, processor->block_frames);
+    processor->output_convolvers[channel]->process(buffer, buffer, processor->block_frames);
+    processor->output_delays[channel]->process(buffer, buffer, processor->block_frames);
+    processor->output_volumes[channel]->process(buffer, buffer, processor->block_frames);
+    processor->output_mutes[channel]->process(buffer, buffer, processor->block_frames);
+}
+
+// Hand the processed period to the playback device, converting straight into the device's areas
+int AudioProcessor::write_block(AlsaDevice &alsa_device)
+{
+    size_t written_frames = 0;
+    while (written_frames < period_frames)
+    {
+        const snd_pcm_channel_area_t *areas;
+        snd_pcm_uframes_t offset;
+        snd_pcm_sframes_t frames = alsa_device.playback_begin(areas, offset, period_frames - written_frames);
+        if (frames <= 0)
+        {
+            return frames < 0 ? frames : -EPIPE;
+        }
+        convert_output(areas, offset, written_frames, frames);
+        if ((frames = alsa_device.playback_commit(offset, frames)) < 0)
+        {
+            return frames;
+        }
+        written_frames += frames;
+    }
+    return 0;
+}
+
+// Record a device error. The stream states tell which stream ran into an xrun or was suspended;
+// other errors are attributed to the stream that was being accessed.
+void AudioProcessor::record_device_error(const AlsaDevice &alsa_device, int err, IncidentSource origin)
+{
+    snd_pcm_state_t capture_state, playback_state;
+    alsa_device.get_stream_states(capture_state, playback_state);
+
+    bool recorded = false;
+    for (auto [source, state] : {std::make_pair(IncidentSource::Capture, capture_state), std::make_pair(IncidentSource::Playback, playback_state)})
+    {
+        if (state == SND_PCM_STATE_XRUN || state == SND_PCM_STATE_SUSPENDED)
+        {
+            device_stats->record_incident(source, state == SND_PCM_STATE_XRUN ? IncidentType::Xrun : IncidentType::Suspend, err);
+            std::cerr << incident_source_name(source) << (state == SND_PCM_STATE_XRUN ? " xrun" : " suspended") << std::endl;
+            recorded = true;
+        }
+    }
+    if (!recorded)
+    {
+        IncidentType type = err == -EPIPE ? IncidentType::Xrun : err == -ESTRPIPE ? IncidentType::Suspend : IncidentType::Error;
+        device_stats->record_incident(origin, type, err);
+        std::cerr << incident_source_name(origin) << " " << incident_type_name(type) << ": " << snd_strerror(err) << std::endl;
+    }
+}
+
+// Recover the device. Restarting both streams, which re-prepares them and pre-fills playback, is tried first.
+// If that fails the device is closed and reopened, backing off between attempts so a disconnected interface does not
+// keep the CPU busy, until it comes back or a stop is requested.
+bool AudioProcessor::recover_device(AlsaDevice &alsa_device, int err)
+{
+    if ((err = alsa_device.recover(err, stop_event_fd)) == 0)
+    {
+        device_stats->record_recovery();
+        return true;
+    }
+    if (!processing_active)
+    {
+        return false;
+    }
+
+    std::cerr << "Cannot restart the audio streams: " << snd_strerror(err) << ", reopening the audio device" << std::endl;
+    int backoff_ms = 10;
+    while (processing_active)
+    {
+        alsa_device.stop();
+        if (alsa_device.start())
+        {
+            device_stats->record_incident(IncidentSource::Device, IncidentType::Reopen, err);
+            // The driver may have chosen a different period this time
+            if (alsa_device.get_period_size() != period_frames)
             {
-                // Get the sample from the current output frame.
-                output_buffer[frame * output_channels + out_ch] = current_output_frame[out_ch];
-                // Process the mixed sample through the output equalizer.
-                output_buffer[frame * output_channels + out_ch] = output_equalizers[out_ch]->process(output_buffer[frame * output_channels + out_ch]);
-                // Process the mixed sample through the output volume.
-                output_buffer[frame * output_channels + out_ch] = output_volumes[out_ch]->process(output_buffer[frame * output_channels + out_ch]);
-                // Process the mixed sample through the output mute.
-                output_buffer[frame * output_channels + out_ch] = output_mutes[out_ch]->process(output_buffer[frame * output_channels + out_ch]);
-
-                // Store the output frame in the current_output_frame vector
-                current_output_frame[out_ch] = output_buffer[frame * output_channels + out_ch];
+                period_frames = alsa_device.get_period_size();
+                allocate_buffers();
+                device_stats->set_period_budget(period_frames, rate);
             }
-
-            // Store output frame in output_meter after processing all effects
-            output_meter->store(current_output_frame);
+            alsa_device.print_configuration();
+            // Reopening may also have negotiated other formats
+            if (!select_sample_format_kernels(alsa_device))
+            {
+                return false;
+            }
+            return true;
         }
+        device_stats->record_incident(IncidentSource::Device, IncidentType::RecoveryFailed, err);
+        std::cerr << "Cannot reopen the audio device, retrying in " << backoff_ms << " ms" << std::endl;
 
-        // Write the processed audio data to the playback device. If the write fails, print an error message and exit the loop.
-        snd_pcm_sframes_t write_frames = alsa_device.write(output_buffer.data(), read_frames);
-        if (write_frames < 0)
+        // Wait before the next attempt, waking up at once if a stop is requested
+        pollfd stop_descriptor{stop_event_fd, POLLIN, 0};
+        if (poll(&stop_descriptor, 1, backoff_ms) > 0)
         {
-            std::cerr << "Failed to write to playback device: " << snd_strerror(write_frames) << std::endl;
             break;
         }
+        backoff_ms = std::min(backoff_ms * 2, 2000);
     }
-
-    // Stop the alsa device at the end of the main loop
-    alsa_device.stop();
+    return false;
 }
 
-#endif // AUDIO_PROCESSOR_H
\ No newline at end of file
+#endif // AUDIO_PROCESSOR_H
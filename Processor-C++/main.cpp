@@ -2,6 +2,10 @@
 
 #include <iostream>
 #include <sstream>
+#include <algorithm>
+#include <thread>
+#include <csignal>
+#include <pthread.h>
 #include "audio_processor.h"
 #include "Utilities/custom_websocket_server.h"
 #include "Utilities/event_manager.h"
@@ -36,18 +40,32 @@ bool parse_string_arg(const char *arg, const std::string &flag, std::string &val
     return false;
 }
 
+// Function to print the command line usage
+void print_usage(const char *program)
+{
+    std::cerr << "Usage: sudo " << program << " -interface:<audio_interface_name> -inputs:<input_number> -outputs:<output_number> -rate:<sample_rate> -port:<server_port>"
+              << " [-period:<period_frames>] [-periods:<period_count>] [-priority:<rt_priority 0-99>] [-cpus:<cpu_list e.g. 2,3 or 2-3>] [-mlock:<0|1>] [-access:<rw|mmap>] [-format:<auto|s16|s24_3|s32|float>] [-workers:<worker_threads>] [-eqsmoothing:<ms>] [-mixsmoothing:<ms>] [-gainsmoothing:<ms>] [-gainramp:<linear|exponential>] [-buses:<bus_count>] [-irdir:<impulse_response_directory>]" << std::endl;
+}
+
 int main(int argc, char *argv[])
 {
-    // Check if the correct number of arguments was provided
-    if (argc != 6)
+    // Check if at least the required arguments were provided
+    if (argc < 6)
     {
-        std::cerr << "Usage: sudo " << argv[0] << " -interface:<audio_interface_name> -inputs:<input_number> -outputs:<output_number> -rate:<sample_rate> -port:<server_port>" << std::endl;
+        print_usage(argv[0]);
         return 1;
     }
 
-    // Declare variables to store command line argument values
+    // Declare variables to store command line argument values. Optional values keep their defaults if not given.
     std::string audio_interface;
-    unsigned int input_channels, output_channels, rate, port;
+    unsigned int input_channels = 0, output_channels = 0, rate = 0, port = 0;
+    unsigned int period_frames = 128, periods = 2;
+    unsigned int rt_priority = 80, lock_memory = 1, worker_threads = 0, eq_smoothing_ms = 20, mix_smoothing_ms = 10, gain_smoothing_ms = 10, bus_count = 0;
+    std::string cpu_list;
+    std::string access_name = "rw";
+    std::string format_name = "auto";
+    std::string ir_directory = "impulse_responses";
+    std::string gain_ramp_name = "exponential";
 
     // Parse command line arguments and store values in variables
     for (int i = 1; i < argc; ++i)
@@ -56,15 +74,84 @@ int main(int argc, char *argv[])
             !parse_uint_arg(argv[i], "-inputs:", input_channels) &&
             !parse_uint_arg(argv[i], "-outputs:", output_channels) &&
             !parse_uint_arg(argv[i], "-rate:", rate) &&
-            !parse_uint_arg(argv[i], "-port:", port))
+            !parse_uint_arg(argv[i], "-port:", port) &&
+            !parse_uint_arg(argv[i], "-periods:", periods) &&
+            !parse_uint_arg(argv[i], "-period:", period_frames) &&
+            !parse_uint_arg(argv[i], "-priority:", rt_priority) &&
+            !parse_string_arg(argv[i], "-cpus:", cpu_list) &&
+            !parse_uint_arg(argv[i], "-mlock:", lock_memory) &&
+            !parse_string_arg(argv[i], "-access:", access_name) &&
+            !parse_string_arg(argv[i], "-format:", format_name) &&
+            !parse_uint_arg(argv[i], "-workers:", worker_threads) &&
+            !parse_uint_arg(argv[i], "-eqsmoothing:", eq_smoothing_ms) &&
+            !parse_uint_arg(argv[i], "-mixsmoothing:", mix_smoothing_ms) &&
+            !parse_uint_arg(argv[i], "-gainsmoothing:", gain_smoothing_ms) &&
+            !parse_string_arg(argv[i], "-gainramp:", gain_ramp_name) &&
+            !parse_uint_arg(argv[i], "-buses:", bus_count) &&
+            !parse_string_arg(argv[i], "-irdir:", ir_directory))
         {
             // If an invalid option was provided, display usage instructions and exit
             std::cerr << "Invalid option: " << argv[i] << std::endl;
-            std::cerr << "Usage: sudo " << argv[0] << " -interface:<audio_interface_name> -inputs:<input_number> -outputs:<output_number> -rate:<sample_rate> -port:<server_port>" << std::endl;
+            print_usage(argv[0]);
             return 1;
         }
     }
 
+    // Check that every required option was given
+    if (audio_interface.empty() || input_channels == 0 || output_channels == 0 || rate == 0 || port == 0 || period_frames == 0 || periods < 2)
+    {
+        std::cerr << "Missing or invalid option" << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // Real-time settings of the audio thread
+    RealtimeConfig realtime_config;
+    realtime_config.priority = static_cast<int>(std::min(rt_priority, 99u));
+    realtime_config.lock_memory = lock_memory != 0;
+    realtime_config.worker_threads = worker_threads;
+    if (!cpu_list.empty() && !parse_cpu_list(cpu_list, realtime_config.cpus))
+    {
+        std::cerr << "Invalid CPU list: " << cpu_list << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // ALSA access mode
+    AlsaAccessMode access_mode;
+    if (!parse_access_mode(access_name, access_mode))
+    {
+        std::cerr << "Invalid access mode: " << access_name << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // Shape of the volume ramps
+    GainRamp gain_ramp;
+    if (!parse_gain_ramp(gain_ramp_name, gain_ramp))
+    {
+        std::cerr << "Invalid gain ramp: " << gain_ramp_name << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // Block SIGINT and SIGTERM before any other thread is created, so every thread inherits the mask
+    // and the signals are only received by the signal thread started below.
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, nullptr);
+
+    // ALSA sample format
+    snd_pcm_format_t format;
+    if (!parse_format_name(format_name, format))
+    {
+        std::cerr << "Invalid sample format: " << format_name << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
     // Convert audio_interface string to const char* for use with ALSA
     const char *audio_interface_cstr = audio_interface.c_str();
 
@@ -82,12 +169,12 @@ int main(int argc, char *argv[])
 
     // Create database
     std::cout << "Connecting to database..." << std::endl;
-    Database db(host, dbPort, user, password, schema);
+    Database db(host, dbPort, user, password, schema, input_channels, output_channels, rate, ir_directory);
     std::cout << "Connected to database" << std::endl;
 
-    // Create AudioProcessor object with the specified audio interface, input and output channels, and sample rate
+    // Create AudioProcessor object with the specified audio interface, input and output channels, sample rate and ALSA period configuration
     std::cout << "Creating audio processor..." << std::endl;
-    AudioProcessor audioProcessor(audio_interface_cstr, input_channels, output_channels, rate);
+    AudioProcessor audioProcessor(audio_interface_cstr, input_channels, output_channels, rate, period_frames, periods, realtime_config, access_mode, format, eq_smoothing_ms, mix_smoothing_ms, gain_smoothing_ms, gain_ramp, bus_count, ir_directory);
     std::cout << "Created audio processor" << std::endl;
 
     // Create CustomWebSocketServer object with the specified port and audioProcessor object
@@ -95,10 +182,25 @@ int main(int argc, char *argv[])
     CustomWebSocketServer webSocketServer(port);
     std::cout << "Created websocket server" << std::endl;
 
-    // Start audio processing
+    // Start audio processing on the real-time audio thread
     std::cout << "Starting audio processor..." << std::endl;
     audioProcessor.start();
     std::cout << "Started audio processor" << std::endl;
 
+    // Stop the audio processor cleanly on SIGINT or SIGTERM
+    std::thread([&audioProcessor, stop_signals]()
+                {
+                    int signal_number;
+                    if (sigwait(&stop_signals, &signal_number) == 0)
+                    {
+                        std::cout << "Received " << strsignal(signal_number) << ", stopping audio processor..." << std::endl;
+                        audioProcessor.request_stop();
+                    } })
+        .detach();
+
+    // Keep the main thread alive while the audio thread runs
+    audioProcessor.wait();
+    std::cout << "Stopped audio processor" << std::endl;
+
     return 0;
 }